@@ -0,0 +1,151 @@
+/**
+ * The Arena class hands out memory for the short-lived buffers of a synthesis run (the pixel, error and boundary
+ * planes of its patches) by bumping a pointer through large blocks, and frees all of it at once when it is reset.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/06/17
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include "Arena.h"
+
+/**
+ * Constructs an empty arena with the default block size. No memory is held until the first allocation
+ */
+Arena::Arena() : Arena(DEFAULT_BLOCK_SIZE)
+{
+}
+
+/**
+ * Constructs an empty arena. No memory is held until the first allocation
+ *
+ * @param blockSize The size of each block the arena carves allocations from. Larger allocations get a block of their
+ *                  own
+ */
+Arena::Arena(size_t blockSize)
+{
+    m_blocksUsed = 0;
+    m_offset = 0;
+    m_blockSize = max(blockSize, (size_t) ALIGNMENT);
+    m_stats = Stats();
+}
+
+Arena::~Arena()
+{
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+        free(m_blocks[i].data);
+    }
+}
+
+/**
+ * Adds a block after the current one, and makes it current. The lock must be held
+ *
+ * @param size The size of the block
+ * @throws bad_alloc If the memory cannot be had
+ */
+void Arena::addBlock(size_t size)
+{
+    Block block;
+
+    // Every block starts aligned, so every allocation within it is too
+    block.data = (unsigned char*) malloc(size + ALIGNMENT);
+    block.size = size;
+
+    if (block.data == nullptr)
+    {
+        throw bad_alloc();
+    }
+
+    m_blocks.insert(m_blocks.begin() + m_blocksUsed, block);
+    m_blocksUsed++;
+    m_offset = (ALIGNMENT - (size_t) block.data % ALIGNMENT) % ALIGNMENT;
+    m_stats.bytesReserved += size;
+    m_stats.blocks++;
+}
+
+/**
+ * Allocates memory from the arena, aligned to ALIGNMENT bytes. It is only given back when the arena is reset
+ *
+ * @param bytes The number of bytes to allocate
+ * @return The memory, which lives until the arena is reset or destroyed
+ * @throws bad_alloc If the memory cannot be had
+ */
+void* Arena::allocate(size_t bytes)
+{
+    size_t size = (max(bytes, (size_t) 1) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    lock_guard<mutex> guard(m_lock);
+
+    // Move on to the next kept block (or a new one) once the current one, the last in use, is full
+    while (m_blocksUsed == 0 || m_offset + size > m_blocks[m_blocksUsed - 1].size + ALIGNMENT)
+    {
+        if (m_blocksUsed < m_blocks.size() && m_blocks[m_blocksUsed].size >= size)
+        {
+            Block& next = m_blocks[m_blocksUsed++];
+
+            m_offset = (ALIGNMENT - (size_t) next.data % ALIGNMENT) % ALIGNMENT;
+        }
+        else
+        {
+            addBlock(max(size, m_blockSize));
+        }
+    }
+
+    void* memory = m_blocks[m_blocksUsed - 1].data + m_offset;
+
+    m_offset += size;
+    m_stats.allocations++;
+    m_stats.bytesInUse += size;
+    m_stats.highWaterMark = max(m_stats.highWaterMark, m_stats.bytesInUse);
+
+    return memory;
+}
+
+/**
+ * Gives back everything allocated from the arena at once. Every block is kept for the allocations after the reset,
+ * unless the arena grew past one block, in which case they are replaced by a single block as large as all of them so
+ * the next run of the same size fits without moving between blocks.
+ */
+void Arena::reset()
+{
+    lock_guard<mutex> guard(m_lock);
+
+    if (m_blocks.size() > 1)
+    {
+        size_t total = 0;
+
+        for (size_t i = 0; i < m_blocks.size(); i++)
+        {
+            total += m_blocks[i].size;
+            free(m_blocks[i].data);
+        }
+
+        m_blocks.clear();
+        m_blocksUsed = 0;
+        m_stats.bytesReserved = 0;
+        addBlock(total);
+    }
+
+    if (!m_blocks.empty())
+    {
+        m_blocksUsed = 1;
+        m_offset = (ALIGNMENT - (size_t) m_blocks[0].data % ALIGNMENT) % ALIGNMENT;
+    }
+
+    m_stats.bytesInUse = 0;
+}
+
+/**
+ * Gets the allocation counts of the arena. The allocation count, high-water mark and block count cover its whole
+ * life, the bytes in use only what was allocated since the last reset
+ *
+ * @return The stats
+ */
+Arena::Stats Arena::getStats()
+{
+    lock_guard<mutex> guard(m_lock);
+
+    return m_stats;
+}
@@ -0,0 +1,79 @@
+/**
+ * The Arena class hands out memory for the short-lived buffers of a synthesis run (the pixel, error and boundary
+ * planes of its patches) by bumping a pointer through large blocks, and frees all of it at once when it is reset. A
+ * run makes thousands of these buffers, and they all die together, so nothing is freed one at a time.
+ *
+ * Blocks are kept across resets, so a run the same size as the last allocates nothing new. Allocation is safe from
+ * any number of threads at once.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/06/17
+ */
+
+#ifndef WANGTILE_ARENA_H
+#define WANGTILE_ARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+class Arena
+{
+public:
+    /**
+     * How much an arena has handed out, and how much memory it has held to do so
+     */
+    struct Stats
+    {
+        long long allocations;
+        long long bytesInUse;
+        long long highWaterMark;
+        long long bytesReserved;
+        long long blocks;
+    };
+
+private:
+    struct Block
+    {
+        unsigned char* data;
+        size_t size;
+    };
+
+    vector<Block> m_blocks;
+    size_t m_blocksUsed;
+    size_t m_offset;
+    size_t m_blockSize;
+    Stats m_stats;
+    mutex m_lock;
+
+    void addBlock(size_t);
+
+public:
+    const static size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+    const static size_t ALIGNMENT = 64;
+
+    Arena();
+    Arena(size_t);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    void* allocate(size_t);
+    void reset();
+    Stats getStats();
+
+    /**
+     * Allocates an uninitialized array from the arena
+     *
+     * @param count The number of elements
+     * @return The array, which lives until the arena is reset or destroyed
+     */
+    template<typename T> T* allocateArray(size_t count)
+    {
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    virtual ~Arena();
+};
+
+#endif //WANGTILE_ARENA_H
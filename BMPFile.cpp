@@ -2,146 +2,268 @@
  * Defines the object structure for BMP files. Handles the reading of a bmp file from a file name, and storing the
  * appropriate data as it is received from the header and bytes of the file.
  *
- * Reading of byte data routine taken from: http://stackoverflow.com/questions/9296059/read-pixel-value-in-bmp-file
- *
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 01-25-17
+ * @version 1.2 - 03-26-17 - Files are memory mapped and validated, and only decoded when their plane is needed
  */
 
+#include <climits>
 #include <cstring>
 #include "BMPFile.h"
+#include "BMPWriter.h"
+#include "Trace.h"
 
 using namespace std;
 
 /**
- * Constructor for the BMPFile, given a specific file name to read. Will populate the pixelData array with the
- * R, G, B values of each pixel. This array's length is equal to 3 * width * height of the image (as found in the BMP
- * header)
+ * Reads a little endian 16 bit value
+ * @param bytes The first byte of the value
+ * @return The value
+ */
+static int readShort(const unsigned char* bytes)
+{
+    return bytes[0] | (bytes[1] << 8);
+}
+
+/**
+ * Reads a little endian 32 bit value
+ * @param bytes The first byte of the value
+ * @return The value
+ */
+static unsigned int readInt(const unsigned char* bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int) bytes[3] << 24);
+}
+
+/**
+ * Constructor for the BMPFile, given a specific file name to read. The file is mapped into memory and its header
+ * checked, but its pixels are left where they are: they can be read in place through getEncodedRow, and are only
+ * decoded into an RGBPlane the first time getPlane is called.
+ *
+ * Uncompressed 24 and 32 bit files are supported, with padded rows and either bottom-up or top-down (negative height)
+ * row order.
  *
  * @param fileName The char array (string) containing the name of the BMP file to read. Keeps a reference
+ * @throws invalid_argument If the file cannot be read, is not a BMP, or uses a format that is not supported
  */
 BMPFile::BMPFile(const char* fileName)
 {
-	FILE* f = fopen(fileName, "rb");
-	unsigned char info[54];
+    m_mapping = make_shared<MappedFile>(fileName);
+    m_fileName = fileName;
+    m_pixels = make_shared<Pixels>();
 
-	fread(info, sizeof(unsigned char), 54, f); // read the 54-byte header
+    const unsigned char* data = m_mapping->getData();
+    size_t size = m_mapping->getSize();
 
-	// extract image height and width from header
-	m_width = *(int*)&info[18];
-	m_height = *(int*)&info[22];
-	int size = 3 * m_width * m_height;
-	unsigned char* data = new unsigned char[size]; // allocate 3 bytes per pixel
+    if (size < 54 || data[0] != 'B' || data[1] != 'M')
+    {
+        throw invalid_argument("File is not a bitmap");
+    }
 
-	fread(data, sizeof(unsigned char), size, f); // read the rest of the data at once
-	fclose(f);
+    unsigned int offset = readInt(data + 10);
+    unsigned int headerSize = readInt(data + 14);
+    int width = (int) readInt(data + 18);
+    int height = (int) readInt(data + 22);
+    int planes = readShort(data + 26);
+    unsigned int compression = readInt(data + 30);
 
-    m_pixelData = new RGBPlane(m_width, m_height);
+    m_bitsPerPixel = readShort(data + 28);
 
-	for (int i = 0; i < m_height; i++)
+    if (headerSize < 40 || planes != 1 || width <= 0 || height == 0 || height == INT_MIN)
     {
-        for (int j = 0; j < m_width; j++)
-        {
-            int ind = i * (m_width * 3) + (j * 3);
+        throw invalid_argument("Bitmap header is malformed");
+    }
 
-            m_pixelData->setPixelValueAt(j, i, data[ind], data[ind + 1], data[ind + 2], false);
-        }
+    // 32 bit files may also describe their (standard) channel layout with bit fields
+    bool standardFields = compression == 3 && m_bitsPerPixel == 32 && size >= 66 && readInt(data + 54) == 0x00FF0000
+                          && readInt(data + 58) == 0x0000FF00 && readInt(data + 62) == 0x000000FF;
+
+    if ((m_bitsPerPixel != 24 && m_bitsPerPixel != 32) || (compression != 0 && !standardFields))
+    {
+        throw invalid_argument("Only uncompressed 24 and 32 bit bitmaps are supported");
     }
 
-	delete [] data;
+    m_width = width;
+    m_height = height < 0 ? -height : height;
 
-	// Flipping R and B values since they are stored backwards in BMPs
-	m_pixelData->flipRBValues();
+    // Rows are padded to a multiple of 4 bytes
+    long long stride = ((long long) m_width * m_bitsPerPixel + 31) / 32 * 4;
 
-	m_fileName = fileName;
+    if (offset < 14 + headerSize || offset > size || (long long) (size - offset) / stride < m_height)
+    {
+        throw invalid_argument("Bitmap pixel data is truncated");
+    }
+
+    // Rows are viewed bottom-up, like an RGBPlane, so a top-down file is walked backwards
+    if (height > 0)
+    {
+        m_encoded = data + offset;
+        m_encodedStride = stride;
+    }
+    else
+    {
+        m_encoded = data + offset + (m_height - 1) * stride;
+        m_encodedStride = -stride;
+    }
 }
 
 /**
- * Constructs the BMPFile from a given pixel plane that was derived from somewhere else, and not necessarily a
- * file, unlike the original constructor
+ * Constructs the BMPFile from a copy of a given pixel plane that was derived from somewhere else, and not necessarily
+ * a file, unlike the original constructor
  *
  * @param plane The plane that represents the RGB values of this bitmap file
  */
-BMPFile::BMPFile(const RGBPlane& plane)
+BMPFile::BMPFile(const RGBPlane& plane) : BMPFile(plane.clone())
 {
-	m_fileName = NULL;
-    m_pixelData = new RGBPlane(plane);
+}
+
+/**
+ * Constructs the BMPFile from a given pixel plane, taking over its pixels rather than copying them
+ *
+ * @param plane The plane that represents the RGB values of this bitmap file, which is left empty
+ */
+BMPFile::BMPFile(RGBPlane&& plane)
+{
+    m_fileName = NULL;
     m_width = plane.getWidth();
-	m_height = plane.getHeight();
+    m_height = plane.getHeight();
+    m_pixels = make_shared<Pixels>();
+    m_pixels->plane.reset(new RGBPlane(move(plane)));
+    m_bitsPerPixel = 24;
+    m_encoded = nullptr;
+    m_encodedStride = 0;
+}
+
+/**
+ * Constructs the BMPFile over pixels held in a mapping, in the layout of an RGBPlane, without copying them. The
+ * mapping is kept alive as long as this bitmap (or any copy of it) is.
+ *
+ * @param mapping The mapping holding the pixels, which must be copy-on-write if the pixels are ever written to
+ * @param pixels The R, G, B values of the bitmap, row by row from the bottom, within the mapping
+ * @param width The width of the bitmap
+ * @param height The height of the bitmap
+ */
+BMPFile::BMPFile(shared_ptr<MappedFile> mapping, unsigned char* pixels, int width, int height)
+{
+    m_fileName = NULL;
+    m_mapping = mapping;
+    m_pixels = make_shared<Pixels>();
+    m_pixels->plane.reset(new RGBPlane(width, height, pixels));
+    m_width = width;
+    m_height = height;
+    m_bitsPerPixel = 24;
+    m_encoded = nullptr;
+    m_encodedStride = 0;
 }
 
 BMPFile::~BMPFile()
 {
-//    delete m_pixelData;
 }
 
 /**
- * Gets the pixel data array for this BMP
+ * Gets the pixel data array for this BMP. For a file, the pixels are decoded from the mapping on the first call, in a
+ * single pass that drops any alpha and swaps the B, G, R order of the file into R, G, B. The decode happens once, for
+ * this bitmap and every copy of it, however many threads ask for the plane at the same time.
  *
- * @return The pixel data array of the BMP
+ * @return The pixel data array of the BMP, which is deleted along with the last copy of this bitmap
  */
 RGBPlane* BMPFile::getPlane()
 {
-	return m_pixelData;
+    Pixels& pixels = *m_pixels;
+
+    call_once(pixels.decoded, [this, &pixels]()
+    {
+        if (pixels.plane != nullptr)
+        {
+            return;
+        }
+
+        trace::Scope scope("decode bmp");
+        int bytesPerPixel = m_bitsPerPixel / 8;
+        unique_ptr<RGBPlane> plane(new RGBPlane(m_width, m_height));
+
+        for (int y = 0; y < m_height; y++)
+        {
+            const unsigned char* src = getEncodedRow(y);
+            unsigned char* dst = plane->getRow(y);
+
+            for (int x = 0; x < m_width; x++, src += bytesPerPixel, dst += 3)
+            {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+            }
+        }
+
+        pixels.plane = move(plane);
+    });
+
+	return pixels.plane.get();
+}
+
+/**
+ * Whether this bitmap was read from a file, and so can be viewed in place through getEncodedRow
+ * @return True if the pixels of the file are mapped
+ */
+bool BMPFile::isMapped()
+{
+    return m_encoded != nullptr;
+}
+
+/**
+ * Gets a row of the pixels of the file exactly as they are stored in it (B, G, R and, for 32 bit files, A), without
+ * any copy or decoding. Rows are numbered bottom-up, like an RGBPlane, whatever the row order of the file.
+ *
+ * @param y The row to get
+ * @return Pointer to the first byte of the row within the mapped file (NOT A COPY)
+ * @throws invalid_argument If the bitmap was not read from a file, or the row is out of range
+ */
+const unsigned char* BMPFile::getEncodedRow(int y)
+{
+    if (m_encoded == nullptr || y < 0 || y >= m_height)
+    {
+        throw invalid_argument("Row is not available in the mapped bitmap file");
+    }
+
+    return m_encoded + y * m_encodedStride;
+}
+
+/**
+ * Gets the distance in bytes from one encoded row to the next (upwards), which is negative for a top-down file
+ * @return The stride of the encoded rows
+ */
+long long BMPFile::getEncodedStride()
+{
+    return m_encodedStride;
+}
+
+/**
+ * Gets the number of bits each pixel is stored in by the file (24 or 32)
+ * @return The bits per pixel
+ */
+int BMPFile::getBitsPerPixel()
+{
+    return m_bitsPerPixel;
 }
 
 /**
  * Writes the given pixel data array as a BMP, with the width and height provided used to determine the file size, and
- * for header information
+ * for header information. Rows are streamed straight from the array, so no copy of it is made
  *
  * @param width The width of the image
  * @param height The height of the image
  * @param pixelData The pixel array of R, G, B values. Assumes that the R and B values have not been switched, and that
  *        the array is still stored bottom-up
  * @param name The name of the file to save to (should include .bmp, i.e. "image.bmp")
+ * @see BMPWriter
  */
-void BMPFile::writeFile(int width, int height, unsigned char* pixelData, const char* name)
-{
-	int fileSize = 54 + 3 * width * height;
-
-	unsigned char bmpfileheader[14] = { 'B','M', 0,0,0,0, 0,0, 0,0, 54,0,0,0 };
-	unsigned char bmpinfoheader[40] = { 40,0,0,0, 0,0,0,0, 0,0,0,0, 1,0, 24,0 };
-	unsigned char bmppad[3] = {0, 0, 0};
-
-	bmpfileheader[2]  = (unsigned char)(fileSize);
-	bmpfileheader[3]  = (unsigned char)(fileSize >> 8);
-	bmpfileheader[4]  = (unsigned char)(fileSize >> 16);
-	bmpfileheader[5]  = (unsigned char)(fileSize >> 24);
-
-	bmpinfoheader[4]  = (unsigned char)(width);
-	bmpinfoheader[5]  = (unsigned char)(width >> 8);
-	bmpinfoheader[6]  = (unsigned char)(width >> 16);
-	bmpinfoheader[7]  = (unsigned char)(width >> 24);
-	bmpinfoheader[8]  = (unsigned char)(height);
-	bmpinfoheader[9]  = (unsigned char)(height >> 8);
-	bmpinfoheader[10] = (unsigned char)(height >> 16);
-	bmpinfoheader[11] = (unsigned char)(height >> 24);
-
-	int size = 3 * width * height;
-
-    unsigned char* outData = new unsigned char[size];
-
-    copy(pixelData, pixelData + size, outData);
-
-	for (int i = 0; i < size; i += 3) // Flip R and B back
-	{
-		unsigned char tmp = outData[i];
-        outData[i] = outData[i + 2];
-        outData[i + 2] = tmp;
-	}
-
-	FILE *f;
-	f = fopen(name, "wb");
-	fwrite(bmpfileheader, 1, 14, f);
-	fwrite(bmpinfoheader, 1, 40, f);
-	for (int i = 0; i < height; i++)
-	{
-		fwrite(outData + (width * (i) * 3), 3, width, f);
-		fwrite(bmppad, 1, (4 - (width * 3) % 4) % 4, f);
-	}
-	fclose(f);
-
-    delete [] outData;
+void BMPFile::writeFile(int width, int height, const unsigned char* pixelData, const char* name)
+{
+    trace::Scope scope("write bmp");
+    BMPWriter writer(name, width, height);
+
+    writer.writeRows(pixelData, height, width * 3LL);
+    writer.close();
 }
 
 /**
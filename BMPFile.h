@@ -2,11 +2,13 @@
  * Defines the object structure for BMP files. Handles the reading of a bmp file from a file name, and storing the
  * appropriate data as it is received from the header and bytes of the file.
  *
- * Reading of byte data routine taken from: http://stackoverflow.com/questions/9296059/read-pixel-value-in-bmp-file
- *
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 01-25-17
  * @version 1.1 - 02-18-17 - Construct from pixel data array rather than solely a file
+ * @version 1.2 - 03-26-17 - Files are memory mapped and validated, and only decoded when their plane is needed
+ * @version 1.3 - 04-06-17 - The plane is shared by every copy of the bitmap, and deleted with the last of them
+ * @version 1.4 - 04-07-17 - Construct by moving a plane in, rather than copying it
+ * @version 1.5 - 04-12-17 - The plane is decoded exactly once, even from several threads or copies of the bitmap
  */
 
 #ifndef WANGTILE_BMPFILE_H
@@ -16,23 +18,51 @@
 #include <fstream>
 #include <vector>
 #include <stdexcept>
+#include <memory>
+#include <mutex>
 #include "RGBPlane.h"
+#include "MappedFile.h"
 
 using namespace std;
 
 class BMPFile
 {
 private:
+    /**
+     * The pixels of the bitmap, shared by every copy of it (including those made before it was decoded), so that the
+     * file is decoded once for all of them
+     */
+    struct Pixels
+    {
+        once_flag decoded;
+        unique_ptr<RGBPlane> plane;
+    };
+
     const char* m_fileName;
-    RGBPlane* m_pixelData;
+    shared_ptr<Pixels> m_pixels;
 	int m_width;
     int m_height;
+    shared_ptr<MappedFile> m_mapping;
+    const unsigned char* m_encoded;
+    long long m_encodedStride;
+    int m_bitsPerPixel;
+
 public:
 	BMPFile(const char*);
 	BMPFile(const RGBPlane&);
+    BMPFile(RGBPlane&&);
+    BMPFile(shared_ptr<MappedFile>, unsigned char*, int, int);
+    BMPFile(const BMPFile&) = default;
+    BMPFile(BMPFile&&) = default;
+    BMPFile& operator=(const BMPFile&) = default;
+    BMPFile& operator=(BMPFile&&) = default;
     RGBPlane* getPlane();
+    bool isMapped();
+    const unsigned char* getEncodedRow(int);
+    long long getEncodedStride();
+    int getBitsPerPixel();
     const char* getFileName();
-	static void writeFile(int, int, unsigned char*, const char*);
+	static void writeFile(int, int, const unsigned char*, const char*);
     int getWidth();
     int getHeight();
     unsigned char* getPixelRegion(unsigned int, unsigned int, unsigned int, unsigned int);
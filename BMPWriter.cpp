@@ -0,0 +1,173 @@
+/**
+ * The BMPWriter class writes a 24 bit BMP file one scanline at a time, so that images far larger than memory (such as
+ * a whole TileMap) can be written while only ever holding a single row. Rows are given in the bottom-up order they are
+ * stored in, both in the file and in an RGBPlane.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/24/17
+ */
+
+#include <stdexcept>
+#include "BMPWriter.h"
+
+/**
+ * Creates the file and writes its header
+ *
+ * @param name The name of the file to save to (should include .bmp, i.e. "image.bmp")
+ * @param width The width of the image
+ * @param height The height of the image
+ * @throws invalid_argument If the size is not positive, or the file cannot be created or its header written
+ */
+BMPWriter::BMPWriter(const char* name, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+    {
+        throw invalid_argument("Width and height of a bitmap must be positive");
+    }
+
+    m_file = fopen(name, "wb");
+
+    if (m_file == NULL)
+    {
+        throw invalid_argument("Could not open bitmap file for writing");
+    }
+
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+
+    // A constructor that throws is never followed by the destructor, so the file is closed here
+    try
+    {
+        // Rows are padded to a multiple of 4 bytes, and the padding stays zero
+        m_row.assign((width * 3LL + 3) / 4 * 4, 0);
+
+        writeHeader();
+    }
+    catch (...)
+    {
+        fclose(m_file);
+        throw;
+    }
+}
+
+BMPWriter::~BMPWriter()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+    }
+}
+
+/**
+ * Writes the file and info headers. The size fields of the header are 32 bit, so for images over 4GB they are set to 0,
+ * which readers take to mean the size follows from the width and height
+ */
+void BMPWriter::writeHeader()
+{
+    unsigned long long imageSize = (unsigned long long) m_row.size() * m_height;
+    unsigned long long fileSize = 54 + imageSize;
+
+    if (fileSize > 0xFFFFFFFFULL)
+    {
+        imageSize = 0;
+        fileSize = 0;
+    }
+
+    unsigned char header[54] = { 'B','M', 0,0,0,0, 0,0, 0,0, 54,0,0,0, 40,0,0,0, 0,0,0,0, 0,0,0,0, 1,0, 24,0 };
+
+    for (int i = 0; i < 4; i++)
+    {
+        header[2 + i] = (unsigned char) (fileSize >> (8 * i));
+        header[18 + i] = (unsigned char) (m_width >> (8 * i));
+        header[22 + i] = (unsigned char) (m_height >> (8 * i));
+        header[34 + i] = (unsigned char) (imageSize >> (8 * i));
+    }
+
+    if (fwrite(header, 1, 54, m_file) != 54)
+    {
+        throw invalid_argument("Could not write bitmap header");
+    }
+}
+
+/**
+ * Writes the next row of the image, swapping its R and B values into the order of the file
+ *
+ * @param pixels The R, G, B values of the row (3 * width bytes)
+ * @throws invalid_argument If every row has already been written, or the write fails
+ */
+void BMPWriter::writeRow(const unsigned char* pixels)
+{
+    if (m_file == NULL || m_rowsWritten >= m_height)
+    {
+        throw invalid_argument("Bitmap already has all of its rows");
+    }
+
+    unsigned char* row = m_row.data();
+
+    for (int i = 0; i < m_width * 3; i += 3)
+    {
+        row[i] = pixels[i + 2];
+        row[i + 1] = pixels[i + 1];
+        row[i + 2] = pixels[i];
+    }
+
+    if (fwrite(row, 1, m_row.size(), m_file) != m_row.size())
+    {
+        throw invalid_argument("Could not write bitmap row");
+    }
+
+    m_rowsWritten++;
+}
+
+/**
+ * Writes the next rows of the image from a block of consecutive rows, such as a band of an RGBPlane
+ *
+ * @param pixels The R, G, B values of the first row
+ * @param count The number of rows to write
+ * @param stride The distance in bytes between the starts of two rows of the block
+ */
+void BMPWriter::writeRows(const unsigned char* pixels, int count, long long stride)
+{
+    for (int i = 0; i < count; i++)
+    {
+        writeRow(pixels + i * stride);
+    }
+}
+
+/**
+ * Gets the number of rows written so far
+ * @return The row count
+ */
+int BMPWriter::getRowsWritten()
+{
+    return m_rowsWritten;
+}
+
+/**
+ * Finishes the file
+ *
+ * @throws invalid_argument If not every row of the image was written, or the file could not be flushed
+ */
+void BMPWriter::close()
+{
+    if (m_file == NULL)
+    {
+        return;
+    }
+
+    bool complete = m_rowsWritten == m_height;
+    bool flushed = fclose(m_file) == 0;
+
+    m_file = NULL;
+
+    if (!complete)
+    {
+        throw invalid_argument("Bitmap closed before all of its rows were written");
+    }
+
+    if (!flushed)
+    {
+        throw invalid_argument("Could not finish writing bitmap file");
+    }
+}
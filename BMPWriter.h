@@ -0,0 +1,41 @@
+/**
+ * The BMPWriter class writes a 24 bit BMP file one scanline at a time, so that images far larger than memory (such as
+ * a whole TileMap) can be written while only ever holding a single row. Rows are given in the bottom-up order they are
+ * stored in, both in the file and in an RGBPlane.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/24/17
+ */
+
+#ifndef WANGTILE_BMPWRITER_H
+#define WANGTILE_BMPWRITER_H
+
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+class BMPWriter
+{
+private:
+    FILE* m_file;
+    int m_width;
+    int m_height;
+    int m_rowsWritten;
+    vector<unsigned char> m_row;
+
+    void writeHeader();
+
+public:
+    BMPWriter(const char*, int, int);
+    BMPWriter(const BMPWriter&) = delete;
+    BMPWriter& operator=(const BMPWriter&) = delete;
+    void writeRow(const unsigned char*);
+    void writeRows(const unsigned char*, int, long long);
+    int getRowsWritten();
+    void close();
+
+    virtual ~BMPWriter();
+};
+
+#endif //WANGTILE_BMPWRITER_H
@@ -0,0 +1,532 @@
+/**
+ * The CandidateIndex class is an approximate nearest neighbour index over a (dense) set of candidate patches, keyed on
+ * their overlap regions. Each overlap strip is reduced to a small grid of block means, the descriptors are projected
+ * onto their principal components, and the projections are stored in a KD-tree that is searched best-bin-first.
+ *
+ * The block means are weighted so that the distance between two descriptors never exceeds the true sum of squared
+ * differences of the overlaps they describe, so the nearest descriptors are good candidates to rescore exactly.
+ *
+ * There is one index per overlap configuration (left only, top only, or both), since each describes a different
+ * region of the candidates.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/18/17
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <stdexcept>
+#include "CandidateIndex.h"
+#include "Quilt.h"
+
+/**
+ * Builds the index over the given candidates
+ *
+ * @param source The plane the candidates look onto
+ * @param candidates The candidate views to index. The indices returned by CandidateIndex::findNearest refer to
+ *                   positions in this list
+ * @param patchSize The side length of the candidates
+ * @param useLeft True if the candidates will be queried against a patch to their left
+ * @param useTop True if the candidates will be queried against a patch above them
+ * @throws invalid_argument If there is no overlap region to index
+ */
+CandidateIndex::CandidateIndex(const RGBPlane& source, const vector<PatchView>& candidates, int patchSize, bool useLeft, bool useTop)
+{
+    m_patchSize = patchSize;
+    m_overlap = patchSize / Quilt::OVERLAP_DIVISOR;
+    m_useLeft = useLeft;
+    m_useTop = useTop;
+
+    if (m_overlap == 0 || (!useLeft && !useTop) || candidates.empty())
+    {
+        throw invalid_argument("Candidate index needs candidates with a non-empty overlap region");
+    }
+
+    // The same region as Patch::getOverlapScore, the top strip takes the corner when both are used
+    if (useTop)
+    {
+        addStripCells(true, 0, 0, m_patchSize, m_overlap);
+    }
+
+    if (useLeft)
+    {
+        addStripCells(false, 0, useTop ? m_overlap : 0, m_overlap, m_patchSize);
+    }
+
+    int size = getDescriptorSize();
+    int width = source.getWidth();
+    int height = source.getHeight();
+    int sumWidth = width + 1;
+
+    // Summed-area table of each channel, so every block sum of every candidate is four lookups
+    vector<uint32_t> sums((long long) sumWidth * (height + 1) * 3, 0);
+
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* row = source.getRow(y);
+        uint32_t rowSum[3] = {0, 0, 0};
+
+        for (int x = 0; x < width; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                rowSum[c] += row[x * 3 + c];
+                sums[((long long) (y + 1) * sumWidth + x + 1) * 3 + c] = sums[((long long) y * sumWidth + x + 1) * 3 + c] + rowSum[c];
+            }
+        }
+    }
+
+    auto describe = [&](const PatchView& view, float* out)
+    {
+        for (size_t i = 0; i < m_cells.size(); i++)
+        {
+            const Cell& cell = m_cells[i];
+            long long x1 = view.getX() + cell.x1;
+            long long y1 = view.getY() + cell.y1;
+            long long x2 = view.getX() + cell.x2;
+            long long y2 = view.getY() + cell.y2;
+
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t sum = sums[(y2 * sumWidth + x2) * 3 + c] - sums[(y1 * sumWidth + x2) * 3 + c]
+                               - sums[(y2 * sumWidth + x1) * 3 + c] + sums[(y1 * sumWidth + x1) * 3 + c];
+
+                out[i * 3 + c] = sum * cell.weight;
+            }
+        }
+    };
+
+    // The principal components are estimated from an evenly spread sample, so the full set of descriptors never
+    // has to be held at once
+    int sampleCount = min((int) candidates.size(), 4096);
+    vector<float> samples((long long) sampleCount * size);
+
+    for (int i = 0; i < sampleCount; i++)
+    {
+        describe(candidates[(long long) i * candidates.size() / sampleCount], &samples[(long long) i * size]);
+    }
+
+    computeBasis(samples, sampleCount);
+
+    vector<float> descriptor(size);
+
+    m_points.resize(candidates.size() * m_components);
+    m_order.resize(candidates.size());
+
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        describe(candidates[i], descriptor.data());
+        project(descriptor.data(), &m_points[(long long) i * m_components]);
+        m_order[i] = i;
+    }
+
+    buildTree(0, candidates.size());
+}
+
+/**
+ * Splits a strip of the overlap region into the grid of cells whose means make up the descriptor
+ *
+ * @param top True for the top strip (runs along x), false for the left strip (runs along y)
+ * @param x1 The left edge of the strip, in the space of the candidate (inclusive)
+ * @param y1 The top edge of the strip, in the space of the candidate (inclusive)
+ * @param x2 The right edge of the strip, in the space of the candidate (exclusive)
+ * @param y2 The bottom edge of the strip, in the space of the candidate (exclusive)
+ */
+void CandidateIndex::addStripCells(bool top, int x1, int y1, int x2, int y2)
+{
+    int along = top ? x2 - x1 : y2 - y1;
+    int across = top ? y2 - y1 : x2 - x1;
+    int alongCells = min(along, (int) ALONG_CELLS);
+    int acrossCells = min(across, (int) ACROSS_CELLS);
+
+    for (int a = 0; a < alongCells; a++)
+    {
+        int alongStart = a * along / alongCells;
+        int alongEnd = (a + 1) * along / alongCells;
+
+        for (int b = 0; b < acrossCells; b++)
+        {
+            int acrossStart = b * across / acrossCells;
+            int acrossEnd = (b + 1) * across / acrossCells;
+            Cell cell;
+
+            cell.top = top;
+            cell.x1 = x1 + (top ? alongStart : acrossStart);
+            cell.x2 = x1 + (top ? alongEnd : acrossEnd);
+            cell.y1 = y1 + (top ? acrossStart : alongStart);
+            cell.y2 = y1 + (top ? acrossEnd : alongEnd);
+
+            // sum / sqrt(area) = mean * sqrt(area), and area * (mean difference)^2 is at most the squared
+            // difference of the pixels it averages
+            cell.weight = 1.0f / sqrt((float) (cell.x2 - cell.x1) * (cell.y2 - cell.y1));
+
+            m_cells.push_back(cell);
+        }
+    }
+}
+
+/**
+ * Gets the length of the full (unprojected) descriptor of a candidate
+ *
+ * @return The number of values in a descriptor, 3 per cell
+ */
+int CandidateIndex::getDescriptorSize() const
+{
+    return m_cells.size() * 3;
+}
+
+/**
+ * Computes the mean and the leading principal components of the given descriptors, with a cyclic Jacobi
+ * eigendecomposition of their covariance
+ *
+ * @param samples The sample descriptors, back to back
+ * @param count The number of sample descriptors
+ */
+void CandidateIndex::computeBasis(const vector<float>& samples, int count)
+{
+    int size = getDescriptorSize();
+    vector<double> mean(size, 0);
+    vector<double> covariance(size * size, 0);
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int k = 0; k < size; k++)
+        {
+            mean[k] += samples[(long long) i * size + k];
+        }
+    }
+
+    for (int k = 0; k < size; k++)
+    {
+        mean[k] /= count;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        const float* sample = &samples[(long long) i * size];
+
+        for (int a = 0; a < size; a++)
+        {
+            double da = sample[a] - mean[a];
+
+            for (int b = a; b < size; b++)
+            {
+                covariance[a * size + b] += da * (sample[b] - mean[b]);
+            }
+        }
+    }
+
+    for (int a = 0; a < size; a++)
+    {
+        for (int b = a; b < size; b++)
+        {
+            covariance[a * size + b] /= count;
+            covariance[b * size + a] = covariance[a * size + b];
+        }
+    }
+
+    // Cyclic Jacobi: rotate away the off-diagonal entries one at a time, accumulating the rotations as eigenvectors
+    vector<double> vectors(size * size, 0);
+
+    for (int k = 0; k < size; k++)
+    {
+        vectors[k * size + k] = 1;
+    }
+
+    for (int sweep = 0; sweep < 50; sweep++)
+    {
+        double offDiagonal = 0;
+
+        for (int a = 0; a < size; a++)
+        {
+            for (int b = a + 1; b < size; b++)
+            {
+                offDiagonal += covariance[a * size + b] * covariance[a * size + b];
+            }
+        }
+
+        if (offDiagonal < 1e-12)
+        {
+            break;
+        }
+
+        for (int p = 0; p < size; p++)
+        {
+            for (int q = p + 1; q < size; q++)
+            {
+                double apq = covariance[p * size + q];
+
+                if (fabs(apq) < 1e-15)
+                {
+                    continue;
+                }
+
+                double theta = (covariance[q * size + q] - covariance[p * size + p]) / (2 * apq);
+                double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                double c = 1 / sqrt(t * t + 1);
+                double s = t * c;
+
+                for (int k = 0; k < size; k++)
+                {
+                    double akp = covariance[k * size + p];
+                    double akq = covariance[k * size + q];
+
+                    covariance[k * size + p] = c * akp - s * akq;
+                    covariance[k * size + q] = s * akp + c * akq;
+                }
+
+                for (int k = 0; k < size; k++)
+                {
+                    double apk = covariance[p * size + k];
+                    double aqk = covariance[q * size + k];
+
+                    covariance[p * size + k] = c * apk - s * aqk;
+                    covariance[q * size + k] = s * apk + c * aqk;
+                }
+
+                for (int k = 0; k < size; k++)
+                {
+                    double vkp = vectors[k * size + p];
+                    double vkq = vectors[k * size + q];
+
+                    vectors[k * size + p] = c * vkp - s * vkq;
+                    vectors[k * size + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    vector<int> ranking(size);
+
+    for (int k = 0; k < size; k++)
+    {
+        ranking[k] = k;
+    }
+
+    sort(ranking.begin(), ranking.end(), [&](int a, int b)
+    {
+        return covariance[a * size + a] > covariance[b * size + b];
+    });
+
+    m_components = min(size, (int) MAX_COMPONENTS);
+    m_mean.assign(mean.begin(), mean.end());
+    m_basis.resize(m_components * size);
+
+    for (int j = 0; j < m_components; j++)
+    {
+        for (int k = 0; k < size; k++)
+        {
+            m_basis[j * size + k] = vectors[k * size + ranking[j]];
+        }
+    }
+}
+
+/**
+ * Projects a full descriptor onto the principal components. The basis is orthonormal, so distances can only shrink
+ *
+ * @param descriptor The full descriptor
+ * @param out Filled with the projected point (one value per component)
+ */
+void CandidateIndex::project(const float* descriptor, float* out) const
+{
+    int size = getDescriptorSize();
+
+    for (int j = 0; j < m_components; j++)
+    {
+        const float* axis = &m_basis[j * size];
+        float value = 0;
+
+        for (int k = 0; k < size; k++)
+        {
+            value += (descriptor[k] - m_mean[k]) * axis[k];
+        }
+
+        out[j] = value;
+    }
+}
+
+/**
+ * Recursively builds the KD-tree over a range of the point order, splitting at the median of the dimension with the
+ * largest spread
+ *
+ * @param begin The start of the range of points (inclusive)
+ * @param end The end of the range of points (exclusive)
+ * @return The index of the node that was made for the range
+ */
+int CandidateIndex::buildTree(int begin, int end)
+{
+    Node node;
+
+    node.dimension = -1;
+    node.split = 0;
+    node.children[0] = node.children[1] = -1;
+    node.begin = begin;
+    node.end = end;
+
+    int index = m_nodes.size();
+    m_nodes.push_back(node);
+
+    if (end - begin <= LEAF_SIZE)
+    {
+        return index;
+    }
+
+    int dimension = 0;
+    float bestSpread = -1;
+
+    for (int d = 0; d < m_components; d++)
+    {
+        float low = m_points[(long long) m_order[begin] * m_components + d];
+        float high = low;
+
+        for (int i = begin + 1; i < end; i++)
+        {
+            float value = m_points[(long long) m_order[i] * m_components + d];
+            low = min(low, value);
+            high = max(high, value);
+        }
+
+        if (high - low > bestSpread)
+        {
+            bestSpread = high - low;
+            dimension = d;
+        }
+    }
+
+    int middle = begin + (end - begin) / 2;
+
+    nth_element(m_order.begin() + begin, m_order.begin() + middle, m_order.begin() + end, [&](int a, int b)
+    {
+        return m_points[(long long) a * m_components + dimension] < m_points[(long long) b * m_components + dimension];
+    });
+
+    m_nodes[index].dimension = dimension;
+    m_nodes[index].split = m_points[(long long) m_order[middle] * m_components + dimension];
+
+    int lower = buildTree(begin, middle);
+    int upper = buildTree(middle, end);
+
+    m_nodes[index].children[0] = lower;
+    m_nodes[index].children[1] = upper;
+
+    return index;
+}
+
+/**
+ * Finds (approximately) the candidates whose overlap regions are closest to the overlap of the given neighbours.
+ * The tree is searched best-bin-first, giving up after MAX_LEAF_CHECKS leaves. Safe to call from several threads.
+ *
+ * @param left The patch to the left of the one being placed, must be given if and only if the index uses the left
+ *             overlap
+ * @param top The patch above the one being placed, must be given if and only if the index uses the top overlap
+ * @param count The number of candidates to find
+ * @param nearest Filled with the positions (in the candidate list the index was built from) of the nearest
+ *                candidates, in ascending order of position
+ * @throws invalid_argument If the given neighbours do not match the overlap configuration of the index
+ */
+void CandidateIndex::findNearest(Patch* left, Patch* top, int count, vector<int>& nearest) const
+{
+    if ((left != nullptr) != m_useLeft || (top != nullptr) != m_useTop)
+    {
+        throw invalid_argument("Neighbours do not match the overlap configuration of the candidate index");
+    }
+
+    int size = getDescriptorSize();
+    vector<float> descriptor(size);
+    vector<float> query(m_components);
+
+    for (size_t i = 0; i < m_cells.size(); i++)
+    {
+        const Cell& cell = m_cells[i];
+        RGBPlane* plane = cell.top ? top->getRGBPlane() : left->getRGBPlane();
+        int offsetX = cell.top ? 0 : m_patchSize - m_overlap;
+        int offsetY = cell.top ? m_patchSize - m_overlap : 0;
+        long long sum[3] = {0, 0, 0};
+
+        // The neighbours may be in either layout
+        for (int y = cell.y1; y < cell.y2; y++)
+        {
+            for (int x = cell.x1; x < cell.x2; x++)
+            {
+                sum[0] += plane->getSample(offsetX + x, offsetY + y, 0);
+                sum[1] += plane->getSample(offsetX + x, offsetY + y, 1);
+                sum[2] += plane->getSample(offsetX + x, offsetY + y, 2);
+            }
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            descriptor[i * 3 + c] = sum[c] * cell.weight;
+        }
+    }
+
+    project(descriptor.data(), query.data());
+
+    typedef pair<float, int> Entry;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> branches;
+    priority_queue<Entry> best;
+    int checks = 0;
+
+    branches.push(Entry(0.0f, 0));
+
+    while (!branches.empty() && checks < MAX_LEAF_CHECKS)
+    {
+        Entry branch = branches.top();
+        branches.pop();
+
+        if (best.size() == (size_t) count && branch.first >= best.top().first)
+        {
+            break;
+        }
+
+        int index = branch.second;
+
+        while (m_nodes[index].dimension >= 0)
+        {
+            const Node& node = m_nodes[index];
+            float diff = query[node.dimension] - node.split;
+            int near = diff < 0 ? 0 : 1;
+
+            branches.push(Entry(max(branch.first, diff * diff), node.children[1 - near]));
+            index = node.children[near];
+        }
+
+        const Node& leaf = m_nodes[index];
+
+        for (int i = leaf.begin; i < leaf.end; i++)
+        {
+            const float* point = &m_points[(long long) m_order[i] * m_components];
+            float distance = 0;
+
+            for (int d = 0; d < m_components; d++)
+            {
+                float diff = query[d] - point[d];
+                distance += diff * diff;
+            }
+
+            if (best.size() < (size_t) count)
+            {
+                best.push(Entry(distance, m_order[i]));
+            }
+            else if (distance < best.top().first)
+            {
+                best.pop();
+                best.push(Entry(distance, m_order[i]));
+            }
+        }
+
+        checks++;
+    }
+
+    nearest.clear();
+
+    while (!best.empty())
+    {
+        nearest.push_back(best.top().second);
+        best.pop();
+    }
+
+    sort(nearest.begin(), nearest.end());
+}
@@ -0,0 +1,77 @@
+/**
+ * The CandidateIndex class is an approximate nearest neighbour index over a (dense) set of candidate patches, keyed on
+ * their overlap regions. Each overlap strip is reduced to a small grid of block means, the descriptors are projected
+ * onto their principal components, and the projections are stored in a KD-tree that is searched best-bin-first.
+ *
+ * The block means are weighted so that the distance between two descriptors never exceeds the true sum of squared
+ * differences of the overlaps they describe, so the nearest descriptors are good candidates to rescore exactly.
+ *
+ * There is one index per overlap configuration (left only, top only, or both), since each describes a different
+ * region of the candidates.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/18/17
+ */
+
+#ifndef WANGTILE_CANDIDATEINDEX_H
+#define WANGTILE_CANDIDATEINDEX_H
+
+#include <vector>
+#include "RGBPlane.h"
+#include "PatchView.h"
+#include "Patch.h"
+
+using namespace std;
+
+class CandidateIndex
+{
+private:
+    struct Cell
+    {
+        bool top;
+        int x1;
+        int y1;
+        int x2;
+        int y2;
+        float weight;
+    };
+
+    struct Node
+    {
+        int dimension;
+        float split;
+        int children[2];
+        int begin;
+        int end;
+    };
+
+    int m_patchSize;
+    int m_overlap;
+    bool m_useLeft;
+    bool m_useTop;
+    vector<Cell> m_cells;
+    vector<float> m_mean;
+    vector<float> m_basis;
+    int m_components;
+    vector<float> m_points;
+    vector<int> m_order;
+    vector<Node> m_nodes;
+
+    void addStripCells(bool, int, int, int, int);
+    void computeBasis(const vector<float>&, int);
+    void project(const float*, float*) const;
+    int buildTree(int, int);
+
+public:
+    const static int ALONG_CELLS = 8;
+    const static int ACROSS_CELLS = 2;
+    const static int MAX_COMPONENTS = 16;
+    const static int LEAF_SIZE = 8;
+    const static int MAX_LEAF_CHECKS = 128;
+
+    CandidateIndex(const RGBPlane&, const vector<PatchView>&, int, bool, bool);
+    void findNearest(Patch*, Patch*, int, vector<int>&) const;
+    int getDescriptorSize() const;
+};
+
+#endif //WANGTILE_CANDIDATEINDEX_H
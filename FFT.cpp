@@ -0,0 +1,197 @@
+/**
+ * Houses a small radix-2 fast Fourier transform used to evaluate the overlap error of every candidate patch position
+ * in a source image at once (cross-correlation in the frequency domain)
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/12/17
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "FFT.h"
+
+namespace fft
+{
+    /**
+     * Gets the smallest power of two that is greater than or equal to the given value
+     *
+     * @param value The value to round up
+     * @return The next power of two
+     */
+    int nextPowerOfTwo(int value)
+    {
+        int n = 1;
+
+        while (n < value)
+        {
+            n <<= 1;
+        }
+
+        return n;
+    }
+
+    /**
+     * In-place iterative radix-2 transform of a contiguous sequence. The inverse transform is NOT scaled by 1/n, the
+     * caller is responsible for that.
+     *
+     * @param data The sequence to transform
+     * @param n The length of the sequence, must be a power of two
+     * @param inverse True for the inverse transform, false for the forward transform
+     * @throws invalid_argument If n is not a power of two
+     */
+    void transform(complex<double>* data, int n, bool inverse)
+    {
+        if (n == 1)
+        {
+            return;
+        }
+
+        if (n <= 0 || (n & (n - 1)) != 0)
+        {
+            throw invalid_argument("FFT length must be a power of two");
+        }
+
+        // Twiddle factors are cached per thread, since the same length is transformed thousands of times per quilt
+        thread_local vector<vector<complex<double>>> twiddleTables(32);
+        int log2n = 0;
+
+        while ((1 << log2n) < n)
+        {
+            log2n++;
+        }
+
+        vector<complex<double>>& twiddles = twiddleTables[log2n];
+
+        if (twiddles.size() != (size_t) n / 2)
+        {
+            twiddles.resize(n / 2);
+
+            for (int i = 0; i < n / 2; i++)
+            {
+                double angle = -2.0 * M_PI * i / n;
+                twiddles[i] = complex<double>(cos(angle), sin(angle));
+            }
+        }
+
+        // Bit reversal permutation
+        for (int i = 1, j = 0; i < n; i++)
+        {
+            int bit = n >> 1;
+
+            for (; j & bit; bit >>= 1)
+            {
+                j ^= bit;
+            }
+
+            j ^= bit;
+
+            if (i < j)
+            {
+                swap(data[i], data[j]);
+            }
+        }
+
+        // The butterflies spell out the complex product, since operator* on complex<double> goes through a
+        // NaN-checking library call
+        double sign = inverse ? -1.0 : 1.0;
+
+        for (int len = 2; len <= n; len <<= 1)
+        {
+            int half = len / 2;
+            int step = n / len;
+
+            for (int i = 0; i < n; i += len)
+            {
+                for (int k = 0; k < half; k++)
+                {
+                    double wr = twiddles[k * step].real();
+                    double wi = sign * twiddles[k * step].imag();
+                    complex<double> u = data[i + k];
+                    complex<double> b = data[i + k + half];
+                    double vr = b.real() * wr - b.imag() * wi;
+                    double vi = b.real() * wi + b.imag() * wr;
+
+                    data[i + k] = complex<double>(u.real() + vr, u.imag() + vi);
+                    data[i + k + half] = complex<double>(u.real() - vr, u.imag() - vi);
+                }
+            }
+        }
+    }
+
+    /**
+     * In-place 2D transform of a row-major grid. The inverse transform is scaled so that a forward/inverse round trip
+     * returns the original values.
+     *
+     * @param data The grid to transform, of size width * height
+     * @param width The width of the grid, must be a power of two
+     * @param height The height of the grid, must be a power of two
+     * @param inverse True for the inverse transform, false for the forward transform
+     * @param rows For the forward transform, the number of leading rows that may hold non-zero values (the row
+     *             transforms of the remaining zero rows are skipped). For the inverse transform, the number of leading
+     *             rows of the result that are actually needed (the rest are left partially transformed). Pass height
+     *             if unknown
+     */
+    void transform2D(vector<complex<double>>& data, int width, int height, bool inverse, int rows)
+    {
+        rows = min(rows, height);
+
+        // Columns are gathered a few at a time so every cache line pulled in from a row is fully used
+        const int block = 8;
+        thread_local vector<complex<double>> columns;
+        columns.resize(block * height);
+
+        // The zero/unneeded rows are only skippable on the row pass, so it goes first when transforming forward and
+        // last when transforming back
+        if (!inverse)
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                transform(&data[y * width], width, false);
+            }
+        }
+
+        for (int x = 0; x < width; x += block)
+        {
+            int count = min(block, width - x);
+
+            for (int y = 0; y < height; y++)
+            {
+                for (int k = 0; k < count; k++)
+                {
+                    columns[k * height + y] = data[y * width + x + k];
+                }
+            }
+
+            for (int k = 0; k < count; k++)
+            {
+                transform(&columns[k * height], height, inverse);
+            }
+
+            for (int y = 0; y < height; y++)
+            {
+                for (int k = 0; k < count; k++)
+                {
+                    data[y * width + x + k] = columns[k * height + y];
+                }
+            }
+        }
+
+        if (inverse)
+        {
+            double scale = 1.0 / ((double) width * height);
+
+            for (int y = 0; y < rows; y++)
+            {
+                complex<double>* row = &data[y * width];
+
+                transform(row, width, true);
+
+                for (int x = 0; x < width; x++)
+                {
+                    row[x] *= scale;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,24 @@
+/**
+ * Houses a small radix-2 fast Fourier transform used to evaluate the overlap error of every candidate patch position
+ * in a source image at once (cross-correlation in the frequency domain)
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/12/17
+ */
+
+#ifndef WANGTILE_FFT_H
+#define WANGTILE_FFT_H
+
+#include <complex>
+#include <vector>
+
+using namespace std;
+
+namespace fft
+{
+    int nextPowerOfTwo(int);
+    void transform(complex<double>*, int, bool);
+    void transform2D(vector<complex<double>>&, int, int, bool, int);
+};
+
+#endif //WANGTILE_FFT_H
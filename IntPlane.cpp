@@ -23,26 +23,91 @@ IntPlane::IntPlane(int width, int height)
 {
     m_width = width;
     m_height = height;
-    m_pixelData = new int[width * height];
+    m_pixelData = new int[(size_t) width * height];
+    m_ownsPixels = true;
 }
 
 /**
- * Copy constructor for the IntPlane
+ * Constructs the plane with its values carved from an arena, which frees them when it is reset rather than this plane
+ * when it is deleted. The values are not initialized.
  *
- * @param plane The reference to the IntPlane this new IntPlane will be copied from
+ * @param width The width of the plane
+ * @param height The height of the plane
+ * @param arena The arena to allocate the values from, which must not be reset while this plane is in use
+ */
+IntPlane::IntPlane(int width, int height, Arena& arena)
+{
+    m_width = width;
+    m_height = height;
+    m_pixelData = arena.allocateArray<int>((size_t) width * height);
+    m_ownsPixels = false;
+}
+
+/**
+ * Move constructor. Takes over the values of the given plane, which is left empty
+ *
+ * @param plane The plane to take the values of
  */
-IntPlane::IntPlane(const IntPlane& plane)
+IntPlane::IntPlane(IntPlane&& plane)
 {
     m_width = plane.m_width;
     m_height = plane.m_height;
-    m_pixelData = new int[m_width * m_height];
+    m_pixelData = plane.m_pixelData;
+    m_ownsPixels = plane.m_ownsPixels;
+    plane.m_width = 0;
+    plane.m_height = 0;
+    plane.m_pixelData = nullptr;
+    plane.m_ownsPixels = false;
+}
 
-    copy(plane.m_pixelData, plane.m_pixelData + (plane.m_width * plane.m_height), m_pixelData);
+/**
+ * Move assignment. Frees the values of this plane, and takes over those of the given one, which is left empty
+ *
+ * @param plane The plane to take the values of
+ * @return This plane
+ */
+IntPlane& IntPlane::operator=(IntPlane&& plane)
+{
+    if (this != &plane)
+    {
+        if (m_ownsPixels)
+        {
+            delete [] m_pixelData;
+        }
+
+        m_width = plane.m_width;
+        m_height = plane.m_height;
+        m_pixelData = plane.m_pixelData;
+        m_ownsPixels = plane.m_ownsPixels;
+        plane.m_width = 0;
+        plane.m_height = 0;
+        plane.m_pixelData = nullptr;
+        plane.m_ownsPixels = false;
+    }
+
+    return *this;
+}
+
+/**
+ * Makes a deep copy of this plane, which owns its values even if this plane's come from an arena
+ *
+ * @return The copy
+ */
+IntPlane IntPlane::clone() const
+{
+    IntPlane plane(m_width, m_height);
+
+    copy(m_pixelData, m_pixelData + (long long) m_width * m_height, plane.m_pixelData);
+
+    return plane;
 }
 
 IntPlane::~IntPlane()
 {
-    delete [] m_pixelData;
+    if (m_ownsPixels)
+    {
+        delete [] m_pixelData;
+    }
 }
 
 /**
@@ -52,9 +117,9 @@ IntPlane::~IntPlane()
  * @param y The y value of the point
  * @return The index of the specified point in the array
  */
-int IntPlane::getIndexFromPoint(int x, int y)
+long long IntPlane::getIndexFromPoint(int x, int y)
 {
-    return (y * m_width + x);
+    return (long long) y * m_width + x;
 }
 
 /**
@@ -99,7 +164,17 @@ void IntPlane::setPixelValueAt(int x, int y, int value)
  */
 void IntPlane::fill(int value)
 {
-	std::fill(m_pixelData, m_pixelData + (m_width * m_height), value);
+	std::fill(m_pixelData, m_pixelData + (long long) m_width * m_height, value);
+}
+
+int IntPlane::getWidth() const
+{
+    return m_width;
+}
+
+int IntPlane::getHeight() const
+{
+    return m_height;
 }
 
 /**
@@ -1,5 +1,6 @@
 /**
- * The IntPlane class represents an XY plane of pixels, and the integer value each of these pixels holds.
+ * The IntPlane class represents an XY plane of pixels, and the integer value each of these pixels holds. Like an
+ * RGBPlane it can be moved but not copied, see IntPlane::clone.
  *
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 02/25/17
@@ -8,6 +9,7 @@
 #ifndef WANGTILE_INTPLANE_H
 #define WANGTILE_INTPLANE_H
 
+#include "Arena.h"
 
 class IntPlane
 {
@@ -15,16 +17,41 @@ private:
     int* m_pixelData;
     int m_width;
     int m_height;
+    bool m_ownsPixels;
 
-    int getIndexFromPoint(int, int);
+    long long getIndexFromPoint(int, int);
 
 public:
     IntPlane(int, int);
-    IntPlane(const IntPlane&);
+    IntPlane(int, int, Arena&);
+    IntPlane(const IntPlane&) = delete;
+    IntPlane(IntPlane&&);
+    IntPlane& operator=(const IntPlane&) = delete;
+    IntPlane& operator=(IntPlane&&);
+    IntPlane clone() const;
     int getPixelValueAt(int, int);
     void setPixelValueAt(int, int, int);
 	void fill(int);
 	void print();
+    int getWidth() const;
+    int getHeight() const;
+
+    /**
+     * Unchecked access to the start of a row of the plane. For use in inner loops, where the bounds are already known
+     * to be valid
+     *
+     * @param y The row to get
+     * @return Pointer to the first value of the row (NOT A COPY)
+     */
+    int* getRow(int y)
+    {
+        return m_pixelData + (long long) y * m_width;
+    }
+
+    const int* getRow(int y) const
+    {
+        return m_pixelData + (long long) y * m_width;
+    }
 
     virtual ~IntPlane();
 };
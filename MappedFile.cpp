@@ -0,0 +1,166 @@
+/**
+ * The MappedFile class maps a whole file read-only into memory, so that its bytes can be read in place without being
+ * copied into a buffer first. The mapping lasts as long as the object.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/26/17
+ * @version 1.1 - 04/01/17 - Optional copy-on-write mappings
+ */
+
+#include <stdexcept>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+ * Maps the file with the given name
+ *
+ * @param fileName The name of the file to map
+ * @throws invalid_argument If the file cannot be opened or mapped
+ */
+MappedFile::MappedFile(const char* fileName)
+ : MappedFile(fileName, false) {
+}
+
+/**
+ * Maps the file with the given name, optionally copy-on-write. A copy-on-write mapping may be written to: the pages
+ * written are copied for this process only, and the file itself is never changed.
+ *
+ * @param fileName The name of the file to map
+ * @param writable True to map the file copy-on-write
+ * @throws invalid_argument If the file cannot be opened or mapped
+ */
+MappedFile::MappedFile(const char* fileName, bool writable)
+{
+    m_data = nullptr;
+    m_size = 0;
+    m_writable = writable;
+
+#ifdef _WIN32
+    m_mapping = NULL;
+    m_file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    LARGE_INTEGER size;
+
+    if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size))
+    {
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+
+        throw invalid_argument("Could not open file for reading");
+    }
+
+    m_size = (size_t) size.QuadPart;
+
+    if (m_size > 0)
+    {
+        m_mapping = CreateFileMappingA(m_file, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        m_data = m_mapping != NULL ? (unsigned char*) MapViewOfFile(m_mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        if (m_data == nullptr)
+        {
+            if (m_mapping != NULL)
+            {
+                CloseHandle(m_mapping);
+            }
+
+            CloseHandle(m_file);
+            throw invalid_argument("Could not map file into memory");
+        }
+    }
+#else
+    int file = open(fileName, O_RDONLY);
+    struct stat info;
+
+    if (file < 0 || fstat(file, &info) != 0)
+    {
+        if (file >= 0)
+        {
+            close(file);
+        }
+
+        throw invalid_argument("Could not open file for reading");
+    }
+
+    m_size = (size_t) info.st_size;
+
+    if (m_size > 0)
+    {
+        void* data = mmap(nullptr, m_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, file, 0);
+
+        if (data == MAP_FAILED)
+        {
+            close(file);
+            throw invalid_argument("Could not map file into memory");
+        }
+
+        m_data = (unsigned char*) data;
+    }
+
+    // The mapping keeps its own reference to the file
+    close(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+    }
+
+    CloseHandle(m_file);
+#else
+    if (m_data != nullptr)
+    {
+        munmap(m_data, m_size);
+    }
+#endif
+}
+
+/**
+ * Gets the mapped bytes of the file
+ * @return Pointer to the first byte of the file, nullptr if the file is empty
+ */
+const unsigned char* MappedFile::getData() const
+{
+    return m_data;
+}
+
+/**
+ * Gets the mapped bytes of a copy-on-write mapping, which may be written to without changing the file
+ *
+ * @return Pointer to the first byte of the file, nullptr if the file is empty
+ * @throws invalid_argument If the file was not mapped copy-on-write
+ */
+unsigned char* MappedFile::getWritableData()
+{
+    if (!m_writable)
+    {
+        throw invalid_argument("File is mapped read only");
+    }
+
+    return m_data;
+}
+
+/**
+ * Gets the size of the file
+ * @return The size in bytes
+ */
+size_t MappedFile::getSize() const
+{
+    return m_size;
+}
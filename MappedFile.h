@@ -0,0 +1,38 @@
+/**
+ * The MappedFile class maps a whole file read-only into memory, so that its bytes can be read in place without being
+ * copied into a buffer first. The mapping lasts as long as the object.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/26/17
+ * @version 1.1 - 04/01/17 - Optional copy-on-write mappings
+ */
+
+#ifndef WANGTILE_MAPPEDFILE_H
+#define WANGTILE_MAPPEDFILE_H
+
+#include <cstddef>
+
+class MappedFile
+{
+private:
+    unsigned char* m_data;
+    size_t m_size;
+    bool m_writable;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+public:
+    MappedFile(const char*);
+    MappedFile(const char*, bool);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const unsigned char* getData() const;
+    unsigned char* getWritableData();
+    size_t getSize() const;
+
+    virtual ~MappedFile();
+};
+
+#endif //WANGTILE_MAPPEDFILE_H
@@ -0,0 +1,266 @@
+/**
+ * The OverlapSearch class evaluates the overlap error of a patch placed at EVERY position of a source plane in one go.
+ * The sum of squared differences over the left/top overlap region is expanded into
+ *
+ *   SSD(x, y) = sum(S^2) - 2 * sum(S * T) + sum(T^2)
+ *
+ * where the source energy term is read from a summed-area table of squared intensities, and the cross term is the
+ * cross-correlation of the source with the overlap template, computed with an FFT.
+ *
+ * All coordinates are in the storage space of the source plane, matching how Patches read their own pixels.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/12/17
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include "OverlapSearch.h"
+#include "FFT.h"
+#include "Quilt.h"
+
+/**
+ * Prepares the search over the given source plane. This precomputes the spectrum of each color channel of the source
+ * and the summed-area table of its squared intensities, so that each later query only has to transform its overlap
+ * template.
+ *
+ * @param source The plane that candidate patches are taken from
+ * @param patchSize The side length of the candidate patches
+ * @throws invalid_argument If the patch size is larger than the source plane
+ */
+OverlapSearch::OverlapSearch(RGBPlane& source, int patchSize)
+{
+    m_sourceWidth = source.getWidth();
+    m_sourceHeight = source.getHeight();
+    m_patchSize = patchSize;
+    m_overlap = patchSize / Quilt::OVERLAP_DIVISOR;
+
+    if (patchSize > m_sourceWidth || patchSize > m_sourceHeight)
+    {
+        throw invalid_argument("Patch size must not exceed the dimensions of the source plane");
+    }
+
+    // The correlation is circular, but every candidate reads at most (width - 1) past its origin, so padding to the
+    // source size is enough to keep the wrap-around out of the candidate region
+    m_fftWidth = fft::nextPowerOfTwo(m_sourceWidth);
+    m_fftHeight = fft::nextPowerOfTwo(m_sourceHeight);
+
+    const unsigned char* pixels = source.getRawData();
+
+    // The channels are packed two to a transform as (r + ig) and (b + 0i). Correlating a packed template against a
+    // packed source gives T.r * S.r + T.g * S.g in the real part of the result, which is exactly the per channel sum
+    // that is needed
+    m_sourceSpectra.resize(2);
+
+    for (int s = 0; s < 2; s++)
+    {
+        vector<complex<double>>& spectrum = m_sourceSpectra[s];
+        spectrum.assign(m_fftWidth * m_fftHeight, complex<double>(0, 0));
+
+        for (int y = 0; y < m_sourceHeight; y++)
+        {
+            for (int x = 0; x < m_sourceWidth; x++)
+            {
+                const unsigned char* pixel = pixels + (y * m_sourceWidth + x) * 3;
+
+                spectrum[y * m_fftWidth + x] = s == 0 ? complex<double>(pixel[0], pixel[1]) : complex<double>(pixel[2], 0);
+            }
+        }
+
+        fft::transform2D(spectrum, m_fftWidth, m_fftHeight, false, m_sourceHeight);
+    }
+
+    int sumWidth = m_sourceWidth + 1;
+
+    m_squaredSums.assign(sumWidth * (m_sourceHeight + 1), 0);
+
+    for (int y = 0; y < m_sourceHeight; y++)
+    {
+        long long rowSum = 0;
+
+        for (int x = 0; x < m_sourceWidth; x++)
+        {
+            const unsigned char* pixel = pixels + (y * m_sourceWidth + x) * 3;
+
+            rowSum += pixel[0] * pixel[0] + pixel[1] * pixel[1] + pixel[2] * pixel[2];
+            m_squaredSums[(y + 1) * sumWidth + x + 1] = m_squaredSums[y * sumWidth + x + 1] + rowSum;
+        }
+    }
+}
+
+/**
+ * Gets the sum of the squared intensities (over all channels) of the source within the given rectangle
+ *
+ * @param x1 The left edge of the rectangle (inclusive)
+ * @param y1 The top edge of the rectangle (inclusive)
+ * @param x2 The right edge of the rectangle (exclusive)
+ * @param y2 The bottom edge of the rectangle (exclusive)
+ * @return The summed squared intensities
+ */
+long long OverlapSearch::getSquaredSum(int x1, int y1, int x2, int y2) const
+{
+    int sumWidth = m_sourceWidth + 1;
+
+    return m_squaredSums[y2 * sumWidth + x2] - m_squaredSums[y1 * sumWidth + x2]
+           - m_squaredSums[y2 * sumWidth + x1] + m_squaredSums[y1 * sumWidth + x1];
+}
+
+/**
+ * Estimates the cost of one OverlapSearch::computeErrors query over the given source, in the same unit as scoring a
+ * single overlap pixel of a single candidate directly. Used to decide whether building the search is worth it.
+ *
+ * @param source The plane that candidate patches would be taken from
+ * @return The approximate cost of one query
+ */
+long long OverlapSearch::getQueryCost(const RGBPlane& source)
+{
+    long long size = (long long) fft::nextPowerOfTwo(source.getWidth()) * fft::nextPowerOfTwo(source.getHeight());
+    int log2Size = 0;
+
+    while ((1LL << log2Size) < size)
+    {
+        log2Size++;
+    }
+
+    // Three transforms per query (two forward, one inverse), measured at about five times the cost of a directly
+    // scored pixel per element per stage
+    return 3 * 5 * size * log2Size;
+}
+
+/**
+ * Gets the number of candidate positions along the x-axis of the source
+ *
+ * @return The number of valid patch origins per row
+ */
+int OverlapSearch::getCandidateWidth() const
+{
+    return m_sourceWidth - m_patchSize + 1;
+}
+
+/**
+ * Gets the number of candidate positions along the y-axis of the source
+ *
+ * @return The number of valid patch origins per column
+ */
+int OverlapSearch::getCandidateHeight() const
+{
+    return m_sourceHeight - m_patchSize + 1;
+}
+
+/**
+ * Computes the overlap error of a patch taken from every position of the source, against the given neighbours. The
+ * overlap region and its precedence (top overlap first, then left) is the same one used by Patch::getOverlapScore.
+ *
+ * This is safe to call from several threads at once, the scratch buffers are per thread.
+ *
+ * @param left The patch to the left of the one being placed, nullptr if there is none
+ * @param top The patch above the one being placed, nullptr if there is none
+ * @param errors Filled with the sum of squared differences of each candidate, indexed by (y * candidateWidth + x)
+ *               where (x, y) is the top left corner of the candidate in the source
+ */
+void OverlapSearch::computeErrors(Patch* left, Patch* top, vector<long long>& errors) const
+{
+    int candidateWidth = getCandidateWidth();
+    int candidateHeight = getCandidateHeight();
+    int size = m_fftWidth * m_fftHeight;
+
+    errors.assign(candidateWidth * candidateHeight, 0);
+
+    if (left == nullptr && top == nullptr)
+    {
+        return;
+    }
+
+    thread_local vector<complex<double>> templates[2];
+    long long templateEnergy = 0;
+
+    for (int s = 0; s < 2; s++)
+    {
+        templates[s].assign(size, complex<double>(0, 0));
+    }
+
+    for (int i = 0; i < m_patchSize; i++)
+    {
+        for (int j = 0; j < m_patchSize; j++)
+        {
+            const RGBPlane* plane;
+            int x;
+            int y;
+
+            if (i < m_overlap && top != nullptr)
+            {
+                plane = top->getRGBPlane();
+                x = j;
+                y = m_patchSize - m_overlap + i;
+            }
+            else if (j < m_overlap && left != nullptr)
+            {
+                plane = left->getRGBPlane();
+                x = m_patchSize - m_overlap + j;
+                y = i;
+            }
+            else
+            {
+                continue;
+            }
+
+            // The neighbours may be in either layout
+            int red = plane->getSample(x, y, 0);
+            int green = plane->getSample(x, y, 1);
+            int blue = plane->getSample(x, y, 2);
+
+            templates[0][i * m_fftWidth + j] = complex<double>(red, green);
+            templates[1][i * m_fftWidth + j] = complex<double>(blue, 0);
+            templateEnergy += red * red + green * green + blue * blue;
+        }
+    }
+
+    fft::transform2D(templates[0], m_fftWidth, m_fftHeight, false, m_patchSize);
+    fft::transform2D(templates[1], m_fftWidth, m_fftHeight, false, m_patchSize);
+
+    // Both packed correlations are summed in the frequency domain, so only one inverse transform is needed. The
+    // result is accumulated back into the first template buffer
+    vector<complex<double>>& correlation = templates[0];
+    const complex<double>* spectrum0 = m_sourceSpectra[0].data();
+    const complex<double>* spectrum1 = m_sourceSpectra[1].data();
+
+    for (int k = 0; k < size; k++)
+    {
+        complex<double> t0 = templates[0][k];
+        complex<double> t1 = templates[1][k];
+
+        // conj(t0) * s0 + conj(t1) * s1
+        double real = t0.real() * spectrum0[k].real() + t0.imag() * spectrum0[k].imag()
+                      + t1.real() * spectrum1[k].real() + t1.imag() * spectrum1[k].imag();
+        double imag = t0.real() * spectrum0[k].imag() - t0.imag() * spectrum0[k].real()
+                      + t1.real() * spectrum1[k].imag() - t1.imag() * spectrum1[k].real();
+
+        correlation[k] = complex<double>(real, imag);
+    }
+
+    fft::transform2D(correlation, m_fftWidth, m_fftHeight, true, candidateHeight);
+
+    int leftStart = top != nullptr ? m_overlap : 0;
+
+    for (int y = 0; y < candidateHeight; y++)
+    {
+        for (int x = 0; x < candidateWidth; x++)
+        {
+            long long sourceEnergy = 0;
+
+            if (top != nullptr)
+            {
+                sourceEnergy += getSquaredSum(x, y, x + m_patchSize, y + m_overlap);
+            }
+
+            if (left != nullptr)
+            {
+                sourceEnergy += getSquaredSum(x, y + leftStart, x + m_overlap, y + m_patchSize);
+            }
+
+            long long cross = llround(correlation[y * m_fftWidth + x].real());
+
+            errors[y * candidateWidth + x] = max(0LL, sourceEnergy - 2 * cross + templateEnergy);
+        }
+    }
+}
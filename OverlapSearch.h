@@ -0,0 +1,48 @@
+/**
+ * The OverlapSearch class evaluates the overlap error of a patch placed at EVERY position of a source plane in one go.
+ * The sum of squared differences over the left/top overlap region is expanded into
+ *
+ *   SSD(x, y) = sum(S^2) - 2 * sum(S * T) + sum(T^2)
+ *
+ * where the source energy term is read from a summed-area table of squared intensities, and the cross term is the
+ * cross-correlation of the source with the overlap template, computed with an FFT.
+ *
+ * All coordinates are in the storage space of the source plane, matching how Patches read their own pixels.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/12/17
+ */
+
+#ifndef WANGTILE_OVERLAPSEARCH_H
+#define WANGTILE_OVERLAPSEARCH_H
+
+#include <complex>
+#include <vector>
+#include "RGBPlane.h"
+#include "Patch.h"
+
+using namespace std;
+
+class OverlapSearch
+{
+private:
+    int m_sourceWidth;
+    int m_sourceHeight;
+    int m_patchSize;
+    int m_overlap;
+    int m_fftWidth;
+    int m_fftHeight;
+    vector<vector<complex<double>>> m_sourceSpectra;
+    vector<long long> m_squaredSums;
+
+    long long getSquaredSum(int, int, int, int) const;
+
+public:
+    OverlapSearch(RGBPlane&, int);
+    static long long getQueryCost(const RGBPlane&);
+    int getCandidateWidth() const;
+    int getCandidateHeight() const;
+    void computeErrors(Patch*, Patch*, vector<long long>&) const;
+};
+
+#endif //WANGTILE_OVERLAPSEARCH_H
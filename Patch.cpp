@@ -9,6 +9,7 @@
 #include <limits.h>
 #include "Patch.h"
 #include "Quilt.h"
+#include "Trace.h"
 
 /**
  * The default constructor for the Patch. Uses the given unsigned char array as its pixel data map.
@@ -19,7 +20,7 @@
  */
 Patch::Patch(const RGBPlane& plane, int dimension, char code)
 {
-    m_pixelData = new RGBPlane(plane);
+    m_pixelData = new RGBPlane(plane.clone());
     m_dimension = dimension;
     m_error = new IntPlane(dimension, dimension);
 	m_boundaries = new IntPlane(dimension, dimension);
@@ -29,18 +30,84 @@ Patch::Patch(const RGBPlane& plane, int dimension, char code)
 	m_code = code;
 }
 
+/**
+ * Constructs the Patch by copying the pixels out of the block of a source plane that the given view looks onto. This
+ * is how a candidate is materialized once it has been selected.
+ *
+ * @param view The view onto the source block this patch is made from
+ * @param code The code this patch represents
+ */
+Patch::Patch(const PatchView& view, char code) : Patch(view, code, nullptr)
+{
+}
+
+/**
+ * Constructs the Patch from the block of a source plane that the given view looks onto, with its planes carved from
+ * an arena. This is how a Quilt materializes the patches it places, which all die together with the quilt.
+ *
+ * @param view The view onto the source block this patch is made from
+ * @param code The code this patch represents
+ * @param arena The arena to allocate the planes from, or nullptr to allocate them on their own
+ */
+Patch::Patch(const PatchView& view, char code, Arena* arena)
+{
+    m_dimension = view.getSize();
+
+    RGBPlane::Layout layout = view.getSource()->getLayout();
+
+    if (arena != nullptr)
+    {
+        m_pixelData = new RGBPlane(m_dimension, m_dimension, *arena, layout);
+        m_error = new IntPlane(m_dimension, m_dimension, *arena);
+        m_boundaries = new IntPlane(m_dimension, m_dimension, *arena);
+    }
+    else
+    {
+        m_pixelData = new RGBPlane(m_dimension, m_dimension, layout);
+        m_error = new IntPlane(m_dimension, m_dimension);
+        m_boundaries = new IntPlane(m_dimension, m_dimension);
+    }
+
+    m_pixelData->copyRegionFrom(*view.getSource(), view.getX(), view.getY(), m_dimension, m_dimension, 0, 0);
+    m_totalError = 0;
+	m_cornerCutX = 0;
+	m_cornerCutY = 0;
+	m_code = code;
+}
+
 Patch::Patch(const Patch &patch)
 {
-    m_pixelData = new RGBPlane(*patch.getRGBPlane());
+    m_pixelData = new RGBPlane(patch.m_pixelData->clone());
     m_dimension = patch.m_dimension;
-    m_error = new IntPlane(*patch.getErrorPlane());
-	m_boundaries = new IntPlane(*patch.getBoundaries());
+    m_error = new IntPlane(patch.m_error->clone());
+	m_boundaries = new IntPlane(patch.m_boundaries->clone());
     m_totalError = 0;
 	m_cornerCutX = patch.m_cornerCutX;
 	m_cornerCutY = patch.m_cornerCutY;
 	m_code = patch.m_code;
 }
 
+/**
+ * Copies a patch, with the planes of the copy carved from an arena. The copy keeps the layout of the patch
+ *
+ * @param patch The patch to copy
+ * @param arena The arena to allocate the planes of the copy from
+ */
+Patch::Patch(const Patch& patch, Arena& arena)
+{
+    m_dimension = patch.m_dimension;
+    m_pixelData = new RGBPlane(m_dimension, m_dimension, arena, patch.m_pixelData->getLayout());
+    m_error = new IntPlane(m_dimension, m_dimension, arena);
+    m_boundaries = new IntPlane(m_dimension, m_dimension, arena);
+    m_pixelData->copyRegionFrom(*patch.m_pixelData, 0, 0, m_dimension, m_dimension, 0, 0);
+    copy(patch.m_error->getRow(0), patch.m_error->getRow(m_dimension), m_error->getRow(0));
+    copy(patch.m_boundaries->getRow(0), patch.m_boundaries->getRow(m_dimension), m_boundaries->getRow(0));
+    m_totalError = 0;
+    m_cornerCutX = patch.m_cornerCutX;
+    m_cornerCutY = patch.m_cornerCutY;
+    m_code = patch.m_code;
+}
+
 Patch::~Patch()
 {
     delete m_pixelData;
@@ -78,41 +145,38 @@ IntPlane* Patch::getBoundaries() const
 }
 
 /**
- * Populates the error 2-dimensional array by calculating the overlap score given the 2 patches. Score is determined
- * by the L2 norm of the difference in pixel values for each channel (r, g, b) of the overlapping patches.
- *
- * e.g. sqrt((thisPatch.r - otherPatch.r)^2 + (thisPatch.g - otherPatch.g)^2 + (thisPatch.b - otherPatch.b)^2)
+ * Populates the error 2-dimensional array by calculating the overlap score given the 2 patches. The error of each
+ * pixel of overlap is the squared difference of the overlapping patches, summed over each channel (r, g, b).
  *
- * For every pixel of overlap
+ * e.g. (thisPatch.r - otherPatch.r)^2 + (thisPatch.g - otherPatch.g)^2 + (thisPatch.b - otherPatch.b)^2
  *
  * @param left The patch to the left of this one, nullptr if this is the leftmost patch in the row
  * @param top The patch above this patch, nullptr if this is the topmost row
- * @return The total error of the overlap region
+ * @return The total error of the overlap region, the same as PatchView::getOverlapScore gives for the same pixels
+ *         whatever the layout of the patches
  */
-int Patch::getOverlapScore(Patch* left, Patch* top)
+long long Patch::getOverlapScore(Patch* left, Patch* top)
 {
     int overlap = m_dimension / Quilt::OVERLAP_DIVISOR;
 
     m_error->fill(0);
+    m_totalError = 0;
 
     for (int i = 0 ; i < m_dimension ; i++)
     {
-        for (int j = 0 ; j < m_dimension ; j++)
+        int* errorRow = m_error->getRow(i);
+
+        // If top overlap region and has a patch above it
+        if (i < overlap && top != nullptr)
         {
-            // If top overlap region and has a patch above it
-            if (i < overlap && top != nullptr)
-            {
-                int error = util::l2NormDiff(getPixelAt(j, i), top->getPixelAt(j, m_dimension - overlap + i), 3);
-                m_error->setPixelValueAt(j, i, error);
-                m_totalError += error;
-            }
-            // if left overlap region and has patch to the left of it
-            else if (j < overlap && left != nullptr)
-            {
-                int error = util::l2NormDiff(getPixelAt(j, i), left->getPixelAt(m_dimension - overlap + j, i), 3);
-                m_error->setPixelValueAt(j, i, error);
-                m_totalError += error;
-            }
+            m_totalError += m_pixelData->getPixelErrors(0, i, *top->getRGBPlane(), 0, m_dimension - overlap + i,
+                                                        m_dimension, errorRow);
+        }
+        // if left overlap region and has patch to the left of it
+        else if (left != nullptr)
+        {
+            m_totalError += m_pixelData->getPixelErrors(0, i, *left->getRGBPlane(), m_dimension - overlap, i, overlap,
+                                                        errorRow);
         }
     }
     return m_totalError;
@@ -122,23 +186,17 @@ int Patch::getOverlapScore(Patch* left, Patch* top)
  * Gets the pixel data from the given x, y coords.
  * @param x The x coord of the pixel
  * @param y The y coord of the pixel
- * @return Array containing the r, g, b values of the desired pixel
+ * @return Pointer to the r, g, b values of the desired pixel (NOT A COPY)
+ * @throws invalid_argument If the coordinates are outside the patch, or the patch is planar
  */
-int* Patch::getPixelAt(int x, int y)
+const unsigned char* Patch::getPixelAt(int x, int y)
 {
     if (x >= m_dimension || y >= m_dimension)
     {
         throw invalid_argument("Received x or y value that exceeds width or height of patch");
     }
 
-    int* data = new int[3];
-    vector<unsigned char> values = m_pixelData->getPixelValueAt(x, y, false);
-
-    data[0] = static_cast<int>(values[0]);
-    data[1] = static_cast<int>(values[1]);
-    data[2] = static_cast<int>(values[2]);
-
-    return data;
+    return m_pixelData->getPixelAt(x, y, false);
 }
 
 /**
@@ -146,7 +204,7 @@ int* Patch::getPixelAt(int x, int y)
  * @return The total summed error of the overlap region
  * @see Patch::getOverlapScore(Patch*, Patch*)
  */
-int Patch::getTotalError()
+long long Patch::getTotalError()
 {
     return m_totalError;
 }
@@ -169,6 +227,9 @@ int Patch::getDimension()
  */
 void Patch::calculateLeastCostBoundaries(Patch* left, Patch* top)
 {
+    trace::Scope scope("cut seam");
+    trace::count("seams cut", 1);
+
 	m_boundaries->fill(0);
 
 	cutTopBoundary(top);
@@ -178,34 +239,30 @@ void Patch::calculateLeastCostBoundaries(Patch* left, Patch* top)
 
 	for (int i = 0; i < m_dimension; i++)
 	{
+        int* row = m_boundaries->getRow(i);
+
 		for (int j = 0; j < m_dimension; j++)
 		{
-            int val = m_boundaries->getPixelValueAt(j, i);
-
 			if (i < corner[1] && j < corner[0])
 			{
-				m_boundaries->setPixelValueAt(j, i, 3);
+				row[j] = 3;
 			}
-			else if (val == 0)
+			else if (row[j] == 0 || row[j] == 2)
 			{
-				m_boundaries->setPixelValueAt(j, i, 1);
+				row[j] = 1;
 			}
-            else if (val == 2)
-            {
-                m_boundaries->setPixelValueAt(j, i, 1);
-            }
 		}
 	}
 
     for (int i = 0; i < m_dimension; i++)
     {
+        int* row = m_boundaries->getRow(i);
+
         for (int j = 0; j < m_dimension; j++)
         {
-            int val = m_boundaries->getPixelValueAt(j, i);
-
-            if (val > 1)
+            if (row[j] > 1)
             {
-                m_boundaries->setPixelValueAt(j, i, 0);
+                row[j] = 0;
             }
         }
     }
@@ -221,35 +278,25 @@ void Patch::cutTopBoundary(Patch* top)
 {
     if (top == nullptr) // No patch above, therefore there is no overlap
     {
+        int* row = m_boundaries->getRow(0);
+
         for (int x = 0; x < m_dimension; x++)
         {
-            getBoundaries()->setPixelValueAt(x, 0, m_boundaries->getPixelValueAt(x, 0) + 1);
+            row[x]++;
         }
         return;
     }
 
-    vector<int*> paths = getHorizontalCut();
-    int* bestPath = paths[0];
-
-    for (int i = 1; i < paths.size(); i++)
-    {
-        if (paths[i][m_dimension] <= bestPath[m_dimension])
-        {
-            bestPath = paths[i];
-        }
-    }
+    vector<int> cut = getHorizontalCut();
 
     for (int i = 0; i < m_dimension; i++)
     {
-        int row = bestPath[i];
-        m_boundaries->setPixelValueAt(i, row, m_boundaries->getPixelValueAt(i, row) + 1);
+        int row = cut[i];
+        m_boundaries->getRow(row)[i]++;
 
-        if (row != 0)
+        for (int j = row - 1; j >= 0; j--)
         {
-            for (int j = row - 1; j >= 0; j--)
-            {
-                m_boundaries->setPixelValueAt(i, j, 3);
-            }
+            m_boundaries->getRow(j)[i] = 3;
         }
     }
 }
@@ -266,33 +313,23 @@ void Patch::cutLeftBoundary(Patch* left)
     {
         for (int y = 0; y < m_dimension; y++)
         {
-            getBoundaries()->setPixelValueAt(0, y, m_boundaries->getPixelValueAt(0, y) + 1);
+            m_boundaries->getRow(y)[0]++;
         }
         return;
     }
 
-    vector<int*> paths = getVerticalCut();
-    int* bestPath = paths[0];
-
-    for (int i = 1; i < paths.size(); i++)
-    {
-        if (paths[i][m_dimension] <= bestPath[m_dimension])
-        {
-            bestPath = paths[i];
-        }
-    }
+    vector<int> cut = getVerticalCut();
 
     for (int i = 0; i < m_dimension; i++)
     {
-        int col = bestPath[i];
-        m_boundaries->setPixelValueAt(col, i, m_boundaries->getPixelValueAt(col, i) + 1);
+        int col = cut[i];
+        int* row = m_boundaries->getRow(i);
 
-        if (col != 0)
+        row[col]++;
+
+        for (int j = col - 1; j >= 0; j--)
         {
-            for (int j = col - 1; j >= 0; j--)
-            {
-                m_boundaries->setPixelValueAt(j, i, 3);
-            }
+            row[j] = 3;
         }
     }
 }
@@ -307,9 +344,11 @@ vector<int> Patch::findCorner()
 	vector<int> point(2);
 	for (int i = 0; i < m_dimension; i++)
 	{
+        const int* row = m_boundaries->getRow(i);
+
 		for (int j = 0; j < m_dimension; j++)
 		{
-			if (m_boundaries->getPixelValueAt(j, i) == 2)
+			if (row[j] == 2)
 			{
 				point[0] = j;
 				point[1] = i;
@@ -330,117 +369,109 @@ char Patch::getCode()
 }
 
 /**
- * Function to determine the least cost cut along the vertical overlap surface.
+ * Function to determine the least cost cut along the vertical (left) overlap surface.
  *
- * @return Array structured such that the last index holds the running cumulative cost of the path, and the rest holds
- *               the indices of each point we have used for this path
+ * @return The column of the cut within the overlap for every row of the patch
  */
-vector<int*> Patch::getVerticalCut()
+vector<int> Patch::getVerticalCut()
 {
-    vector<vector<int*>> paths;
-    int overlap = m_dimension / Quilt::OVERLAP_DIVISOR;
+    vector<int> cut(m_dimension, 0);
 
-    paths.resize(m_dimension);
+    findMinimumCut(true, cut);
 
-    for (int i = m_dimension - 1; i >= 0; i--)
-    {
-        vector<int*> row;
-        for (int j = 0; j < overlap; j++) {
-            if (i == m_dimension - 1)
-            {
-                int* pathData = new int[m_dimension + 1];
-
-                pathData[m_dimension] = m_error->getPixelValueAt(j, i);
-                pathData[i] = j;
-
-                row.push_back(pathData);
-            }
-            else
-            {
-                int start = max(0, j - 1);
-                int end = min(overlap - 1, j + 1);
-                int* best = paths[i + 1][start];
-
-                for (int x = start + 1; x <= end; x++)
-                {
-                    int* path = paths[i + 1][x];
-
-                    if (path[m_dimension] <= best[m_dimension])
-                    {
-                        best = path;
-                    }
-                }
-
-                int* newPath = new int[m_dimension + 1];
-
-                copy(best, best + m_dimension + 1, newPath);
+    return cut;
+}
 
-                newPath[i] = j;
-                newPath[m_dimension] = newPath[m_dimension] + m_error->getPixelValueAt(j, i);
+/**
+ * Function to determine the least cost cut along the horizontal (top) overlap surface.
+ *
+ * @return The row of the cut within the overlap for every column of the patch
+ */
+vector<int> Patch::getHorizontalCut()
+{
+    vector<int> cut(m_dimension, 0);
 
-                row.push_back(newPath);
-            }
-        }
-        paths[i] = row;
-    }
+    findMinimumCut(false, cut);
 
-    return paths[0];
+    return cut;
 }
 
 /**
- * Function to determine the least cost cut along the horizontal overlap surface.
+ * Finds the minimum error boundary cut through an overlap strip of the error plane with dynamic programming. The cut
+ * runs along the whole length of the patch, moving at most one pixel across the strip per step, and minimizes the
+ * cumulative error of the pixels it passes through.
+ *
+ * The cumulative cost table and the backtrack table (each length * overlap) live in a scratch buffer that is reused
+ * by every cut made on the same thread. Ties go to the higher offset.
  *
- * @return Array structured such that the last index holds the running cumulative cost of the path, and the rest holds
- *               the indices of each point we have used for this path
+ * @param vertical True for the left overlap strip (the cut goes top to bottom), false for the top overlap strip (the
+ *                 cut goes left to right)
+ * @param cut Filled with the offset of the cut across the strip for every step along the patch
  */
-vector<int*> Patch::getHorizontalCut()
+void Patch::findMinimumCut(bool vertical, vector<int>& cut)
 {
-    vector<vector<int*>> paths;
     int overlap = m_dimension / Quilt::OVERLAP_DIVISOR;
+    int length = m_dimension;
+
+    if (overlap == 0)
+    {
+        fill(cut.begin(), cut.end(), 0);
+        return;
+    }
+
+    thread_local vector<long long> costs;
+    thread_local vector<signed char> steps;
 
-    paths.resize(m_dimension);
+    costs.resize(length * overlap);
+    steps.resize(length * overlap);
 
-    for (int i = m_dimension - 1; i >= 0; i--) // i here is the column
+    // Built from the far end of the patch back towards the start, so the start row ends up holding the full cost of
+    // the best cut leaving each of its pixels
+    for (int i = length - 1; i >= 0; i--)
     {
-        vector<int*> row;
-        for (int j = 0; j < overlap; j++) {
-            if (i == m_dimension - 1)
-            {
-                int* pathData = new int[m_dimension + 1];
+        long long* cost = &costs[i * overlap];
+        signed char* step = &steps[i * overlap];
 
-                pathData[m_dimension] = m_error->getPixelValueAt(i, j);
-                pathData[i] = j;
+        for (int j = 0; j < overlap; j++)
+        {
+            long long error = vertical ? m_error->getRow(i)[j] : m_error->getRow(j)[i];
 
-                row.push_back(pathData);
-            }
-            else
+            if (i == length - 1)
             {
-                int start = max(0, j - 1);
-                int end = min(overlap - 1, j + 1);
-                int* best = paths[i + 1][start];
+                cost[j] = error;
+                step[j] = 0;
+                continue;
+            }
 
-                for (int x = start + 1; x <= end; x++)
-                {
-                    int* path = paths[i + 1][x];
+            const long long* next = cost + overlap;
+            int best = max(0, j - 1);
 
-                    if (path[m_dimension] <= best[m_dimension])
-                    {
-                        best = path;
-                    }
+            for (int k = best + 1; k <= min(overlap - 1, j + 1); k++)
+            {
+                if (next[k] <= next[best])
+                {
+                    best = k;
                 }
+            }
 
-                int* newPath = new int[m_dimension + 1];
-
-                copy(best, best + m_dimension + 1, newPath);
+            cost[j] = error + next[best];
+            step[j] = (signed char) (best - j);
+        }
+    }
 
-                newPath[i] = j;
-                newPath[m_dimension] = newPath[m_dimension] + m_error->getPixelValueAt(i, j);
+    int offset = 0;
 
-                row.push_back(newPath);
-            }
+    for (int j = 1; j < overlap; j++)
+    {
+        if (costs[j] <= costs[offset])
+        {
+            offset = j;
         }
-        paths[i] = row;
     }
 
-    return paths[0];
+    for (int i = 0; i < length; i++)
+    {
+        cut[i] = offset;
+        offset += steps[i * overlap + offset];
+    }
 }
@@ -12,6 +12,7 @@
 #include "util.h"
 #include "IntPlane.h"
 #include "RGBPlane.h"
+#include "PatchView.h"
 
 class Patch
 {
@@ -20,24 +21,27 @@ private:
     IntPlane* m_error;
 	IntPlane* m_boundaries;
     int m_dimension;
-    int m_totalError;
+    long long m_totalError;
 	int m_cornerCutX;
 	int m_cornerCutY;
 	char m_code;
 
 public:
     Patch(const RGBPlane&, int, char);
+    Patch(const PatchView&, char);
+    Patch(const PatchView&, char, Arena*);
     Patch(const Patch&);
+    Patch(const Patch&, Arena&);
     RGBPlane* getRGBPlane() const;
     IntPlane* getErrorPlane() const;
 	IntPlane* getBoundaries() const;
-    int getOverlapScore(Patch*, Patch*);
+    long long getOverlapScore(Patch*, Patch*);
     int getDimension();
-    int* getPixelAt(int, int);
-    int getTotalError();
+    const unsigned char* getPixelAt(int, int);
+    long long getTotalError();
     void calculateLeastCostBoundaries(Patch*, Patch*);
-    vector<int*> getVerticalCut();
-    vector<int*> getHorizontalCut();
+    vector<int> getVerticalCut();
+    vector<int> getHorizontalCut();
 	char getCode();
 
 	virtual ~Patch();
@@ -46,11 +50,14 @@ public:
 	static const char CODE_B = 'b';
 	static const char CODE_G = 'g';
 	static const char CODE_Y = 'y';
+	static const char CODE_M = 'm';
+	static const char CODE_C = 'c';
 
 private:
 	void cutTopBoundary(Patch*);
 	void cutLeftBoundary(Patch*);
 	vector<int> findCorner();
+	void findMinimumCut(bool, vector<int>&);
 };
 
 #endif //WANGTILE_PATCH_H
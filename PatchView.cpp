@@ -0,0 +1,112 @@
+/**
+ * The PatchView class is a lightweight, non-owning window onto a square block of a source plane. Candidate patches
+ * are scored through views, so that only the patch that is finally placed in a Quilt has its pixels copied out.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/14/17
+ */
+
+#include <stdexcept>
+#include "PatchView.h"
+#include "Patch.h"
+#include "Quilt.h"
+
+/**
+ * Constructs the view onto the block of the source plane with the given top left corner. The source must outlive the
+ * view.
+ *
+ * @param source The plane being viewed
+ * @param x The x value of the top left corner of the block, in the storage space of the source
+ * @param y The y value of the top left corner of the block, in the storage space of the source
+ * @param size The side length of the block
+ * @throws invalid_argument If the block does not fit within the source
+ */
+PatchView::PatchView(const RGBPlane& source, int x, int y, int size)
+{
+    if (x < 0 || y < 0 || x + size > source.getWidth() || y + size > source.getHeight())
+    {
+        throw invalid_argument("Patch view exceeds the width or height of its source plane");
+    }
+
+    m_source = &source;
+    m_x = x;
+    m_y = y;
+    m_size = size;
+    m_stride = (int) source.getStride();
+    m_origin = source.getLayout() == RGBPlane::PLANAR ? source.getChannelRow(0, y) + x : source.getPixel(x, y);
+}
+
+/**
+ * Gets the plane this view looks onto
+ * @return The source plane
+ */
+const RGBPlane* PatchView::getSource() const
+{
+    return m_source;
+}
+
+/**
+ * Gets the x value of the top left corner of this view within its source
+ * @return The x offset
+ */
+int PatchView::getX() const
+{
+    return m_x;
+}
+
+/**
+ * Gets the y value of the top left corner of this view within its source
+ * @return The y offset
+ */
+int PatchView::getY() const
+{
+    return m_y;
+}
+
+/**
+ * Gets the side length of this view
+ * @return The side length (pixels) of the view
+ */
+int PatchView::getSize() const
+{
+    return m_size;
+}
+
+/**
+ * Gets the distance in bytes between the starts of two consecutive rows of this view (of one channel, for a planar
+ * source)
+ * @return The row stride
+ */
+int PatchView::getStride() const
+{
+    return m_stride;
+}
+
+/**
+ * Scores the overlap of the viewed block against its neighbours without copying it. This is the sum of squared
+ * differences over the same overlap region used by Patch::getOverlapScore (top overlap first, then left), and matches
+ * the error map of OverlapSearch exactly. The source and the neighbours may be in either layout.
+ *
+ * @param left The patch to the left of this one, nullptr if this is the leftmost patch in the row
+ * @param top The patch above this patch, nullptr if this is the topmost row
+ * @return The summed squared error of the overlap region
+ */
+long long PatchView::getOverlapScore(Patch* left, Patch* top) const
+{
+    int overlap = m_size / Quilt::OVERLAP_DIVISOR;
+    long long total = 0;
+
+    for (int i = 0; i < m_size; i++)
+    {
+        if (i < overlap && top != nullptr)
+        {
+            total += m_source->getRowError(m_x, m_y + i, *top->getRGBPlane(), 0, m_size - overlap + i, m_size);
+        }
+        else if (left != nullptr)
+        {
+            total += m_source->getRowError(m_x, m_y + i, *left->getRGBPlane(), m_size - overlap, i, overlap);
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,48 @@
+/**
+ * The PatchView class is a lightweight, non-owning window onto a square block of a source plane. Candidate patches
+ * are scored through views, so that only the patch that is finally placed in a Quilt has its pixels copied out.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/14/17
+ */
+
+#ifndef WANGTILE_PATCHVIEW_H
+#define WANGTILE_PATCHVIEW_H
+
+#include "RGBPlane.h"
+
+class Patch;
+
+class PatchView
+{
+private:
+    const RGBPlane* m_source;
+    const unsigned char* m_origin;
+    int m_x;
+    int m_y;
+    int m_size;
+    int m_stride;
+
+public:
+    PatchView(const RGBPlane&, int, int, int);
+    const RGBPlane* getSource() const;
+    int getX() const;
+    int getY() const;
+    int getSize() const;
+    int getStride() const;
+    long long getOverlapScore(Patch*, Patch*) const;
+
+    /**
+     * Unchecked access to the start of a row of the view, in the storage space of the source. For a planar source this
+     * is the row of its R channel, the G and B rows following one channel further on each
+     *
+     * @param y The row of the view to get
+     * @return Pointer to the R value of the first pixel of the row within the source (NOT A COPY)
+     */
+    const unsigned char* getRow(int y) const
+    {
+        return m_origin + y * m_stride;
+    }
+};
+
+#endif //WANGTILE_PATCHVIEW_H
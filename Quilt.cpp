@@ -9,7 +9,9 @@
 
 #include <limits.h>
 #include <chrono>
+#include <cmath>
 #include "Quilt.h"
+#include "Trace.h"
 
 /**
  * Default constructor for the Quilt. Given the source bitmap image and the patch size, will select all the patches
@@ -22,21 +24,64 @@
  *                  result in a loss of key details from the source image.
  */
 Quilt::Quilt(BMPFile& source, int patchesPerSide, int patchSize)
+ : Quilt(source, patchesPerSide, patchSize, GRID_SAMPLING) {
+}
+
+/**
+ * Constructs the Quilt with the given sampling of candidate patches from the source, working on interleaved pixels.
+ *
+ * @param source The source bitmap image to extract patches from
+ * @param patchesPerSide The number of patches to make along each side of the sqaure quilt
+ * @param patchSize The side length of each patch that will be extracted from the source bitmap
+ * @param sampleStep The distance between two candidate origins, or GRID_SAMPLING
+ * @see Quilt::Quilt(BMPFile&, int, int, int, RGBPlane::Layout)
+ */
+Quilt::Quilt(BMPFile& source, int patchesPerSide, int patchSize, int sampleStep)
+ : Quilt(source, patchesPerSide, patchSize, sampleStep, RGBPlane::INTERLEAVED) {
+}
+
+/**
+ * Constructs the Quilt with the given sampling of candidate patches from the source.
+ *
+ * With GRID_SAMPLING, candidates are the non-overlapping blocks of the source, and the patch size must divide it.
+ * Otherwise a candidate is taken at every sampleStep pixels along both axes (1 uses every pixel offset), which gives
+ * far more variety. Large dense candidate sets are searched through a CandidateIndex per overlap configuration.
+ *
+ * @param source The source bitmap image to extract patches from
+ * @param patchesPerSide The number of patches to make along each side of the sqaure quilt
+ * @param patchSize The side length of each patch that will be extracted from the source bitmap
+ * @param sampleStep The distance between two candidate origins, or GRID_SAMPLING
+ * @param layout The layout the candidates are scored and the chosen patches cut in. With PLANAR, a planar copy of the
+ *               source is made up front; the output is interleaved either way
+ */
+Quilt::Quilt(BMPFile& source, int patchesPerSide, int patchSize, int sampleStep, RGBPlane::Layout layout)
  : m_source(source) {
-    if (source.getWidth() % patchSize != 0)
+    if (sampleStep == GRID_SAMPLING && source.getWidth() % patchSize != 0)
     {
         throw invalid_argument("Patch size must be whole divisor of input source image");
     }
 
+    if (sampleStep < 0 || patchSize > source.getWidth() || patchSize > source.getHeight())
+    {
+        throw invalid_argument("Sample step must not be negative, and patch size must fit within the input source image");
+    }
+
     int overlap = patchSize / Quilt::OVERLAP_DIVISOR;
 
     m_dimension = (patchesPerSide * patchSize) - ((patchesPerSide - 1) * overlap);
     m_patchesPerSide = patchesPerSide;
     m_patchSize = patchSize;
-    m_generator = std::default_random_engine(std::chrono::system_clock::now().time_since_epoch().count());
+    m_sampleStep = sampleStep;
     m_output = new RGBPlane(m_dimension, m_dimension);
+    m_planarSource = layout == RGBPlane::PLANAR ? new RGBPlane(source.getPlane()->toLayout(layout)) : nullptr;
+    m_pool = new ThreadPool(0);
+    m_ownsPool = true;
+    m_ownsPatches = true;
+
+    setSeed(std::chrono::system_clock::now().time_since_epoch().count());
 
     extractPatches();
+    prepareSearch();
 }
 
 /**
@@ -47,6 +92,20 @@ Quilt::Quilt(BMPFile& source, int patchesPerSide, int patchSize)
  * @param patches The patch list that this quilt is composed from
  */
 Quilt::Quilt(BMPFile& source, int patchesPerSide, vector<Patch*> patches)
+ : Quilt(source, patchesPerSide, patches, nullptr) {
+}
+
+/**
+ * Creates a quilt from a predetermined arrangement of patches, run on the given thread pool. This lets many small
+ * quilts (such as the tiles of a TileSetBuilder) be made in parallel without each starting threads of its own.
+ *
+ * @param source Where this quilt's patches were extracted from
+ * @param patchesPerSide The number of patches per side in order to determine the 2D grid layout
+ * @param patches The patch list that this quilt is composed from. The patches are written to, so they must not be
+ *                shared with another quilt being made at the same time
+ * @param pool The pool to run on, which must outlive this quilt, or nullptr for the quilt to make its own
+ */
+Quilt::Quilt(BMPFile& source, int patchesPerSide, vector<Patch*> patches, ThreadPool* pool)
  : m_source(source) {
 	Patch* p = patches[0];
 	int patchSize = p->getDimension();
@@ -55,41 +114,83 @@ Quilt::Quilt(BMPFile& source, int patchesPerSide, vector<Patch*> patches)
 	m_dimension = (patchesPerSide * patchSize) - ((patchesPerSide - 1) * overlap);
 	m_patchesPerSide = patchesPerSide;
 	m_patchSize = patchSize;
-	m_generator = std::default_random_engine(std::chrono::system_clock::now().time_since_epoch().count());
+	m_sampleStep = GRID_SAMPLING;
 	m_output = new RGBPlane(m_dimension, m_dimension);
-
+	m_planarSource = nullptr;
+	m_pool = pool != nullptr ? pool : new ThreadPool(0);
+	m_ownsPool = pool == nullptr;
+	m_ownsPatches = false;
+	m_search = nullptr;
+	m_indices[0] = m_indices[1] = m_indices[2] = nullptr;
+
+	setSeed(std::chrono::system_clock::now().time_since_epoch().count());
 	layoutPatches(patches);
 }
 
 Quilt::~Quilt()
 {
-//    vector<Patch*>::iterator it;
-//    for (it = m_patchSet.begin() ; it < m_patchSet.end(); it++)
-//    {
-//        delete *it;
-//    }
-
-//    vector<vector<Patch*>>::iterator it2;
-//
-//    for (it2 = m_patches.begin() ; it2 < m_patches.end() ; it2++)
-//    {
-//        vector<Patch*>::iterator it3;
-//
-//        for (it3 = (*it2).begin() ; it3 < (*it2).end() ; it3++)
-//        {
-//            delete *it3;
-//        }
-//    }
-
-//    delete m_output;
+    deletePatches();
+    delete m_search;
+    delete m_output;
+    delete m_planarSource;
+
+    if (m_ownsPool)
+    {
+        delete m_pool;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        delete m_indices[i];
+    }
 }
 
 /**
- * Extracts patches from the source image to create a patch set that can then be called upon to quilt the final output
- * image together
+ * Deletes the patches this quilt chose itself, and gives the memory of their planes back to its arena all at once.
+ * Patches it was given belong to the caller, and are left alone.
+ */
+void Quilt::deletePatches()
+{
+    if (!m_ownsPatches)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < m_patches.size(); i++)
+    {
+        for (size_t j = 0; j < m_patches[i].size(); j++)
+        {
+            delete m_patches[i][j];
+        }
+    }
+
+    m_patches.clear();
+    m_arena.reset();
+}
+
+/**
+ * Extracts the candidate patches from the source image that can then be called upon to quilt the final output image
+ * together. Candidates are only views onto the source (or its planar copy), their pixels are not copied until one is
+ * selected, and then in the layout of what they view
  */
 void Quilt::extractPatches()
 {
+    trace::Scope scope("extract patches");
+    RGBPlane* plane = m_planarSource != nullptr ? m_planarSource : m_source.getPlane();
+
+    if (m_sampleStep != GRID_SAMPLING)
+    {
+        for (int y = 0; y + m_patchSize <= plane->getHeight(); y += m_sampleStep)
+        {
+            for (int x = 0; x + m_patchSize <= plane->getWidth(); x += m_sampleStep)
+            {
+                m_candidates.push_back(PatchView(*plane, x, y, m_patchSize));
+            }
+        }
+
+        return;
+    }
+
     int patchesPerSide = m_source.getWidth() / m_patchSize;
 
     for (int i = 0 ; i < patchesPerSide ; i++)
@@ -98,19 +199,81 @@ void Quilt::extractPatches()
         for (int j = 0 ; j < patchesPerSide ; j++)
         {
             int colLower = j * m_patchSize;
-            m_patchSet.push_back(Quilt::getPatchFromSourceAt(colLower, rowLower, colLower + m_patchSize - 1, rowLower + m_patchSize - 1, 0));
+
+            // The region is read flipped, so in the storage space of the source its bottom row is its origin
+            m_candidates.push_back(PatchView(*plane, colLower, m_source.getHeight() - m_patchSize - rowLower, m_patchSize));
         }
     }
 }
 
+/**
+ * Decides how candidates will be searched, and builds whatever that needs up front.
+ *
+ * Large dense candidate sets get a CandidateIndex per overlap configuration (left only, top only, both), so each
+ * lookup is sublinear in the number of candidates. Otherwise scoring every candidate directly costs about
+ * (candidates * overlap pixels) per cell, while the error map of an OverlapSearch costs a few FFTs of the source
+ * whatever the number of candidates, so the map is only built when it is the cheaper of the two.
+ */
+void Quilt::prepareSearch()
+{
+    trace::Scope scope("prepare search");
+    int overlap = m_patchSize / Quilt::OVERLAP_DIVISOR;
+
+    // Both are built from the interleaved source, whose coordinates the candidates share whatever they view
+    RGBPlane* plane = m_source.getPlane();
+
+    m_search = nullptr;
+    m_indices[0] = m_indices[1] = m_indices[2] = nullptr;
+
+    if (m_sampleStep != GRID_SAMPLING && overlap > 0 && m_candidates.size() >= INDEX_MIN_CANDIDATES)
+    {
+        m_indices[0] = new CandidateIndex(*plane, m_candidates, m_patchSize, true, false);
+        m_indices[1] = new CandidateIndex(*plane, m_candidates, m_patchSize, false, true);
+        m_indices[2] = new CandidateIndex(*plane, m_candidates, m_patchSize, true, true);
+        return;
+    }
+
+    long long overlapPixels = 2LL * m_patchSize * overlap - overlap * overlap;
+    long long directCost = (long long) m_candidates.size() * overlapPixels;
+
+    if (directCost > OverlapSearch::getQueryCost(*plane))
+    {
+        m_search = new OverlapSearch(*plane, m_patchSize);
+    }
+}
+
+/**
+ * Checks that the corners given to getPatchFromSourceAt span exactly one patch, as only the first corner and the patch
+ * size are needed to view it
+ *
+ * @param patchSize The side length of the patch
+ * @param x1 The column of the first corner
+ * @param y1 The row of the first corner
+ * @param x2 The column of the opposite corner, inclusive
+ * @param y2 The row of the opposite corner, inclusive
+ * @throws invalid_argument If the corners are not patchSize apart in both directions
+ */
+static void checkPatchCorners(int patchSize, int x1, int y1, int x2, int y2)
+{
+    if (x2 - x1 + 1 != patchSize || y2 - y1 + 1 != patchSize)
+    {
+        throw invalid_argument("Patch corners must span exactly the patch size");
+    }
+}
+
 Patch* Quilt::getPatchFromSourceAt(int x1, int y1, int x2, int y2, char code)
 {
-	return new Patch(*m_source.getPlane()->getRegion(x1, y1, x2, y2, true), m_patchSize, code);
+    checkPatchCorners(m_patchSize, x1, y1, x2, y2);
+
+    // Flipped to accommodate the bitmap structure, see RGBPlane::getRegion
+	return new Patch(PatchView(*m_source.getPlane(), x1, m_source.getHeight() - 1 - y2, m_patchSize), code);
 }
 
 Patch* Quilt::getPatchFromSourceAt(BMPFile& source, int patchSize, int x1, int y1, int x2, int y2, char code)
 {
-    return new Patch(*source.getPlane()->getRegion(x1, y1, x2, y2, false), patchSize, code);
+    checkPatchCorners(patchSize, x1, y1, x2, y2);
+
+    return new Patch(PatchView(*source.getPlane(), x1, y1, patchSize), code);
 }
 
 /**
@@ -140,70 +303,146 @@ void Quilt::layoutPatches(vector<Patch*> patches)
 	}
 }
 
+/**
+ * Chooses every patch of the quilt. A patch only depends on its left and top neighbours, so the grid is filled one
+ * anti-diagonal at a time, with all the patches of a diagonal chosen in parallel.
+ *
+ * Each cell draws from its own random engine, seeded from the seed of the quilt and the position of the cell, so the
+ * result for a given seed is the same whatever the number of threads or the order the cells are run in.
+ *
+ * The patches of a previous generate are deleted first, and their planes given back to the arena in one go.
+ */
 void Quilt::generate()
 {
-	for (int i = 0; i < m_patchesPerSide; i++)
-	{
-		vector<Patch*> row;
+    trace::Scope scope("generate quilt");
+    int n = m_patchesPerSide;
 
-		for (int j = 0; j < m_patchesPerSide; j++)
-		{
-			Patch* left = j != 0 ? row[j - 1] : nullptr;
-			Patch* above = i != 0 ? m_patches[i - 1][j] : nullptr;
+    deletePatches();
+    m_patches.assign(n, vector<Patch*>(n, nullptr));
 
-			row.push_back(getPatch(left, above));
-		}
+    for (int diagonal = 0; diagonal < 2 * n - 1; diagonal++)
+    {
+        int first = max(0, diagonal - (n - 1));
+        int last = min(diagonal, n - 1);
 
-        m_patches.push_back(row);
-	}
+        m_pool->parallelFor(last - first + 1, [&](int k)
+        {
+            int i = first + k;
+            int j = diagonal - i;
+            Patch* left = j != 0 ? m_patches[i][j - 1] : nullptr;
+            Patch* above = i != 0 ? m_patches[i - 1][j] : nullptr;
+            default_random_engine generator(util::hashCoordinates(m_seed, j, i));
+
+            m_patches[i][j] = getPatch(left, above, generator);
+        });
+    }
 }
 
+/**
+ * Cuts the boundaries of every patch and composites them into the output plane.
+ *
+ * A cut only reads the error plane its own patch was given when it was chosen, so all the cuts are made in parallel.
+ * Compositing is split into bands of output rows, and each band draws the patches covering it in row-major order, so
+ * every output pixel ends up with the same patch on top as in a serial pass while no two threads write the same row.
+ *
+ * @return The output plane
+ */
 RGBPlane* Quilt::makeSeamsAndQuilt()
 {
-	for (int i = 0; i < m_patchesPerSide; i++)
-	{
-        cout << "ROW: " << i << endl;
-		for (int j = 0; j < m_patchesPerSide; j++)
-		{
-            cout << "\tCOL: " << j << endl;
-			Patch* left = j != 0 ? m_patches[i][j - 1] : nullptr;
-			Patch* top = i != 0 ? m_patches[i - 1][j] : nullptr;
+    int n = m_patchesPerSide;
+    int step = m_patchSize - m_patchSize / Quilt::OVERLAP_DIVISOR;
+
+    {
+        trace::Scope scope("cut seams");
+
+        m_pool->parallelFor(n * n, [&](int k)
+        {
+            int i = k / n;
+            int j = k % n;
+            Patch* left = j != 0 ? m_patches[i][j - 1] : nullptr;
+            Patch* top = i != 0 ? m_patches[i - 1][j] : nullptr;
+
+            m_patches[i][j]->calculateLeastCostBoundaries(left, top);
+        });
+    }
 
-			m_patches[i][j]->calculateLeastCostBoundaries(left, top);
+    trace::Scope scope("composite");
 
-            for (int y = 0; y < m_patchSize; y++)
+    m_pool->parallelFor(n, [&](int band)
+    {
+        trace::Scope bandScope("composite band");
+        int rowBegin = band * step;
+        int rowEnd = band == n - 1 ? m_dimension : rowBegin + step;
+
+        for (int i = 0; i < n; i++)
+        {
+            if (i * step >= rowEnd || i * step + m_patchSize <= rowBegin)
             {
-                for (int x = 0; x < m_patchSize; x++)
-                {
-                    setOutputPixel(m_patches[i][j], j, i, x, y);
-                }
+                continue;
             }
-		}
-	}
+
+            for (int j = 0; j < n; j++)
+            {
+                compositePatch(m_patches[i][j], j, i, rowBegin, rowEnd);
+            }
+        }
+    });
 
     return m_output;
 }
 
 /**
- * Sets the value of the output plane's pixel given the specified patch
- * @param patch The patch to extract the specific pixel from
+ * Copies the pixels of the given patch that lie within its boundary cuts into the output plane, interleaving them if
+ * the patch is planar
+ * @param patch The patch to copy the pixels from
  * @param patchPosX The x position of the patch in the space of THIS QUILT. This is the patch's position
  * @param patchPosY The y position of the patch in the space of THIS QUILT. This is the patch's position
- * @param x The x position of the PIXEL in the patch
- * @param y The y position of the PIXEL in the patch
+ * @param rowBegin The first row of the output plane that may be written
+ * @param rowEnd The row of the output plane after the last that may be written
  */
-void Quilt::setOutputPixel(Patch* patch, int patchPosX, int patchPosY, int x, int y)
+void Quilt::compositePatch(Patch* patch, int patchPosX, int patchPosY, int rowBegin, int rowEnd)
 {
     int overlap = m_patchSize / Quilt::OVERLAP_DIVISOR;
-    int quiltX = (patchPosX * (m_patchSize - overlap)) + x;
-    int quiltY = (patchPosY * (m_patchSize - overlap)) + y;
+    int quiltX = patchPosX * (m_patchSize - overlap);
+    int quiltY = patchPosY * (m_patchSize - overlap);
+    RGBPlane* pixels = patch->getRGBPlane();
+    IntPlane* mask = patch->getBoundaries();
 
-    int* pixel = patch->getPixelAt(x, y);
-    unsigned char mask = (unsigned char) patch->getBoundaries()->getPixelValueAt(x, y);
-
-    if (mask)
+    for (int y = max(0, rowBegin - quiltY); y < min(m_patchSize, rowEnd - quiltY); y++)
     {
-        m_output->setPixelValueAt(quiltX, quiltY, (unsigned char) pixel[0], (unsigned char) pixel[1], (unsigned char) pixel[2], false);
+        const int* maskRow = mask->getRow(y);
+        unsigned char* dst = m_output->getPixel(quiltX, quiltY + y);
+
+        if (pixels->getLayout() == RGBPlane::PLANAR)
+        {
+            const unsigned char* red = pixels->getChannelRow(0, y);
+            const unsigned char* green = pixels->getChannelRow(1, y);
+            const unsigned char* blue = pixels->getChannelRow(2, y);
+
+            for (int x = 0; x < m_patchSize; x++)
+            {
+                if (maskRow[x])
+                {
+                    dst[x * 3] = red[x];
+                    dst[x * 3 + 1] = green[x];
+                    dst[x * 3 + 2] = blue[x];
+                }
+            }
+
+            continue;
+        }
+
+        const unsigned char* src = pixels->getRow(y);
+
+        for (int x = 0; x < m_patchSize; x++)
+        {
+            if (maskRow[x])
+            {
+                dst[x * 3] = src[x * 3];
+                dst[x * 3 + 1] = src[x * 3 + 1];
+                dst[x * 3 + 2] = src[x * 3 + 2];
+            }
+        }
     }
 }
 
@@ -212,48 +451,143 @@ void Quilt::setOutputPixel(Patch* patch, int patchPosX, int patchPosY, int x, in
  * patch set that satisfies the minimum overlap error. Then makes a least-cost cut along the boundary of the top/left
  * edges of the patch.
  *
+ * Candidates are scored through their views, either read from the error map of the OverlapSearch or directly, so no
+ * candidate is copied. Only the selected patch is materialized and has its error plane populated, for the boundary cut.
+ * Candidates are scored in chunks of SCORING_CHUNK spread over the thread pool of the quilt, and the chunks are merged
+ * so that the choice is the same as scoring them one by one.
+ *
  * @param left The patch to the left of the patch to be placed, nullptr if the patch to be placed is the first in the row
  * @param above The patch above the patch to be placed, nullptr if this is the first row of patches
  */
 Patch* Quilt::getPatch(Patch *left, Patch *above)
+{
+    return getPatch(left, above, m_generator);
+}
+
+/**
+ * Returns the next patch, drawing the random choices from the given engine. Safe to call from several threads at once,
+ * as long as each uses its own engine. The planes of the patch are carved from the arena of this quilt, so the patch
+ * must not be used once the quilt generates again or is destroyed.
+ *
+ * @param left The patch to the left of the patch to be placed, nullptr if the patch to be placed is the first in the row
+ * @param above The patch above the patch to be placed, nullptr if this is the first row of patches
+ * @param generator The random engine to draw from
+ * @see Quilt::getPatch(Patch*, Patch*)
+ */
+Patch* Quilt::getPatch(Patch *left, Patch *above, default_random_engine& generator)
 {
 	// First patch in whole quilt, just pick a random one
 	if (left == nullptr && above == nullptr)
 	{
-        Patch* p = getRandom(m_patchSet, false);
-		return new Patch(*p);
+        uniform_int_distribution<int> dist(0, m_candidates.size() - 1);
+		return new Patch(m_candidates[dist(generator)], 0, &m_arena);
 	}
 
-	vector<Patch*> patches;
-	vector<Patch*>::iterator it;
-	int bestError = INT_MAX;
+    trace::Scope scope("score candidates");
+
+    // The scratch belongs to this call alone: the chunks below read it from other threads, and this thread may choose
+    // another patch before they are done
+    vector<long long> errors;
+    vector<int> scored;
+    vector<long long> errorMap;
+    vector<long long> chunkBests;
+    vector<vector<int>> chunkFits;
+    long long bestError = LLONG_MAX;
 
-	// Loop through once to calculate overlap region errors
-    for (it = m_patchSet.begin() ; it < m_patchSet.end() ; it++)
+    if (m_indices[0] != nullptr)
     {
-        Patch *patch = new Patch(**it);
-        int error = patch->getOverlapScore(left, above);
-        bestError = error < bestError ? error : bestError;
+        // Only the nearest few candidates in the index are scored, exactly
+        CandidateIndex* index = m_indices[(left != nullptr ? 1 : 0) + (above != nullptr ? 2 : 0) - 1];
 
-        patches.push_back(patch);
+        index->findNearest(left, above, INDEX_NEIGHBOURS, scored);
     }
+    else
+    {
+        scored.resize(m_candidates.size());
+
+        for (size_t i = 0; i < m_candidates.size(); i++)
+        {
+            scored[i] = (int) i;
+        }
+    }
+
+    int chunks = (scored.size() + SCORING_CHUNK - 1) / SCORING_CHUNK;
 
-	// Loop again to trim patches that fall outside of acceptable margin of error
-    for (it = patches.begin(); it != patches.end();)
+    trace::count("candidates scored", scored.size());
+    errors.resize(scored.size());
+    chunkBests.resize(chunks);
+    chunkFits.resize(chunks);
+
+    if (m_search != nullptr)
     {
-        // Not within X% of least error
-        if ((*it)->getTotalError() > bestError * Quilt::BEST_FIT_MARGIN)
+        m_search->computeErrors(left, above, errorMap);
+    }
+
+    // Each chunk keeps its own best error, and the candidates within the margin of it. The best of the whole set is
+    // never worse than a chunk's best, so every candidate within the margin of it is in one of these lists
+    m_pool->parallelFor(chunks, [&](int chunk)
+    {
+        int begin = chunk * SCORING_CHUNK;
+        int end = min((int) scored.size(), begin + SCORING_CHUNK);
+        long long best = LLONG_MAX;
+        vector<int>& fits = chunkFits[chunk];
+
+        for (int i = begin; i < end; i++)
         {
-            delete *it;
-            it = patches.erase(it);
+            const PatchView& view = m_candidates[scored[i]];
+
+            if (m_search != nullptr)
+            {
+                errors[i] = errorMap[view.getY() * m_search->getCandidateWidth() + view.getX()];
+            }
+            else
+            {
+                errors[i] = view.getOverlapScore(left, above);
+            }
+
+            best = errors[i] < best ? errors[i] : best;
         }
-        else
+
+        fits.clear();
+
+        for (int i = begin; i < end; i++)
         {
-            it++;
+            if (errors[i] <= best * Quilt::BEST_FIT_MARGIN)
+            {
+                fits.push_back(i);
+            }
         }
+
+        chunkBests[chunk] = best;
+    });
+
+    for (int i = 0; i < chunks; i++)
+    {
+        bestError = chunkBests[i] < bestError ? chunkBests[i] : bestError;
     }
 
-    return getRandom(patches, true);
+    // Keep the candidates that fall within the acceptable margin of error, in the same order as a serial pass
+    vector<int> fits;
+
+    for (int i = 0; i < chunks; i++)
+    {
+        for (size_t j = 0; j < chunkFits[i].size(); j++)
+        {
+            int index = chunkFits[i][j];
+
+            if (errors[index] <= bestError * Quilt::BEST_FIT_MARGIN)
+            {
+                fits.push_back(scored[index]);
+            }
+        }
+    }
+
+    uniform_int_distribution<int> dist(0, fits.size() - 1);
+    Patch* patch = new Patch(m_candidates[fits[dist(generator)]], 0, &m_arena);
+
+    patch->getOverlapScore(left, above);
+
+    return patch;
 }
 
 /**
@@ -284,13 +618,59 @@ Patch* Quilt::getRandom(vector<Patch*> &patches, bool del)
 /**
  * Gets the output RGBPlane generated after the seam process has been completed
  *
- * @return The output of the seam process
+ * @return The output of the seam process, which belongs to this quilt
  */
 RGBPlane* Quilt::getOutput()
 {
     return m_output;
 }
 
+/**
+ * Gets the arena the planes of the patches this quilt chooses are carved from, such as to read its stats
+ * @return The arena of this quilt
+ */
+Arena& Quilt::getArena()
+{
+    return m_arena;
+}
+
+/**
+ * Sets the seed every random choice of this quilt is derived from. Generating twice with the same seed (and the same
+ * source) gives the same quilt.
+ *
+ * @param seed The seed
+ */
+void Quilt::setSeed(unsigned long long seed)
+{
+    m_seed = seed;
+    m_generator = default_random_engine(util::hashCoordinates(seed, -1, -1));
+}
+
+/**
+ * Gets the seed every random choice of this quilt is derived from
+ * @return The seed
+ */
+unsigned long long Quilt::getSeed()
+{
+    return m_seed;
+}
+
+/**
+ * Sets the number of threads used to generate and composite this quilt
+ *
+ * @param threads The number of threads, or 0 to use one per hardware thread
+ */
+void Quilt::setThreadCount(int threads)
+{
+    if (m_ownsPool)
+    {
+        delete m_pool;
+    }
+
+    m_pool = new ThreadPool(threads);
+    m_ownsPool = true;
+}
+
 /**
  * Gets the dimension of the quilt (side length)
  *
@@ -308,22 +688,91 @@ vector<vector<Patch*>> Quilt::getPatches()
 
 /**
  * Gets the tile from the rotated center of this quilt, with the coded edges taken from the codes of each of the patches
- * this Quilt is composed from
+ * this Quilt is composed from.
+ *
+ * This defines the orientation of a tile. The patch rows are laid out from the bottom of the output, and extractTile
+ * turns the quilt 45 degrees clockwise, so the top left patch (m_patches[1][0]) runs along the north edge of the tile,
+ * the top right one along the east, the bottom right one along the south and the bottom left one along the west.
+ * Callers building tiles lay their patches out accordingly, see TileSetBuilder::build
  *
  * @return The tile from this Quilt's center
  */
-Tile* Quilt::getTile()
+Tile Quilt::getTile()
 {
-    RGBPlane* tilePlane = getOutput()->rotate();
+    trace::Scope scope("crop tile");
+    vector<char> codes = {m_patches[1][0]->getCode(), m_patches[1][1]->getCode(), m_patches[0][1]->getCode(), m_patches[0][0]->getCode()};
+    RGBPlane plane(getTileSize(), getTileSize());
 
-    vector<char> codes = {m_patches[0][0]->getCode(), m_patches[0][1]->getCode(), m_patches[1][1]->getCode(), m_patches[1][0]->getCode()};
+    extractTile(plane);
 
-    int offset = tilePlane->getWidth() / 4 + 6;
-    int width = (tilePlane->getWidth() / 2) - 12;
+    return Tile(BMPFile(move(plane)), move(codes));
+}
 
-    RGBPlane* region = tilePlane->getRegion(offset, offset, offset + width, offset + width, true);
+/**
+ * Gets the side length of the tile cut from this quilt: the side of the diamond joining the midpoints of the edges of
+ * the output, less TILE_MARGIN on each side to keep clear of the edges it touches
+ *
+ * @return The tile size
+ * @throws invalid_argument If the quilt is too small to leave a tile inside the margins
+ */
+int Quilt::getTileSize()
+{
+    int size = (int) (m_dimension / sqrt(2.0)) - 2 * TILE_MARGIN;
 
-    BMPFile file = BMPFile(*region);
+    if (size < 1)
+    {
+        throw invalid_argument("Quilt is too small to cut a tile from");
+    }
+
+    return size;
+}
 
-    return new Tile(file, codes);
+/**
+ * Samples the tile straight out of the output: the diamond joining the midpoints of its edges, turned 45 degrees. Each
+ * tile pixel takes the output pixel nearest to where its centre lands, with no intermediate rotated image.
+ *
+ * The rotation is walked incrementally in fixed point (FIXED_SHIFT fractional bits). Working top-down in both planes,
+ * one step along a tile row moves (1, -1) / sqrt(2) through the output, and one step down a tile column moves
+ * (1, 1) / sqrt(2), so each pixel costs two additions. That turns the quilt clockwise: the top edge of the tile runs
+ * through the top left patch, which getTile takes the north code from.
+ *
+ * @param tile The plane to write the tile into, getTileSize() on a side
+ * @throws invalid_argument If the quilt is too small for a tile, or the plane is not the size of the tile
+ */
+void Quilt::extractTile(RGBPlane& tile)
+{
+    int size = getTileSize();
+
+    if (tile.getWidth() != size || tile.getHeight() != size)
+    {
+        throw invalid_argument("Tile plane must be the size of the tile of the quilt");
+    }
+
+    const long long one = 1LL << FIXED_SHIFT;
+    const double half = sqrt(0.5);
+    long long step = llround(half * one);
+    long long last = m_dimension - 1;
+
+    // Where the centre of the top left tile pixel lands, relative to the centre of the output
+    double offset = 0.5 - size / 2.0;
+    long long rowX = llround((m_dimension / 2.0 + half * offset + half * offset) * one);
+    long long rowY = llround((m_dimension / 2.0 - half * offset + half * offset) * one);
+
+    for (int v = 0; v < size; v++, rowX += step, rowY += step)
+    {
+        unsigned char* dst = tile.getRow(size - 1 - v);
+        long long x = rowX;
+        long long y = rowY;
+
+        for (int u = 0; u < size; u++, x += step, y -= step, dst += 3)
+        {
+            long long sourceX = min(last, max(0LL, x >> FIXED_SHIFT));
+            long long sourceY = min(last, max(0LL, y >> FIXED_SHIFT));
+            const unsigned char* src = m_output->getPixel((int) sourceX, (int) (last - sourceY));
+
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
 }
@@ -13,6 +13,11 @@
 #include "BMPFile.h"
 #include "Patch.h"
 #include "Tile.h"
+#include "OverlapSearch.h"
+#include "PatchView.h"
+#include "CandidateIndex.h"
+#include "ThreadPool.h"
+#include "Arena.h"
 #include <vector>
 #include <random>
 
@@ -22,32 +27,62 @@ class Quilt
 {
 private:
     BMPFile& m_source;
+    RGBPlane* m_planarSource;
     int m_dimension;
     int m_patchesPerSide;
     int m_patchSize;
-    vector<Patch*> m_patchSet;
+    int m_sampleStep;
+    vector<PatchView> m_candidates;
+    OverlapSearch* m_search;
+    CandidateIndex* m_indices[3];
 	vector<vector<Patch*>> m_patches;
 	RGBPlane* m_output;
     default_random_engine m_generator;
+    unsigned long long m_seed;
+    ThreadPool* m_pool;
+    bool m_ownsPool;
+    Arena m_arena;
+    bool m_ownsPatches;
 
     void extractPatches();
+    void prepareSearch();
 	void layoutPatches(vector<Patch*>);
-    void setOutputPixel(Patch*, int, int, int, int);
+    void compositePatch(Patch*, int, int, int, int);
+    void deletePatches();
 
 public:
     const static int OVERLAP_DIVISOR = 6;
     constexpr static double BEST_FIT_MARGIN = 1.1;
+    const static int GRID_SAMPLING = 0;
+    const static int INDEX_MIN_CANDIDATES = 4096;
+    const static int INDEX_NEIGHBOURS = 32;
+    const static int SCORING_CHUNK = 256;
+    // Pixels taken off each side of the tile, so that its corners, which would land on the midpoints of the edges of
+    // the quilt, stay 6 * sqrt(2) (about 8) pixels inside it instead of sampling its outermost rows and columns. 6 is
+    // what the original crop of the rotated quilt took, 12 off its width
+    const static int TILE_MARGIN = 6;
+    const static int FIXED_SHIFT = 16;
 
     Quilt(BMPFile&, int, int);
+    Quilt(BMPFile&, int, int, int);
+    Quilt(BMPFile&, int, int, int, RGBPlane::Layout);
 	Quilt(BMPFile&, int, vector<Patch*>);
+	Quilt(BMPFile&, int, vector<Patch*>, ThreadPool*);
     void generate();
     Patch* getPatch(Patch*, Patch*);
+    Patch* getPatch(Patch*, Patch*, default_random_engine&);
 	Patch* getRandom(vector<Patch*>&, bool);
     int getDimension();
+    void setSeed(unsigned long long);
+    unsigned long long getSeed();
+    void setThreadCount(int);
 	RGBPlane* makeSeamsAndQuilt();
     vector<vector<Patch*>> getPatches();
     RGBPlane* getOutput();
-    Tile* getTile();
+    Arena& getArena();
+    Tile getTile();
+    int getTileSize();
+    void extractTile(RGBPlane&);
 
 	Patch* getPatchFromSourceAt(int, int, int, int, char);
     static Patch* getPatchFromSourceAt(BMPFile&, int, int, int, int, int, char);
@@ -3,45 +3,218 @@
  *
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 02/25/17
+ * @version 1.1 - 04/08/17 - Affine warps, resizes and rotations through the resample kernels
+ * @version 1.2 - 04/09/17 - Planar layout
  */
 
 #include <stdexcept>
 #include <iostream>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include "RGBPlane.h"
+#include "SSD.h"
+#include "Trace.h"
 
 using namespace std;
 
 /**
- * Constructs the RGBPlane with the specified dimensions
+ * Constructs the RGBPlane with the specified dimensions, interleaved
  *
  * @param width The width of the plane
  * @param height The height of the plane
  */
-RGBPlane::RGBPlane(int width, int height)
+RGBPlane::RGBPlane(int width, int height) : RGBPlane(width, height, INTERLEAVED)
+{
+}
+
+/**
+ * Constructs the RGBPlane with the specified dimensions and layout
+ *
+ * @param width The width of the plane
+ * @param height The height of the plane
+ * @param layout How the channels are laid out
+ */
+RGBPlane::RGBPlane(int width, int height, Layout layout)
 {
     m_width = width;
     m_height = height;
-    m_pixelData = new unsigned char[m_width * m_height * 3]; // Since we are holding 3 values for every pixel
+    m_layout = layout;
+    allocate(nullptr);
 }
 
 /**
- * Copy constructor
+ * Constructs the RGBPlane over pixels held somewhere else (such as a mapped TilePack), without copying them. The pixels
+ * are laid out as this plane would hold them itself, and must outlive it.
  *
- * @param plane The plane to copy the pixel values from
+ * @param width The width of the plane
+ * @param height The height of the plane
+ * @param pixels The R, G, B values of the plane, interleaved, row by row from the bottom. Not deleted by this plane
  */
-RGBPlane::RGBPlane(const RGBPlane& plane)
+RGBPlane::RGBPlane(int width, int height, unsigned char* pixels)
+{
+    m_width = width;
+    m_height = height;
+    m_layout = INTERLEAVED;
+    m_stride = 3LL * width;
+    m_channelSize = 1;
+    m_pixelData = pixels;
+    m_allocation = nullptr;
+    m_ownsPixels = false;
+}
+
+/**
+ * Constructs the RGBPlane with its pixels carved from an arena, which frees them when it is reset rather than this
+ * plane when it is deleted. The pixels are not initialized.
+ *
+ * @param width The width of the plane
+ * @param height The height of the plane
+ * @param arena The arena to allocate the pixels from, which must not be reset while this plane is in use
+ */
+RGBPlane::RGBPlane(int width, int height, Arena& arena) : RGBPlane(width, height, arena, INTERLEAVED)
+{
+}
+
+/**
+ * Constructs the RGBPlane with the given layout, with its pixels carved from an arena, see
+ * RGBPlane::RGBPlane(int, int, Arena&)
+ *
+ * @param width The width of the plane
+ * @param height The height of the plane
+ * @param arena The arena to allocate the pixels from, which must not be reset while this plane is in use
+ * @param layout How the channels are laid out
+ */
+RGBPlane::RGBPlane(int width, int height, Arena& arena, Layout layout)
+{
+    m_width = width;
+    m_height = height;
+    m_layout = layout;
+    allocate(&arena);
+}
+
+/**
+ * Allocates the pixels for the size and layout of the plane. Each channel of a planar plane starts aligned to
+ * PLANAR_ALIGNMENT, and so does each of its rows, the arena already aligning what it hands out
+ *
+ * @param arena The arena to allocate the pixels from, or nullptr for the plane to own them
+ */
+void RGBPlane::allocate(Arena* arena)
+{
+    long long bytes;
+
+    if (m_layout == PLANAR)
+    {
+        m_stride = ((long long) m_width + PLANAR_ALIGNMENT - 1) / PLANAR_ALIGNMENT * PLANAR_ALIGNMENT;
+        m_channelSize = m_stride * m_height;
+        bytes = 3 * m_channelSize;
+    }
+    else
+    {
+        m_stride = 3LL * m_width;
+        m_channelSize = 1;
+        bytes = 3LL * m_width * m_height; // Since we are holding 3 values for every pixel
+    }
+
+    if (arena != nullptr)
+    {
+        m_pixelData = arena->allocateArray<unsigned char>((size_t) bytes);
+        m_allocation = nullptr;
+        m_ownsPixels = false;
+    }
+    else if (m_layout == PLANAR)
+    {
+        m_allocation = new unsigned char[bytes + PLANAR_ALIGNMENT];
+        size_t misalignment = (uintptr_t) m_allocation % PLANAR_ALIGNMENT;
+
+        m_pixelData = m_allocation + (misalignment == 0 ? 0 : PLANAR_ALIGNMENT - misalignment);
+        m_ownsPixels = true;
+    }
+    else
+    {
+        m_allocation = new unsigned char[bytes];
+        m_pixelData = m_allocation;
+        m_ownsPixels = true;
+    }
+}
+
+/**
+ * Move constructor. Takes over the pixels of the given plane, which is left empty
+ *
+ * @param plane The plane to take the pixels of
+ */
+RGBPlane::RGBPlane(RGBPlane&& plane)
 {
     m_width = plane.m_width;
     m_height = plane.m_height;
-    m_pixelData = new unsigned char[plane.m_width * plane.m_height * 3];
+    m_layout = plane.m_layout;
+    m_stride = plane.m_stride;
+    m_channelSize = plane.m_channelSize;
+    m_pixelData = plane.m_pixelData;
+    m_allocation = plane.m_allocation;
+    m_ownsPixels = plane.m_ownsPixels;
+    plane.m_width = 0;
+    plane.m_height = 0;
+    plane.m_stride = 0;
+    plane.m_pixelData = nullptr;
+    plane.m_allocation = nullptr;
+    plane.m_ownsPixels = false;
+}
 
-    copy(plane.m_pixelData, plane.m_pixelData + (plane.m_width * plane.m_height * 3), m_pixelData);
+/**
+ * Move assignment. Frees the pixels of this plane, and takes over those of the given one, which is left empty
+ *
+ * @param plane The plane to take the pixels of
+ * @return This plane
+ */
+RGBPlane& RGBPlane::operator=(RGBPlane&& plane)
+{
+    if (this != &plane)
+    {
+        if (m_ownsPixels)
+        {
+            delete [] m_allocation;
+        }
+
+        m_width = plane.m_width;
+        m_height = plane.m_height;
+        m_layout = plane.m_layout;
+        m_stride = plane.m_stride;
+        m_channelSize = plane.m_channelSize;
+        m_pixelData = plane.m_pixelData;
+        m_allocation = plane.m_allocation;
+        m_ownsPixels = plane.m_ownsPixels;
+        plane.m_width = 0;
+        plane.m_height = 0;
+        plane.m_stride = 0;
+        plane.m_pixelData = nullptr;
+        plane.m_allocation = nullptr;
+        plane.m_ownsPixels = false;
+    }
+
+    return *this;
+}
+
+/**
+ * Makes a deep copy of this plane in the same layout, which owns its pixels even if this plane borrows them
+ *
+ * @return The copy
+ */
+RGBPlane RGBPlane::clone() const
+{
+    RGBPlane plane(m_width, m_height, m_layout);
+    long long bytes = m_layout == PLANAR ? 3 * m_channelSize : 3LL * m_width * m_height;
+
+    copy(m_pixelData, m_pixelData + bytes, plane.m_pixelData);
+
+    return plane;
 }
 
 RGBPlane::~RGBPlane()
 {
-//    delete [] m_pixelData;
+    if (m_ownsPixels)
+    {
+        delete [] m_allocation;
+    }
 }
 
 /**
@@ -51,12 +224,9 @@ RGBPlane::~RGBPlane()
  * @param y The y value of the point
  * @return The start index of the RGB values in the pixel data array
  */
-int RGBPlane::getIndexFromPoint(int x, int y)
+long long RGBPlane::getIndexFromPoint(int x, int y)
 {
-    x *= 3;
-    y *= 3;
-
-    return y * m_width + x;
+    return 3 * ((long long) y * m_width + x);
 }
 
 /**
@@ -77,14 +247,35 @@ vector<unsigned char> RGBPlane::getPixelValueAt(int x, int y, bool flip)
         throw invalid_argument("Received x or y value that exceeds width or height of plane (or they are less than 0)");
     }
 
-    vector<unsigned char> data(3);
-    int startIndex = getIndexFromPoint(x, y);
+    return {getSample(x, y, 0), getSample(x, y, 1), getSample(x, y, 2)};
+}
+
+/**
+ * Gets the RGB values for the given pixel at x, y without copying them. This is the bounds checked counterpart of
+ * RGBPlane::getPixel(int, int)
+ *
+ * @param x The x value of the pixel in the plane
+ * @param y The y value of the pixel in the plane
+ * @param flip If the y values should be flipped to accommodate retrieving data from a bitmap structure
+ * @return Pointer to the R value of the specified pixel, followed by its G and B values (NOT A COPY)
+ * @throws invalid_argument if the given x or y values exceeds the width or height of the plane (or less than 0), or
+ *                          the plane is not interleaved
+ */
+const unsigned char* RGBPlane::getPixelAt(int x, int y, bool flip) const
+{
+    y = flip ? m_height - 1 - y : y;
+
+    if (m_layout != INTERLEAVED)
+    {
+        throw invalid_argument("Pixels of a planar plane are not held together, see RGBPlane::getSample");
+    }
 
-    data[0] = m_pixelData[startIndex];
-    data[1] = m_pixelData[startIndex + 1];
-    data[2] = m_pixelData[startIndex + 2];
+    if (x >= m_width || y >= m_height || x < 0 || y < 0)
+    {
+        throw invalid_argument("Received x or y value that exceeds width or height of plane (or they are less than 0)");
+    }
 
-    return data;
+    return getPixel(x, y);
 }
 
 /**
@@ -107,7 +298,15 @@ void RGBPlane::setPixelValueAt(int x, int y, unsigned char r, unsigned char g, u
         throw invalid_argument("Received x or y value that exceeds width or height of plane (or they are less than 0)");
     }
 
-    int startIndex = getIndexFromPoint(x, y);
+    if (m_layout == PLANAR)
+    {
+        getChannelRow(0, y)[x] = r;
+        getChannelRow(1, y)[x] = g;
+        getChannelRow(2, y)[x] = b;
+        return;
+    }
+
+    long long startIndex = getIndexFromPoint(x, y);
 
     m_pixelData[startIndex] = r;
     m_pixelData[startIndex + 1] = g;
@@ -115,15 +314,15 @@ void RGBPlane::setPixelValueAt(int x, int y, unsigned char r, unsigned char g, u
 }
 
 /**
- * Gets the raw value at a specific index
+ * Gets the raw value at a specific index, in the layout of the plane
  *
  * @param ind The index to get the data at
  * @return The data at the specified index
  * @throws invalid_argument If the given index is out of bounds for this plane's allocated data
  */
-unsigned char RGBPlane::getValueAt(int ind)
+unsigned char RGBPlane::getValueAt(long long ind)
 {
-    if (ind >= (m_width * m_height * 3))
+    if (ind < 0 || ind >= (m_layout == PLANAR ? 3 * m_channelSize : 3LL * m_width * m_height))
     {
         throw invalid_argument("Index out of bounds of stored data for this plane");
     }
@@ -138,25 +337,92 @@ unsigned char RGBPlane::getValueAt(int ind)
  * @param x2 The bottom right corner x-value
  * @param y2 The bottom right corner y-value
  * @param flip If the y values should be flipped to accommodate retrieving data from a bitmap structure
- * @return A new subset region plane from the given region
+ * @return A new subset region plane from the given region, in the layout of this plane
  */
-RGBPlane* RGBPlane::getRegion(int x1, int y1, int x2, int y2, bool flip)
+RGBPlane RGBPlane::getRegion(int x1, int y1, int x2, int y2, bool flip) const
 {
     int width = x2 - x1 + 1;
     int height = y2 - y1 + 1;
-    RGBPlane* region = new RGBPlane(width, height);
+    RGBPlane region(width, height, m_layout);
+
+    if (flip)
+    {
+        // Row i of the flipped region is row (m_height - 1 - i) of this plane, and lands on row (height - 1 - y) of
+        // the flipped region, so in storage space it is still one contiguous block
+        region.copyRegionFrom(*this, x1, m_height - 1 - y2, width, height, 0, 0);
+    }
+    else
+    {
+        region.copyRegionFrom(*this, x1, y1, width, height, 0, 0);
+    }
+
+    return region;
+}
+
+/**
+ * Copies a block of pixels from the given plane into this one, one row at a time. All coordinates are in the storage
+ * space of the planes (no flipping). The planes may have different layouts, in which case the pixels are interleaved
+ * or split into channels as they are copied
+ *
+ * @param source The plane to copy the pixels from
+ * @param srcX The x value of the top left corner of the block in the source
+ * @param srcY The y value of the top left corner of the block in the source
+ * @param width The width of the block
+ * @param height The height of the block
+ * @param dstX The x value of where the top left corner of the block goes in this plane
+ * @param dstY The y value of where the top left corner of the block goes in this plane
+ * @throws invalid_argument if the block does not fit within either plane
+ */
+void RGBPlane::copyRegionFrom(const RGBPlane& source, int srcX, int srcY, int width, int height, int dstX, int dstY)
+{
+    if (srcX < 0 || srcY < 0 || srcX + width > source.m_width || srcY + height > source.m_height
+        || dstX < 0 || dstY < 0 || dstX + width > m_width || dstY + height > m_height)
+    {
+        throw invalid_argument("Region to copy exceeds the width or height of one of the planes");
+    }
 
-    for (int i = y1, y = 0 ; i <= y2 ; i++, y++)
+    for (int y = 0; y < height; y++)
     {
-        for (int j = x1, x = 0 ; j <= x2 ; j++, x++)
+        if (m_layout == INTERLEAVED && source.m_layout == INTERLEAVED)
+        {
+            memcpy(getPixel(dstX, dstY + y), source.getPixel(srcX, srcY + y), width * 3);
+        }
+        else if (m_layout == PLANAR && source.m_layout == PLANAR)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                memcpy(getChannelRow(c, dstY + y) + dstX, source.getChannelRow(c, srcY + y) + srcX, width);
+            }
+        }
+        else if (m_layout == PLANAR)
         {
-            vector<unsigned char> data = getPixelValueAt(j, i, flip);
+            const unsigned char* src = source.getPixel(srcX, srcY + y);
+            unsigned char* red = getChannelRow(0, dstY + y) + dstX;
+            unsigned char* green = getChannelRow(1, dstY + y) + dstX;
+            unsigned char* blue = getChannelRow(2, dstY + y) + dstX;
 
-            region->setPixelValueAt(x, y, data[0], data[1], data[2], flip);
+            for (int x = 0; x < width; x++)
+            {
+                red[x] = src[x * 3];
+                green[x] = src[x * 3 + 1];
+                blue[x] = src[x * 3 + 2];
+            }
         }
-    }
+        else
+        {
+            const unsigned char* red = source.getChannelRow(0, srcY + y) + srcX;
+            const unsigned char* green = source.getChannelRow(1, srcY + y) + srcX;
+            const unsigned char* blue = source.getChannelRow(2, srcY + y) + srcX;
+            unsigned char* dst = getPixel(dstX, dstY + y);
 
-    return region;
+            for (int x = 0; x < width; x++)
+            {
+                dst[x * 3] = red[x];
+                dst[x * 3 + 1] = green[x];
+                dst[x * 3 + 2] = blue[x];
+            }
+        }
+    }
 }
 
 /**
@@ -168,9 +434,15 @@ RGBPlane* RGBPlane::getRegion(int x1, int y1, int x2, int y2, bool flip)
  */
 void RGBPlane::flipRBValues()
 {
-    int size = m_width * m_height * 3;
+    if (m_layout == PLANAR)
+    {
+        swap_ranges(m_pixelData, m_pixelData + m_channelSize, m_pixelData + 2 * m_channelSize);
+        return;
+    }
+
+    long long size = 3LL * m_width * m_height;
 
-    for (int i = 0; i < size; i += 3)
+    for (long long i = 0; i < size; i += 3)
     {
         unsigned char tmp = m_pixelData[i];
         m_pixelData[i] = m_pixelData[i + 2];
@@ -180,7 +452,7 @@ void RGBPlane::flipRBValues()
 
 /**
  * Resizes the plane to the specified dimensions. This deletes the old pointer to the pixel array and creates a new
- * one.
+ * one, in the same layout.
  *
  * @param width The new width of the plane
  * @param height The new height of the plane
@@ -190,9 +462,12 @@ void RGBPlane::setDimensions(int width, int height)
     m_width = width;
     m_height = height;
 
-    delete [] m_pixelData;
+    if (m_ownsPixels)
+    {
+        delete [] m_allocation;
+    }
 
-    m_pixelData = new unsigned char[m_width * m_height * 3];
+    allocate(nullptr);
 }
 
 int RGBPlane::getWidth() const
@@ -206,7 +481,7 @@ int RGBPlane::getHeight() const
 }
 
 /**
- * Gets the actual data from the structure.
+ * Gets the actual data from the structure, in the layout of the plane.
  * @return The actual pointer to the data (NOT A COPY). Whoever calls this must not delete this pointer.
  */
 unsigned char* RGBPlane::getRawData()
@@ -214,58 +489,250 @@ unsigned char* RGBPlane::getRawData()
     return m_pixelData;
 }
 
+const unsigned char* RGBPlane::getRawData() const
+{
+    return m_pixelData;
+}
+
 /**
- * Rotates the plane 45 degrees, effectively resizing to account for the increase in the bouding box size and remapping all
- * the pixel data
+ * Resamples this plane into a new one through an affine map from the pixel centres of the new plane to the points of
+ * this one they are sampled at, see resample::warpAffine
+ *
+ * @param width The width of the new plane
+ * @param height The height of the new plane
+ * @param matrix The six coefficients of the map, in the storage space of the planes
+ * @param filter The filter to sample with
+ * @return The new plane, interleaved, black wherever it lands outside this one
+ * @throws invalid_argument If this plane is empty, or the new one has a negative size
  */
-RGBPlane* RGBPlane::rotate()
+RGBPlane RGBPlane::warpAffine(int width, int height, const double* matrix, resample::Filter filter) const
 {
-    float angle = -45 * (3.141592/180.0f);
-    float midX = ((float)m_width) / 2.0f;
-    float midY = ((float)m_height) / 2.0f;
+    if (width < 0 || height < 0)
+    {
+        throw invalid_argument("Width and height of a plane cannot be negative");
+    }
 
-    float sine = sin(angle);
-    float cosine = cos(angle);
+    // The kernels gather whole pixels, so a planar plane is interleaved first
+    if (m_layout != INTERLEAVED)
+    {
+        return toLayout(INTERLEAVED).warpAffine(width, height, matrix, filter);
+    }
 
-    // x = x cos - y sin
-    float topLeftTransformedX = (-midX * cosine) - (midY * sine);
-    float topRightTransformedX = (midX * cosine) - (midY * sine);
-    float bottomLeftTransformedX  = (-midX * cosine) - (-midY * sine);
-    float bottomRightTransformedX = (midX * cosine) - (-midY * sine);
+    RGBPlane plane(width, height);
 
-    float minx = min(topLeftTransformedX, min(topRightTransformedX, min(bottomLeftTransformedX, bottomRightTransformedX)));
-    float maxx = max(topLeftTransformedX, max(topRightTransformedX, max(bottomLeftTransformedX, bottomRightTransformedX)));
+    resample::warpAffine(*this, plane, matrix, filter);
 
-    // y = x sin + y cos
-    float topLeftTransformedY = (-midX * sine) + (midY * cosine);
-    float topRightTransformedY = (midX * sine) + (midY * cosine);
-    float bottomLeftTransformedY  = (-midX * sine) + (-midY * cosine);
-    float bottomRightTransformedY = (midX * sine) + (-midY * cosine);
+    return plane;
+}
 
-    float miny = min(topLeftTransformedY, min(topRightTransformedY, min(bottomLeftTransformedY, bottomRightTransformedY)));
-    float maxy = max(topLeftTransformedY, max(topRightTransformedY, max(bottomLeftTransformedY, bottomRightTransformedY)));
+/**
+ * Scales this plane to the given size
+ *
+ * @param width The new width
+ * @param height The new height
+ * @param filter The filter to sample with
+ * @return The scaled plane, interleaved
+ * @throws invalid_argument If either plane is empty
+ */
+RGBPlane RGBPlane::resize(int width, int height, resample::Filter filter) const
+{
+    if (width <= 0 || height <= 0)
+    {
+        throw invalid_argument("Width and height of a resized plane must be positive");
+    }
+
+    if (m_layout != INTERLEAVED)
+    {
+        return toLayout(INTERLEAVED).resize(width, height, filter);
+    }
+
+    RGBPlane plane(width, height);
+
+    resample::resize(*this, plane, filter);
+
+    return plane;
+}
+
+/**
+ * Rotates the plane about its centre, growing it to the bounding box of the rotated plane. The corners the plane
+ * does not cover are black
+ *
+ * @param degrees The angle to turn it clockwise (as the image is seen, top row up)
+ * @param filter The filter to sample with
+ * @return The rotated plane
+ */
+RGBPlane RGBPlane::rotate(double degrees, resample::Filter filter) const
+{
+    trace::Scope scope("rotate");
+    double angle = degrees * (M_PI / 180.0);
+    double sine = sin(angle);
+    double cosine = cos(angle);
+
+    // The bounding box, less a hair so that exact quarter turns do not gain a pixel from rounding
+    int outWidth = (int) ceil(fabs(m_width * cosine) + fabs(m_height * sine) - 1e-6);
+    int outHeight = (int) ceil(fabs(m_width * sine) + fabs(m_height * cosine) - 1e-6);
+
+    // Rows are stored bottom up, so a clockwise turn as seen is clockwise in storage space too (y up, x right), and
+    // the map back from the new plane to this one is the counter-clockwise turn about the centres of both
+    double midX = m_width / 2.0;
+    double midY = m_height / 2.0;
+    double outMidX = outWidth / 2.0;
+    double outMidY = outHeight / 2.0;
+    double matrix[6] = {cosine, -sine, midX - cosine * outMidX + sine * outMidY,
+                        sine, cosine, midY - sine * outMidX - cosine * outMidY};
+
+    return warpAffine(outWidth, outHeight, matrix, filter);
+}
 
-    int outWidth = (int) ceil(fabs(maxx) + fabs(minx));
-    int outHeight = (int) ceil(fabs(maxy) + fabs(miny));
+/**
+ * Rotates the plane 45 degrees clockwise with bilinear filtering, growing it to fit, see RGBPlane::rotate(double,
+ * resample::Filter)
+ *
+ * @return The rotated plane
+ */
+RGBPlane RGBPlane::rotate() const
+{
+    return rotate(45, resample::BILINEAR);
+}
 
-    RGBPlane* newPlane = new RGBPlane(outWidth, outHeight);
+/**
+ * Gets how the channels of this plane are laid out
+ * @return The layout
+ */
+RGBPlane::Layout RGBPlane::getLayout() const
+{
+    return m_layout;
+}
 
-    for (int x = 0; x < outWidth; x++)
+/**
+ * Gets the distance in bytes between the starts of two consecutive rows: of RGB triplets for an interleaved plane, of
+ * one channel (padded) for a planar one
+ *
+ * @return The row stride
+ */
+long long RGBPlane::getStride() const
+{
+    return m_stride;
+}
+
+/**
+ * Makes a copy of this plane in the given layout
+ *
+ * @param layout The layout of the copy
+ * @return The copy, which owns its pixels
+ */
+RGBPlane RGBPlane::toLayout(Layout layout) const
+{
+    if (layout == m_layout)
+    {
+        return clone();
+    }
+
+    RGBPlane plane(m_width, m_height, layout);
+
+    plane.copyRegionFrom(*this, 0, 0, m_width, m_height, 0, 0);
+
+    return plane;
+}
+
+/**
+ * Calculates the sum of squared differences between a run of pixels of this plane and a run of another, over every
+ * channel. Either plane may be in either layout. Unchecked, as it is meant for inner loops; all coordinates are in
+ * storage space
+ *
+ * @param x The x value of the first pixel of the run in this plane
+ * @param y The row of the run in this plane
+ * @param other The other plane
+ * @param otherX The x value of the first pixel of the run in the other plane
+ * @param otherY The row of the run in the other plane
+ * @param count The number of pixels in each run
+ * @return The summed squared difference
+ */
+long long RGBPlane::getRowError(int x, int y, const RGBPlane& other, int otherX, int otherY, int count) const
+{
+    if (m_layout == INTERLEAVED && other.m_layout == INTERLEAVED)
     {
-        for (int y = 0; y < outHeight; y++)
+        return ssd::rowError(getPixel(x, y), other.getPixel(otherX, otherY), count * 3);
+    }
+
+    if (m_layout == PLANAR && other.m_layout == PLANAR)
+    {
+        const unsigned char* a[3];
+        const unsigned char* b[3];
+
+        for (int c = 0; c < 3; c++)
         {
-            float error = 0.858; // I'm not sure why I need this but the transform is slightly off without it
-            float srcX = ((cosine * (x - midX)) - (sine * (y - midY))) + (midX / 2) * error;
-            float srcY = ((sine * (x - midX)) + (cosine * (y - midY))) + midY;
+            a[c] = getChannelRow(c, y) + x;
+            b[c] = other.getChannelRow(c, otherY) + otherX;
+        }
 
-            if (srcX >= 0 && srcX < m_width && srcY >= 0 && srcY < m_height)
-            {
-                vector<unsigned char> pixel = getPixelValueAt(srcX, srcY, true);
+        return ssd::planarRowError(a, b, count);
+    }
 
-                newPlane->setPixelValueAt(x, y, pixel[0], pixel[1], pixel[2], true);
-            }
+    long long total = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            int diff = getSample(x + i, y, c) - other.getSample(otherX + i, otherY, c);
+            total += diff * diff;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * Calculates the squared difference of every pixel of a run of this plane against a run of another (summed over the
+ * channels), as fills a row of the error plane of a patch. Either plane may be in either layout. Unchecked, see
+ * RGBPlane::getRowError
+ *
+ * @param x The x value of the first pixel of the run in this plane
+ * @param y The row of the run in this plane
+ * @param other The other plane
+ * @param otherX The x value of the first pixel of the run in the other plane
+ * @param otherY The row of the run in the other plane
+ * @param count The number of pixels in each run
+ * @param errors Filled with the squared difference of each pixel
+ * @return The sum of the errors
+ */
+long long RGBPlane::getPixelErrors(int x, int y, const RGBPlane& other, int otherX, int otherY, int count,
+                                   int* errors) const
+{
+    if (m_layout == INTERLEAVED && other.m_layout == INTERLEAVED)
+    {
+        return ssd::pixelErrors(getPixel(x, y), other.getPixel(otherX, otherY), count, errors);
+    }
+
+    if (m_layout == PLANAR && other.m_layout == PLANAR)
+    {
+        const unsigned char* a[3];
+        const unsigned char* b[3];
+
+        for (int c = 0; c < 3; c++)
+        {
+            a[c] = getChannelRow(c, y) + x;
+            b[c] = other.getChannelRow(c, otherY) + otherX;
+        }
+
+        return ssd::planarPixelErrors(a, b, count, errors);
+    }
+
+    long long total = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        errors[i] = 0;
+
+        for (int c = 0; c < 3; c++)
+        {
+            int diff = getSample(x + i, y, c) - other.getSample(otherX + i, otherY, c);
+            errors[i] += diff * diff;
         }
+
+        total += errors[i];
     }
 
-    return newPlane;
+    return total;
 }
@@ -1,39 +1,167 @@
 /**
  * The RGBPlane class represents an XY plane of RGB values for a pixel plane.
  *
+ * A plane owns its pixels (unless they are borrowed from a mapping or an arena), so it can be moved but not copied;
+ * a deep copy has to be asked for with clone.
+ *
+ * The pixels are interleaved (R, G, B of each pixel together) unless the plane is made PLANAR, in which case each
+ * channel is a plane of its own, with rows padded to PLANAR_ALIGNMENT bytes so every channel row starts aligned. That
+ * lets per-channel kernels run at full vector width without shuffling. Bitmaps, tiles and the resample kernels are
+ * interleaved; the planar layout is a working layout for synthesis, converted to and from with toLayout.
+ *
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 02/25/17
+ * @version 1.1 - 04/08/17 - Affine warps, resizes and rotations through the resample kernels
+ * @version 1.2 - 04/09/17 - Planar layout
  */
 
 #ifndef WANGTILE_RGBPLANE_H
 #define WANGTILE_RGBPLANE_H
 
+#include <cassert>
 #include <vector>
+#include "Arena.h"
+#include "Resample.h"
 
 using namespace std;
 
 class RGBPlane
 {
+public:
+    /**
+     * How the channels of the pixels are laid out in memory
+     */
+    enum Layout
+    {
+        INTERLEAVED,    // R, G, B of each pixel together, rows packed
+        PLANAR          // All the R values, then all the G values, then all the B values, rows padded
+    };
+
+    const static int PLANAR_ALIGNMENT = 32;
+
 private:
     unsigned char* m_pixelData;
+    unsigned char* m_allocation;
     int m_width;
     int m_height;
+    bool m_ownsPixels;
+    Layout m_layout;
+    long long m_stride;
+    long long m_channelSize;
 
-    int getIndexFromPoint(int, int);
+    long long getIndexFromPoint(int, int);
+    void allocate(Arena*);
 
 public:
     RGBPlane(int, int);
-    RGBPlane(const RGBPlane&);
+    RGBPlane(int, int, Layout);
+    RGBPlane(int, int, unsigned char*);
+    RGBPlane(int, int, Arena&);
+    RGBPlane(int, int, Arena&, Layout);
+    RGBPlane(const RGBPlane&) = delete;
+    RGBPlane(RGBPlane&&);
+    RGBPlane& operator=(const RGBPlane&) = delete;
+    RGBPlane& operator=(RGBPlane&&);
+    RGBPlane clone() const;
     vector<unsigned char> getPixelValueAt(int, int, bool);
-    unsigned char getValueAt(int);
+    const unsigned char* getPixelAt(int, int, bool) const;
+    unsigned char getValueAt(long long);
     void setPixelValueAt(int, int, unsigned char, unsigned char, unsigned char, bool);
-    RGBPlane* getRegion(int, int, int, int, bool);
+    RGBPlane getRegion(int, int, int, int, bool) const;
+    void copyRegionFrom(const RGBPlane&, int, int, int, int, int, int);
     void flipRBValues();
     void setDimensions(int, int);
     int getWidth() const;
     int getHeight() const;
     unsigned char* getRawData();
-    RGBPlane* rotate();
+    const unsigned char* getRawData() const;
+    RGBPlane warpAffine(int, int, const double*, resample::Filter) const;
+    RGBPlane resize(int, int, resample::Filter) const;
+    RGBPlane rotate(double, resample::Filter) const;
+    RGBPlane rotate() const;
+    Layout getLayout() const;
+    long long getStride() const;
+    RGBPlane toLayout(Layout) const;
+    long long getRowError(int, int, const RGBPlane&, int, int, int) const;
+    long long getPixelErrors(int, int, const RGBPlane&, int, int, int, int*) const;
+
+    /**
+     * Unchecked access to the start of a row of RGB triplets of an INTERLEAVED plane. For use in inner loops, where the
+     * bounds are already known to be valid. No flipping is done, y is in the storage space of the plane. Only the layout
+     * is asserted, as the offsets are meaningless for a PLANAR plane
+     *
+     * @param y The row to get
+     * @return Pointer to the R value of the first pixel of the row (NOT A COPY)
+     */
+    unsigned char* getRow(int y)
+    {
+        assert(m_layout == INTERLEAVED);
+
+        return m_pixelData + 3LL * y * m_width;
+    }
+
+    const unsigned char* getRow(int y) const
+    {
+        assert(m_layout == INTERLEAVED);
+
+        return m_pixelData + 3LL * y * m_width;
+    }
+
+    /**
+     * Unchecked access to the RGB triplet of a single pixel, see RGBPlane::getRow(int)
+     *
+     * @param x The x value of the pixel
+     * @param y The y value of the pixel
+     * @return Pointer to the R value of the pixel (NOT A COPY)
+     */
+    unsigned char* getPixel(int x, int y)
+    {
+        assert(m_layout == INTERLEAVED);
+
+        return m_pixelData + 3 * ((long long) y * m_width + x);
+    }
+
+    const unsigned char* getPixel(int x, int y) const
+    {
+        assert(m_layout == INTERLEAVED);
+
+        return m_pixelData + 3 * ((long long) y * m_width + x);
+    }
+
+    /**
+     * Unchecked access to the start of a row of one channel of a PLANAR plane, see RGBPlane::getRow(int)
+     *
+     * @param channel The channel (0 for R, 1 for G, 2 for B)
+     * @param y The row to get
+     * @return Pointer to the value of the channel of the first pixel of the row (NOT A COPY)
+     */
+    unsigned char* getChannelRow(int channel, int y)
+    {
+        assert(m_layout == PLANAR);
+
+        return m_pixelData + channel * m_channelSize + y * m_stride;
+    }
+
+    const unsigned char* getChannelRow(int channel, int y) const
+    {
+        assert(m_layout == PLANAR);
+
+        return m_pixelData + channel * m_channelSize + y * m_stride;
+    }
+
+    /**
+     * Unchecked access to one channel of a single pixel, in either layout. No flipping is done
+     *
+     * @param x The x value of the pixel
+     * @param y The y value of the pixel
+     * @param channel The channel (0 for R, 1 for G, 2 for B)
+     * @return The value of the channel
+     */
+    unsigned char getSample(int x, int y, int channel) const
+    {
+        return m_layout == PLANAR ? m_pixelData[channel * m_channelSize + y * m_stride + x]
+                                  : m_pixelData[y * m_stride + x * 3 + channel];
+    }
 
     virtual ~RGBPlane();
 };
@@ -0,0 +1,548 @@
+/**
+ * Houses the resampling kernels behind the affine warps and resizes of RGBPlane. Nearest, bilinear and bicubic
+ * (Catmull-Rom) filters are available, working directly on packed 8 bit RGB. Eight target pixels are worked on at a
+ * time with AVX2 gathers where the CPU has them, and plain C++ elsewhere, chosen the first time they are called. Both
+ * give the same pixels.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/08/17
+ * @version 1.1 - 04/12/17 - Implementations can be listed and chosen, to check them against each other
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Resample.h"
+#include "RGBPlane.h"
+#include "Trace.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define WANGTILE_RESAMPLE_X86
+#include <immintrin.h>
+#endif
+
+namespace resample
+{
+    /**
+     * The pixels being sampled, and one row of the target being filled. Coordinates are in the storage space of the
+     * source, with pixel i covering [i, i + 1), and advance by (stepX, stepY) from one target pixel to the next
+     */
+    struct Span
+    {
+        const unsigned char* pixels;
+        int width;
+        int height;
+        float x;
+        float y;
+        float stepX;
+        float stepY;
+    };
+
+    typedef void (*RowFunction)(const Span&, int, unsigned char*, Filter);
+
+    /**
+     * Fills the weights of the taps of a filter, for a sample the given fraction of a pixel past its first tap (or
+     * past the second, for bicubic)
+     *
+     * @param taps The number of taps per axis, 2 or 4
+     * @param t The fraction
+     * @param weights Filled with the weight of each tap
+     */
+    static void getWeights(int taps, float t, float* weights)
+    {
+        if (taps == 2)
+        {
+            weights[0] = 1.0f - t;
+            weights[1] = t;
+        }
+        else
+        {
+            weights[0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+            weights[1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+            weights[2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+            weights[3] = (0.5f * t - 0.5f) * t * t;
+        }
+    }
+
+    /**
+     * Resamples the target pixels [first, last) of a row one at a time. Target pixels landing outside the source are
+     * black, and taps past its edges take the edge pixels
+     *
+     * @param span The source, and where the row lands on it
+     * @param first The first target pixel to fill
+     * @param last One past the last target pixel to fill
+     * @param row The row of the target, which pixel first onwards is written to
+     * @param filter The filter to sample with
+     */
+    static void sampleRowScalar(const Span& span, int first, int last, unsigned char* row, Filter filter)
+    {
+        int taps = filter == BICUBIC ? 4 : 2;
+
+        for (int i = first; i < last; i++)
+        {
+            float x = span.x + (float) i * span.stepX;
+            float y = span.y + (float) i * span.stepY;
+            unsigned char* target = row + 3 * i;
+
+            if (!(x >= 0.0f && x < (float) span.width && y >= 0.0f && y < (float) span.height))
+            {
+                target[0] = target[1] = target[2] = 0;
+                continue;
+            }
+
+            if (filter == NEAREST)
+            {
+                int sourceX = min((int) x, span.width - 1);
+                int sourceY = min((int) y, span.height - 1);
+
+                memcpy(target, span.pixels + 3 * ((long long) sourceY * span.width + sourceX), 3);
+                continue;
+            }
+
+            // Taps sit on pixel centres, so the first is the one at or left of the sample, less one more for bicubic
+            float fx = x - 0.5f;
+            float fy = y - 0.5f;
+            float floorX = floorf(fx);
+            float floorY = floorf(fy);
+            int startX = (int) floorX - (taps / 2 - 1);
+            int startY = (int) floorY - (taps / 2 - 1);
+            float weightsX[4];
+            float weightsY[4];
+            float sums[3] = {0.0f, 0.0f, 0.0f};
+
+            getWeights(taps, fx - floorX, weightsX);
+            getWeights(taps, fy - floorY, weightsY);
+
+            for (int j = 0; j < taps; j++)
+            {
+                int sourceY = min(max(startY + j, 0), span.height - 1);
+                const unsigned char* sourceRow = span.pixels + 3LL * sourceY * span.width;
+                float rowSums[3] = {0.0f, 0.0f, 0.0f};
+
+                for (int k = 0; k < taps; k++)
+                {
+                    const unsigned char* pixel = sourceRow + 3 * min(max(startX + k, 0), span.width - 1);
+
+                    rowSums[0] = rowSums[0] + weightsX[k] * (float) pixel[0];
+                    rowSums[1] = rowSums[1] + weightsX[k] * (float) pixel[1];
+                    rowSums[2] = rowSums[2] + weightsX[k] * (float) pixel[2];
+                }
+
+                sums[0] = sums[0] + weightsY[j] * rowSums[0];
+                sums[1] = sums[1] + weightsY[j] * rowSums[1];
+                sums[2] = sums[2] + weightsY[j] * rowSums[2];
+            }
+
+            // Bicubic overshoots at hard edges, so the sums are clamped before rounding
+            for (int c = 0; c < 3; c++)
+            {
+                target[c] = (unsigned char) (int) (min(255.0f, max(0.0f, sums[c])) + 0.5f);
+            }
+        }
+    }
+
+    static void sampleRowPortable(const Span& span, int count, unsigned char* row, Filter filter)
+    {
+        sampleRowScalar(span, 0, count, row, filter);
+    }
+
+#ifdef WANGTILE_RESAMPLE_X86
+    /**
+     * Gathers one tap of eight target pixels. Each gather reads a 4 byte word, so the byte after the pixel must be
+     * within the source (the caller makes sure no tap is its very last pixel)
+     */
+    __attribute__((target("avx2")))
+    static inline void gatherTap(const unsigned char* pixels, __m256i offsets, __m256 weight, __m256* sums)
+    {
+        __m256i mask = _mm256_set1_epi32(0xFF);
+        __m256i word = _mm256_i32gather_epi32((const int*) pixels, offsets, 1);
+
+        sums[0] = _mm256_add_ps(sums[0], _mm256_mul_ps(weight, _mm256_cvtepi32_ps(_mm256_and_si256(word, mask))));
+        sums[1] = _mm256_add_ps(sums[1], _mm256_mul_ps(weight,
+                                _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(word, 8), mask))));
+        sums[2] = _mm256_add_ps(sums[2], _mm256_mul_ps(weight,
+                                _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(word, 16), mask))));
+    }
+
+    /**
+     * The weights of getWeights, for eight fractions at once, with the very same arithmetic so both give equal pixels
+     */
+    __attribute__((target("avx2")))
+    static inline void getWeightsAVX2(int taps, __m256 t, __m256* weights)
+    {
+        __m256 one = _mm256_set1_ps(1.0f);
+
+        if (taps == 2)
+        {
+            weights[0] = _mm256_sub_ps(one, t);
+            weights[1] = t;
+        }
+        else
+        {
+            __m256 a = _mm256_mul_ps(_mm256_set1_ps(-0.5f), t);
+            __m256 b = _mm256_mul_ps(_mm256_set1_ps(1.5f), t);
+            __m256 c = _mm256_mul_ps(_mm256_set1_ps(-1.5f), t);
+            __m256 d = _mm256_mul_ps(_mm256_set1_ps(0.5f), t);
+
+            a = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(a, one), t), _mm256_set1_ps(0.5f));
+            b = _mm256_mul_ps(_mm256_sub_ps(b, _mm256_set1_ps(2.5f)), t);
+            c = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(c, _mm256_set1_ps(2.0f)), t), _mm256_set1_ps(0.5f));
+            d = _mm256_mul_ps(_mm256_sub_ps(d, _mm256_set1_ps(0.5f)), t);
+
+            weights[0] = _mm256_mul_ps(a, t);
+            weights[1] = _mm256_add_ps(_mm256_mul_ps(b, t), one);
+            weights[2] = _mm256_mul_ps(c, t);
+            weights[3] = _mm256_mul_ps(d, t);
+        }
+    }
+
+    /**
+     * Resamples a row eight target pixels at a time: the coordinates, tap positions and weights of all eight are
+     * worked out together, and each tap is a single gather. Groups that touch the last pixel of the source, and the
+     * leftover pixels of the row, go through sampleRowScalar.
+     *
+     * @param span The source, and where the row lands on it
+     * @param count The number of pixels in the row
+     * @param row The row of the target
+     * @param filter The filter to sample with
+     */
+    __attribute__((target("avx2")))
+    static void sampleRowAVX2(const Span& span, int count, unsigned char* row, Filter filter)
+    {
+        int taps = filter == BICUBIC ? 4 : 2;
+        __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 width = _mm256_set1_ps((float) span.width);
+        __m256 height = _mm256_set1_ps((float) span.height);
+        __m256i maxX = _mm256_set1_epi32(span.width - 1);
+        __m256i maxY = _mm256_set1_epi32(span.height - 1);
+        __m256i zeroInt = _mm256_setzero_si256();
+        __m256i stride = _mm256_set1_epi32(3 * span.width);
+        __m256i three = _mm256_set1_epi32(3);
+        __m256i limit = _mm256_set1_epi32(3 * span.width * span.height - 4);
+        __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        int i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 index = _mm256_add_ps(_mm256_set1_ps((float) i), lanes);
+            __m256 x = _mm256_add_ps(_mm256_set1_ps(span.x), _mm256_mul_ps(index, _mm256_set1_ps(span.stepX)));
+            __m256 y = _mm256_add_ps(_mm256_set1_ps(span.y), _mm256_mul_ps(index, _mm256_set1_ps(span.stepY)));
+            __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GE_OQ),
+                                                        _mm256_cmp_ps(x, width, _CMP_LT_OQ)),
+                                          _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_GE_OQ),
+                                                        _mm256_cmp_ps(y, height, _CMP_LT_OQ)));
+
+            if (_mm256_movemask_ps(inside) == 0)
+            {
+                memset(row + 3 * i, 0, 24);
+                continue;
+            }
+
+            // Pixels outside the source are sampled at its origin, and blacked out afterwards
+            x = _mm256_and_ps(x, inside);
+            y = _mm256_and_ps(y, inside);
+
+            __m256 sums[3];
+            __m256i result;
+
+            if (filter == NEAREST)
+            {
+                __m256i sourceX = _mm256_min_epi32(_mm256_cvttps_epi32(x), maxX);
+                __m256i sourceY = _mm256_min_epi32(_mm256_cvttps_epi32(y), maxY);
+                __m256i offsets = _mm256_add_epi32(_mm256_mullo_epi32(sourceY, stride),
+                                                   _mm256_mullo_epi32(sourceX, three));
+
+                if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(offsets, limit)) != 0)
+                {
+                    sampleRowScalar(span, i, i + 8, row, filter);
+                    continue;
+                }
+
+                result = _mm256_and_si256(_mm256_i32gather_epi32((const int*) span.pixels, offsets, 1),
+                                          _mm256_set1_epi32(0xFFFFFF));
+            }
+            else
+            {
+                __m256 fx = _mm256_sub_ps(x, half);
+                __m256 fy = _mm256_sub_ps(y, half);
+                __m256 floorX = _mm256_floor_ps(fx);
+                __m256 floorY = _mm256_floor_ps(fy);
+                __m256i back = _mm256_set1_epi32(taps / 2 - 1);
+                __m256i startX = _mm256_sub_epi32(_mm256_cvttps_epi32(floorX), back);
+                __m256i startY = _mm256_sub_epi32(_mm256_cvttps_epi32(floorY), back);
+                __m256i columns[4];
+                __m256i rows[4];
+                __m256 weightsX[4];
+                __m256 weightsY[4];
+
+                for (int k = 0; k < taps; k++)
+                {
+                    __m256i step = _mm256_set1_epi32(k);
+
+                    columns[k] = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(startX, step),
+                                                    zeroInt), maxX), three);
+                    rows[k] = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(startY, step),
+                                                 zeroInt), maxY), stride);
+                }
+
+                // The last tap of each axis is the furthest into the source
+                if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(_mm256_add_epi32(rows[taps - 1], columns[taps - 1]),
+                                                            limit)) != 0)
+                {
+                    sampleRowScalar(span, i, i + 8, row, filter);
+                    continue;
+                }
+
+                getWeightsAVX2(taps, _mm256_sub_ps(fx, floorX), weightsX);
+                getWeightsAVX2(taps, _mm256_sub_ps(fy, floorY), weightsY);
+                sums[0] = sums[1] = sums[2] = zero;
+
+                for (int j = 0; j < taps; j++)
+                {
+                    __m256 rowSums[3] = {zero, zero, zero};
+
+                    for (int k = 0; k < taps; k++)
+                    {
+                        gatherTap(span.pixels, _mm256_add_epi32(rows[j], columns[k]), weightsX[k], rowSums);
+                    }
+
+                    for (int c = 0; c < 3; c++)
+                    {
+                        sums[c] = _mm256_add_ps(sums[c], _mm256_mul_ps(weightsY[j], rowSums[c]));
+                    }
+                }
+
+                __m256 top = _mm256_set1_ps(255.0f);
+                __m256i channels[3];
+
+                for (int c = 0; c < 3; c++)
+                {
+                    channels[c] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_min_ps(top, _mm256_max_ps(zero, sums[c])),
+                                                                    half));
+                }
+
+                result = _mm256_or_si256(channels[0], _mm256_or_si256(_mm256_slli_epi32(channels[1], 8),
+                                                                      _mm256_slli_epi32(channels[2], 16)));
+            }
+
+            // Blacks out the pixels outside the source, and packs the eight RGB triplets into 24 bytes
+            result = _mm256_shuffle_epi8(_mm256_and_si256(result, _mm256_castps_si256(inside)), pack);
+
+            unsigned char packed[32];
+
+            _mm256_storeu_si256((__m256i*) packed, result);
+            memcpy(row + 3 * i, packed, 12);
+            memcpy(row + 3 * i + 12, packed + 16, 12);
+        }
+
+        // The leftover pixels run legacy SSE code, which stalls while the upper halves are still dirty
+        _mm256_zeroupper();
+        sampleRowScalar(span, i, count, row, filter);
+    }
+#endif
+
+    /**
+     * The row kernel of one implementation, and its name
+     */
+    struct Kernel
+    {
+        RowFunction row;
+        const char* name;
+    };
+
+    static const Kernel SCALAR = {&sampleRowPortable, "scalar"};
+
+#ifdef WANGTILE_RESAMPLE_X86
+    static const Kernel AVX2 = {&sampleRowAVX2, "avx2"};
+#endif
+
+    /**
+     * Finds the implementations the running CPU supports
+     * @return The implementations, fastest first
+     */
+    static vector<const Kernel*> getSupported()
+    {
+        vector<const Kernel*> supported;
+
+#ifdef WANGTILE_RESAMPLE_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+        {
+            supported.push_back(&AVX2);
+        }
+#endif
+
+        supported.push_back(&SCALAR);
+
+        return supported;
+    }
+
+    /**
+     * Gets the implementation in use, which is the fastest the CPU supports until setImplementation says otherwise
+     * @return The implementation
+     */
+    static atomic<const Kernel*>& getKernel()
+    {
+        static atomic<const Kernel*> kernel(getSupported()[0]);
+
+        return kernel;
+    }
+
+    /**
+     * Resamples the source into the target through an affine map. For each target pixel, the map takes its centre to
+     * the point of the source it is sampled at:
+     *
+     * sourceX = m[0] * x + m[1] * y + m[2]
+     * sourceY = m[3] * x + m[4] * y + m[5]
+     *
+     * Both are in the storage space of the planes (no flipping), with pixel i covering [i, i + 1), so the centre of
+     * target pixel (x, y) is (x + 0.5, y + 0.5). Target pixels landing outside the source are black, and filter taps
+     * past its edges take the edge pixels.
+     *
+     * @param source The plane to sample
+     * @param target The plane to fill, whose size is the size of the output
+     * @param matrix The six coefficients of the map, from target to source
+     * @param filter The filter to sample with
+     * @throws invalid_argument If the source is empty, either plane is not interleaved, or the source is too large for
+     *                          the 32 bit offsets of the gathers
+     */
+    void warpAffine(const RGBPlane& source, RGBPlane& target, const double* matrix, Filter filter)
+    {
+        trace::Scope scope("resample");
+
+        if (source.getWidth() <= 0 || source.getHeight() <= 0)
+        {
+            throw invalid_argument("Cannot resample an empty plane");
+        }
+
+        if (source.getLayout() != RGBPlane::INTERLEAVED || target.getLayout() != RGBPlane::INTERLEAVED)
+        {
+            throw invalid_argument("Only interleaved planes can be resampled");
+        }
+
+        if (3LL * source.getWidth() * source.getHeight() > INT_MAX)
+        {
+            throw invalid_argument("Plane is too large to resample");
+        }
+
+        RowFunction function = getKernel().load(memory_order_relaxed)->row;
+        Span span;
+
+        span.pixels = source.getRawData();
+        span.width = source.getWidth();
+        span.height = source.getHeight();
+        span.stepX = (float) matrix[0];
+        span.stepY = (float) matrix[3];
+
+        for (int y = 0; y < target.getHeight(); y++)
+        {
+            span.x = (float) (matrix[0] * 0.5 + matrix[1] * (y + 0.5) + matrix[2]);
+            span.y = (float) (matrix[3] * 0.5 + matrix[4] * (y + 0.5) + matrix[5]);
+            function(span, target.getWidth(), target.getRow(y), filter);
+        }
+    }
+
+    /**
+     * Resamples the source to the size of the target, stretching it to fit. The filters only look at the pixels
+     * around each sample, so shrinking by more than half skips some of the source rather than averaging it
+     *
+     * @param source The plane to sample
+     * @param target The plane to fill
+     * @param filter The filter to sample with
+     * @throws invalid_argument If either plane is empty, or the source is too large to resample
+     */
+    void resize(const RGBPlane& source, RGBPlane& target, Filter filter)
+    {
+        if (target.getWidth() <= 0 || target.getHeight() <= 0)
+        {
+            throw invalid_argument("Cannot resample to an empty plane");
+        }
+
+        double scaleX = (double) source.getWidth() / target.getWidth();
+        double scaleY = (double) source.getHeight() / target.getHeight();
+        double matrix[6] = {scaleX, 0, 0, 0, scaleY, 0};
+
+        warpAffine(source, target, matrix, filter);
+    }
+
+    /**
+     * Gets the filter of the given name
+     *
+     * @param name nearest, bilinear or bicubic
+     * @return The filter
+     * @throws invalid_argument If there is no filter of that name
+     */
+    Filter parseFilter(const string& name)
+    {
+        if (name == "nearest")
+        {
+            return NEAREST;
+        }
+
+        if (name == "bilinear")
+        {
+            return BILINEAR;
+        }
+
+        if (name == "bicubic")
+        {
+            return BICUBIC;
+        }
+
+        throw invalid_argument("Unknown filter " + name + ", must be nearest, bilinear or bicubic");
+    }
+
+    /**
+     * Gets the name of the implementation in use (avx2 or scalar)
+     * @return The name
+     */
+    string getImplementation()
+    {
+        return getKernel().load()->name;
+    }
+
+    /**
+     * Gets the names of the implementations the running CPU supports, so that they can be checked against each other
+     * @return The names, fastest first
+     */
+    vector<string> getImplementations()
+    {
+        vector<string> names;
+
+        for (const Kernel* kernel : getSupported())
+        {
+            names.push_back(kernel->name);
+        }
+
+        return names;
+    }
+
+    /**
+     * Uses the given implementation for every resample from now on, rather than the fastest the CPU supports. Meant
+     * for tests and benchmarks: resamples already running in other threads may finish with the old implementation
+     *
+     * @param name The name of the implementation, one of getImplementations
+     * @throws invalid_argument If the CPU does not support the implementation
+     */
+    void setImplementation(const string& name)
+    {
+        for (const Kernel* kernel : getSupported())
+        {
+            if (name == kernel->name)
+            {
+                getKernel().store(kernel);
+                return;
+            }
+        }
+
+        throw invalid_argument("Resample implementation is not supported: " + name);
+    }
+}
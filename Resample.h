@@ -0,0 +1,42 @@
+/**
+ * Houses the resampling kernels behind the affine warps and resizes of RGBPlane. Nearest, bilinear and bicubic
+ * (Catmull-Rom) filters are available, working directly on packed 8 bit RGB. Eight target pixels are worked on at a
+ * time with AVX2 gathers where the CPU has them, and plain C++ elsewhere, chosen the first time they are called. Both
+ * give the same pixels.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/08/17
+ * @version 1.1 - 04/12/17 - Implementations can be listed and chosen, to check them against each other
+ */
+
+#ifndef WANGTILE_RESAMPLE_H
+#define WANGTILE_RESAMPLE_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class RGBPlane;
+
+namespace resample
+{
+    /**
+     * How a target pixel is made from the source pixels around where it lands
+     */
+    enum Filter
+    {
+        NEAREST,    // The source pixel it lands in
+        BILINEAR,   // The 2x2 source pixels around it, weighted by distance
+        BICUBIC     // The 4x4 source pixels around it, through a Catmull-Rom spline
+    };
+
+    void warpAffine(const RGBPlane&, RGBPlane&, const double*, Filter);
+    void resize(const RGBPlane&, RGBPlane&, Filter);
+    Filter parseFilter(const string&);
+    string getImplementation();
+    vector<string> getImplementations();
+    void setImplementation(const string&);
+};
+
+#endif //WANGTILE_RESAMPLE_H
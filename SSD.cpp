@@ -0,0 +1,660 @@
+/**
+ * Houses the sum of squared differences kernels that every overlap error in the synthesizer is built on. They work
+ * directly on rows of packed 8 bit RGB (or on the separate channel rows of planar planes), and the fastest
+ * implementation the CPU supports (AVX2, SSE2, or plain C++) is chosen the first time they are called.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/22/17
+ * @version 1.1 - 04/09/17 - Row and per-pixel errors of planar rows
+ * @version 1.2 - 04/10/17 - Vectorized per-pixel errors of packed rows
+ * @version 1.3 - 04/12/17 - Implementations can be listed and chosen, to check them against each other
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "SSD.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define WANGTILE_SSD_X86
+#include <immintrin.h>
+#endif
+
+namespace ssd
+{
+    typedef long long (*RowFunction)(const unsigned char*, const unsigned char*, int);
+    typedef long long (*PixelFunction)(const unsigned char*, const unsigned char*, int, int*);
+    typedef long long (*PlanarFunction)(const unsigned char* const*, const unsigned char* const*, int, int*);
+    typedef long long (*PlanarRowFunction)(const unsigned char* const*, const unsigned char* const*, int);
+
+    static long long rowErrorScalar(const unsigned char* a, const unsigned char* b, int count)
+    {
+        long long total = 0;
+
+        // A block of 32768 squared byte differences always fits in an int
+        for (int start = 0; start < count; start += 32768)
+        {
+            int end = min(count, start + 32768);
+            int sum = 0;
+
+            for (int i = start; i < end; i++)
+            {
+                int diff = a[i] - b[i];
+                sum += diff * diff;
+            }
+
+            total += sum;
+        }
+
+        return total;
+    }
+
+    static long long pixelErrorsScalar(const unsigned char* a, const unsigned char* b, int pixels, int* errors)
+    {
+        long long total = 0;
+
+        for (int i = 0; i < pixels; i++)
+        {
+            int red = a[i * 3] - b[i * 3];
+            int green = a[i * 3 + 1] - b[i * 3 + 1];
+            int blue = a[i * 3 + 2] - b[i * 3 + 2];
+
+            errors[i] = red * red + green * green + blue * blue;
+            total += errors[i];
+        }
+
+        return total;
+    }
+
+    static long long planarPixelErrorsScalar(const unsigned char* const* a, const unsigned char* const* b, int pixels,
+                                             int* errors)
+    {
+        long long total = 0;
+
+        for (int i = 0; i < pixels; i++)
+        {
+            int red = a[0][i] - b[0][i];
+            int green = a[1][i] - b[1][i];
+            int blue = a[2][i] - b[2][i];
+
+            errors[i] = red * red + green * green + blue * blue;
+            total += errors[i];
+        }
+
+        return total;
+    }
+
+    static long long planarRowErrorScalar(const unsigned char* const* a, const unsigned char* const* b, int pixels)
+    {
+        long long total = 0;
+
+        for (int i = 0; i < pixels; i++)
+        {
+            int red = a[0][i] - b[0][i];
+            int green = a[1][i] - b[1][i];
+            int blue = a[2][i] - b[2][i];
+
+            total += red * red + green * green + blue * blue;
+        }
+
+        return total;
+    }
+
+#ifdef WANGTILE_SSD_X86
+    // Each 32 bit lane gains at most 2 * 255^2 per step, so the lanes are widened to 64 bits every BLOCK_STEPS steps
+    static const int BLOCK_STEPS = 4096;
+
+    static long long rowErrorSSE2(const unsigned char* a, const unsigned char* b, int count)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i total = _mm_setzero_si128();
+        int i = 0;
+
+        while (count - i >= 16)
+        {
+            __m128i sum = _mm_setzero_si128();
+            int steps = min(BLOCK_STEPS, (count - i) / 16);
+
+            for (int s = 0; s < steps; s++, i += 16)
+            {
+                __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+                __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+                __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero));
+                __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero));
+
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(low, low));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(high, high));
+            }
+
+            total = _mm_add_epi64(total, _mm_unpacklo_epi32(sum, zero));
+            total = _mm_add_epi64(total, _mm_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, total);
+
+        return lanes[0] + lanes[1] + rowErrorScalar(a + i, b + i, count - i);
+    }
+
+    __attribute__((target("avx2")))
+    static long long rowErrorAVX2(const unsigned char* a, const unsigned char* b, int count)
+    {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i total = _mm256_setzero_si256();
+        int i = 0;
+
+        while (count - i >= 32)
+        {
+            __m256i sum = _mm256_setzero_si256();
+            int steps = min(BLOCK_STEPS / 2, (count - i) / 32);
+
+            for (int s = 0; s < steps; s++, i += 32)
+            {
+                __m128i x0 = _mm_loadu_si128((const __m128i*) (a + i));
+                __m128i x1 = _mm_loadu_si128((const __m128i*) (a + i + 16));
+                __m128i y0 = _mm_loadu_si128((const __m128i*) (b + i));
+                __m128i y1 = _mm_loadu_si128((const __m128i*) (b + i + 16));
+                __m256i low = _mm256_sub_epi16(_mm256_cvtepu8_epi16(x0), _mm256_cvtepu8_epi16(y0));
+                __m256i high = _mm256_sub_epi16(_mm256_cvtepu8_epi16(x1), _mm256_cvtepu8_epi16(y1));
+
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(low, low));
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(high, high));
+            }
+
+            total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(sum, zero));
+            total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, total);
+
+        // The tail runs legacy SSE code, which stalls on every instruction while the upper halves are still dirty. GCC
+        // does not clear them itself in a function only targeted at AVX2
+        _mm256_zeroupper();
+
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + rowErrorSSE2(a + i, b + i, count - i);
+    }
+
+    /**
+     * Splits 16 packed RGB pixels into their R, G and B bytes. SSE2 has no byte shuffle, so each round of unpacks
+     * interleaves the three thirds of the run with each other, and after four rounds each channel is gathered in order
+     *
+     * @param pixels The first of the 48 bytes of pixels
+     * @param channels Filled with the 16 R, G and B bytes
+     */
+    static inline void deinterleaveSSE2(const unsigned char* pixels, __m128i* channels)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*) pixels);
+        __m128i y = _mm_loadu_si128((const __m128i*) (pixels + 16));
+        __m128i z = _mm_loadu_si128((const __m128i*) (pixels + 32));
+
+        for (int round = 0; round < 4; round++)
+        {
+            __m128i nextX = _mm_unpacklo_epi8(x, _mm_unpackhi_epi64(y, y));
+            __m128i nextY = _mm_unpacklo_epi8(_mm_unpackhi_epi64(x, x), z);
+            __m128i nextZ = _mm_unpacklo_epi8(y, _mm_unpackhi_epi64(z, z));
+
+            x = nextX;
+            y = nextY;
+            z = nextZ;
+        }
+
+        channels[0] = x;
+        channels[1] = y;
+        channels[2] = z;
+    }
+
+    /**
+     * The per-pixel errors of 16 packed RGB pixels at a time, split into their channels and then scored as planar rows
+     * are. A pixel error is at most 3 * 255^2, and each lane of the sum gains four per step, so half of BLOCK_STEPS fit
+     */
+    static long long pixelErrorsSSE2(const unsigned char* a, const unsigned char* b, int pixels, int* errors)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i total = _mm_setzero_si128();
+        int i = 0;
+
+        while (pixels - i >= 16)
+        {
+            __m128i sum = _mm_setzero_si128();
+            int steps = min(BLOCK_STEPS / 2, (pixels - i) / 16);
+
+            for (int s = 0; s < steps; s++, i += 16)
+            {
+                __m128i x[3];
+                __m128i y[3];
+                __m128i errorsOf[4] = {zero, zero, zero, zero};
+
+                deinterleaveSSE2(a + i * 3, x);
+                deinterleaveSSE2(b + i * 3, y);
+
+                for (int c = 0; c < 3; c++)
+                {
+                    __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(x[c], zero), _mm_unpacklo_epi8(y[c], zero));
+                    __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(x[c], zero), _mm_unpackhi_epi8(y[c], zero));
+
+                    low = _mm_mullo_epi16(low, low);
+                    high = _mm_mullo_epi16(high, high);
+                    errorsOf[0] = _mm_add_epi32(errorsOf[0], _mm_unpacklo_epi16(low, zero));
+                    errorsOf[1] = _mm_add_epi32(errorsOf[1], _mm_unpackhi_epi16(low, zero));
+                    errorsOf[2] = _mm_add_epi32(errorsOf[2], _mm_unpacklo_epi16(high, zero));
+                    errorsOf[3] = _mm_add_epi32(errorsOf[3], _mm_unpackhi_epi16(high, zero));
+                }
+
+                for (int q = 0; q < 4; q++)
+                {
+                    _mm_storeu_si128((__m128i*) (errors + i + q * 4), errorsOf[q]);
+                    sum = _mm_add_epi32(sum, errorsOf[q]);
+                }
+            }
+
+            total = _mm_add_epi64(total, _mm_unpacklo_epi32(sum, zero));
+            total = _mm_add_epi64(total, _mm_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, total);
+
+        return lanes[0] + lanes[1] + pixelErrorsScalar(a + i * 3, b + i * 3, pixels - i, errors + i);
+    }
+
+    /**
+     * The AVX2 counterpart of pixelErrorsSSE2, whose 16 bit squares of each channel fill a whole register. Each lane of
+     * the sum gains two pixel errors per step, so BLOCK_STEPS steps fit
+     */
+    __attribute__((target("avx2")))
+    static long long pixelErrorsAVX2(const unsigned char* a, const unsigned char* b, int pixels, int* errors)
+    {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i total = _mm256_setzero_si256();
+        int i = 0;
+
+        while (pixels - i >= 16)
+        {
+            __m256i sum = _mm256_setzero_si256();
+            int steps = min(BLOCK_STEPS, (pixels - i) / 16);
+
+            for (int s = 0; s < steps; s++, i += 16)
+            {
+                __m128i x[3];
+                __m128i y[3];
+                __m256i low = _mm256_setzero_si256();
+                __m256i high = _mm256_setzero_si256();
+
+                deinterleaveSSE2(a + i * 3, x);
+                deinterleaveSSE2(b + i * 3, y);
+
+                for (int c = 0; c < 3; c++)
+                {
+                    __m256i diff = _mm256_sub_epi16(_mm256_cvtepu8_epi16(x[c]), _mm256_cvtepu8_epi16(y[c]));
+                    __m256i square = _mm256_mullo_epi16(diff, diff);
+
+                    low = _mm256_add_epi32(low, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(square)));
+                    high = _mm256_add_epi32(high, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(square, 1)));
+                }
+
+                _mm256_storeu_si256((__m256i*) (errors + i), low);
+                _mm256_storeu_si256((__m256i*) (errors + i + 8), high);
+                sum = _mm256_add_epi32(sum, _mm256_add_epi32(low, high));
+            }
+
+            total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(sum, zero));
+            total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, total);
+
+        // The tail runs legacy SSE code, which stalls while the upper halves are still dirty
+        _mm256_zeroupper();
+
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+               + pixelErrorsSSE2(a + i * 3, b + i * 3, pixels - i, errors + i);
+    }
+
+    /**
+     * The per-pixel errors of eight pixels of planar rows: each channel difference is squared in 16 bits (255^2 still
+     * fits unsigned), and the three squares are summed in 32. A pixel error is at most 3 * 255^2, and each lane of the
+     * sum gains two per step, so BLOCK_STEPS steps fit
+     */
+    static long long planarPixelErrorsSSE2(const unsigned char* const* a, const unsigned char* const* b, int pixels,
+                                           int* errors)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i total = _mm_setzero_si128();
+        int i = 0;
+
+        while (pixels - i >= 8)
+        {
+            __m128i sum = _mm_setzero_si128();
+            int steps = min(BLOCK_STEPS, (pixels - i) / 8);
+
+            for (int s = 0; s < steps; s++, i += 8)
+            {
+                __m128i low = _mm_setzero_si128();
+                __m128i high = _mm_setzero_si128();
+
+                for (int c = 0; c < 3; c++)
+                {
+                    __m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (a[c] + i)), zero);
+                    __m128i y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (b[c] + i)), zero);
+                    __m128i diff = _mm_sub_epi16(x, y);
+                    __m128i square = _mm_mullo_epi16(diff, diff);
+
+                    low = _mm_add_epi32(low, _mm_unpacklo_epi16(square, zero));
+                    high = _mm_add_epi32(high, _mm_unpackhi_epi16(square, zero));
+                }
+
+                _mm_storeu_si128((__m128i*) (errors + i), low);
+                _mm_storeu_si128((__m128i*) (errors + i + 4), high);
+                sum = _mm_add_epi32(sum, _mm_add_epi32(low, high));
+            }
+
+            total = _mm_add_epi64(total, _mm_unpacklo_epi32(sum, zero));
+            total = _mm_add_epi64(total, _mm_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, total);
+
+        const unsigned char* restA[3] = {a[0] + i, a[1] + i, a[2] + i};
+        const unsigned char* restB[3] = {b[0] + i, b[1] + i, b[2] + i};
+
+        return lanes[0] + lanes[1] + planarPixelErrorsScalar(restA, restB, pixels - i, errors + i);
+    }
+
+    __attribute__((target("avx2")))
+    static long long planarPixelErrorsAVX2(const unsigned char* const* a, const unsigned char* const* b, int pixels,
+                                           int* errors)
+    {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i total = _mm256_setzero_si256();
+        int i = 0;
+
+        while (pixels - i >= 16)
+        {
+            __m256i sum = _mm256_setzero_si256();
+            int steps = min(BLOCK_STEPS, (pixels - i) / 16);
+
+            for (int s = 0; s < steps; s++, i += 16)
+            {
+                __m256i low = _mm256_setzero_si256();
+                __m256i high = _mm256_setzero_si256();
+
+                for (int c = 0; c < 3; c++)
+                {
+                    __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (a[c] + i)));
+                    __m256i y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (b[c] + i)));
+                    __m256i diff = _mm256_sub_epi16(x, y);
+                    __m256i square = _mm256_mullo_epi16(diff, diff);
+
+                    low = _mm256_add_epi32(low, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(square)));
+                    high = _mm256_add_epi32(high, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(square, 1)));
+                }
+
+                _mm256_storeu_si256((__m256i*) (errors + i), low);
+                _mm256_storeu_si256((__m256i*) (errors + i + 8), high);
+                sum = _mm256_add_epi32(sum, _mm256_add_epi32(low, high));
+            }
+
+            total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(sum, zero));
+            total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, total);
+
+        const unsigned char* restA[3] = {a[0] + i, a[1] + i, a[2] + i};
+        const unsigned char* restB[3] = {b[0] + i, b[1] + i, b[2] + i};
+
+        _mm256_zeroupper();
+
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+               + planarPixelErrorsSSE2(restA, restB, pixels - i, errors + i);
+    }
+
+    /**
+     * The error of eight pixels of planar rows at a time, all three channels in the one pass so that short rows (the
+     * narrow side overlaps) are not left to three scalar tails
+     */
+    static long long planarRowErrorSSE2(const unsigned char* const* a, const unsigned char* const* b, int pixels)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i total = _mm_setzero_si128();
+        int i = 0;
+
+        while (pixels - i >= 8)
+        {
+            __m128i sum = _mm_setzero_si128();
+            int steps = min(BLOCK_STEPS, (pixels - i) / 8);
+
+            for (int s = 0; s < steps; s++, i += 8)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    __m128i x = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (a[c] + i)), zero);
+                    __m128i y = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (b[c] + i)), zero);
+                    __m128i diff = _mm_sub_epi16(x, y);
+
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(diff, diff));
+                }
+            }
+
+            total = _mm_add_epi64(total, _mm_unpacklo_epi32(sum, zero));
+            total = _mm_add_epi64(total, _mm_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, total);
+
+        const unsigned char* restA[3] = {a[0] + i, a[1] + i, a[2] + i};
+        const unsigned char* restB[3] = {b[0] + i, b[1] + i, b[2] + i};
+
+        return lanes[0] + lanes[1] + planarRowErrorScalar(restA, restB, pixels - i);
+    }
+
+    __attribute__((target("avx2")))
+    static long long planarRowErrorAVX2(const unsigned char* const* a, const unsigned char* const* b, int pixels)
+    {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i total = _mm256_setzero_si256();
+        int i = 0;
+
+        while (pixels - i >= 16)
+        {
+            __m256i sum = _mm256_setzero_si256();
+            int steps = min(BLOCK_STEPS, (pixels - i) / 16);
+
+            for (int s = 0; s < steps; s++, i += 16)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (a[c] + i)));
+                    __m256i y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (b[c] + i)));
+                    __m256i diff = _mm256_sub_epi16(x, y);
+
+                    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff, diff));
+                }
+            }
+
+            total = _mm256_add_epi64(total, _mm256_unpacklo_epi32(sum, zero));
+            total = _mm256_add_epi64(total, _mm256_unpackhi_epi32(sum, zero));
+        }
+
+        long long lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, total);
+
+        const unsigned char* restA[3] = {a[0] + i, a[1] + i, a[2] + i};
+        const unsigned char* restB[3] = {b[0] + i, b[1] + i, b[2] + i};
+
+        _mm256_zeroupper();
+
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + planarRowErrorSSE2(restA, restB, pixels - i);
+    }
+#endif
+
+    /**
+     * The kernels of one implementation, and its name
+     */
+    struct Kernels
+    {
+        RowFunction row;
+        PixelFunction pixel;
+        PlanarRowFunction planarRow;
+        PlanarFunction planar;
+        const char* name;
+    };
+
+    static const Kernels SCALAR = {&rowErrorScalar, &pixelErrorsScalar, &planarRowErrorScalar, &planarPixelErrorsScalar,
+                                   "scalar"};
+
+#ifdef WANGTILE_SSD_X86
+    static const Kernels SSE2 = {&rowErrorSSE2, &pixelErrorsSSE2, &planarRowErrorSSE2, &planarPixelErrorsSSE2, "sse2"};
+
+    static const Kernels AVX2 = {&rowErrorAVX2, &pixelErrorsAVX2, &planarRowErrorAVX2, &planarPixelErrorsAVX2, "avx2"};
+#endif
+
+    /**
+     * Finds the implementations the running CPU supports
+     * @return The implementations, fastest first
+     */
+    static vector<const Kernels*> getSupported()
+    {
+        vector<const Kernels*> supported;
+
+#ifdef WANGTILE_SSD_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+        {
+            supported.push_back(&AVX2);
+        }
+
+        if (__builtin_cpu_supports("sse2"))
+        {
+            supported.push_back(&SSE2);
+        }
+#endif
+
+        supported.push_back(&SCALAR);
+
+        return supported;
+    }
+
+    /**
+     * Gets the implementation in use, which is the fastest the CPU supports until setImplementation says otherwise
+     * @return The implementation
+     */
+    static atomic<const Kernels*>& getKernels()
+    {
+        static atomic<const Kernels*> kernels(getSupported()[0]);
+
+        return kernels;
+    }
+
+    /**
+     * Calculates the sum of squared differences between two runs of bytes, such as the overlapping parts of two rows of
+     * packed RGB pixels
+     *
+     * @param a The first run
+     * @param b The second run
+     * @param count The number of bytes in each run (3 per RGB pixel)
+     * @return The sum over every byte of the squared difference
+     */
+    long long rowError(const unsigned char* a, const unsigned char* b, int count)
+    {
+        return getKernels().load(memory_order_relaxed)->row(a, b, count);
+    }
+
+    /**
+     * Calculates the sum of squared differences between two rows of planar pixels, over all three channels: the
+     * counterpart of rowError for planes whose channels are held apart
+     *
+     * @param a The R, G and B rows of the first run
+     * @param b The R, G and B rows of the second run
+     * @param pixels The number of pixels in each row
+     * @return The sum over every pixel and channel of the squared difference
+     */
+    long long planarRowError(const unsigned char* const* a, const unsigned char* const* b, int pixels)
+    {
+        return getKernels().load(memory_order_relaxed)->planarRow(a, b, pixels);
+    }
+
+    /**
+     * Calculates the squared difference of every pixel of two rows of packed RGB pixels (summed over the channels), as
+     * is needed to fill the error plane of a patch
+     *
+     * @param a The first row
+     * @param b The second row
+     * @param pixels The number of pixels in each row
+     * @param errors Filled with the squared difference of each pixel
+     * @return The sum of the errors
+     */
+    long long pixelErrors(const unsigned char* a, const unsigned char* b, int pixels, int* errors)
+    {
+        return getKernels().load(memory_order_relaxed)->pixel(a, b, pixels, errors);
+    }
+
+    /**
+     * Calculates the squared difference of every pixel of two rows of planar pixels (summed over the channels), the
+     * counterpart of pixelErrors for planes whose channels are held apart. With no shuffling needed, this runs at full
+     * vector width
+     *
+     * @param a The R, G and B rows of the first run
+     * @param b The R, G and B rows of the second run
+     * @param pixels The number of pixels in each row
+     * @param errors Filled with the squared difference of each pixel
+     * @return The sum of the errors
+     */
+    long long planarPixelErrors(const unsigned char* const* a, const unsigned char* const* b, int pixels, int* errors)
+    {
+        return getKernels().load(memory_order_relaxed)->planar(a, b, pixels, errors);
+    }
+
+    /**
+     * Gets the name of the implementation in use (avx2, sse2 or scalar)
+     * @return The name
+     */
+    string getImplementation()
+    {
+        return getKernels().load()->name;
+    }
+
+    /**
+     * Gets the names of the implementations the running CPU supports, so that they can be checked against each other
+     * @return The names, fastest first
+     */
+    vector<string> getImplementations()
+    {
+        vector<string> names;
+
+        for (const Kernels* kernels : getSupported())
+        {
+            names.push_back(kernels->name);
+        }
+
+        return names;
+    }
+
+    /**
+     * Uses the given implementation for every kernel from now on, rather than the fastest the CPU supports. Meant for
+     * tests and benchmarks: kernels already running in other threads may finish with the old implementation
+     *
+     * @param name The name of the implementation, one of getImplementations
+     * @throws invalid_argument If the CPU does not support the implementation
+     */
+    void setImplementation(const string& name)
+    {
+        for (const Kernels* kernels : getSupported())
+        {
+            if (name == kernels->name)
+            {
+                getKernels().store(kernels);
+                return;
+            }
+        }
+
+        throw invalid_argument("SSD implementation is not supported: " + name);
+    }
+}
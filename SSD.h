@@ -0,0 +1,31 @@
+/**
+ * Houses the sum of squared differences kernels that every overlap error in the synthesizer is built on. They work
+ * directly on rows of packed 8 bit RGB (or on the separate channel rows of planar planes), and the fastest
+ * implementation the CPU supports (AVX2, SSE2, or plain C++) is chosen the first time they are called.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/22/17
+ * @version 1.1 - 04/09/17 - Row and per-pixel errors of planar rows
+ * @version 1.2 - 04/12/17 - Implementations can be listed and chosen, to check them against each other
+ */
+
+#ifndef WANGTILE_SSD_H
+#define WANGTILE_SSD_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace ssd
+{
+    long long rowError(const unsigned char*, const unsigned char*, int);
+    long long pixelErrors(const unsigned char*, const unsigned char*, int, int*);
+    long long planarRowError(const unsigned char* const*, const unsigned char* const*, int);
+    long long planarPixelErrors(const unsigned char* const*, const unsigned char* const*, int, int*);
+    string getImplementation();
+    vector<string> getImplementations();
+    void setImplementation(const string&);
+};
+
+#endif //WANGTILE_SSD_H
@@ -0,0 +1,306 @@
+/**
+ * The ThreadPool class keeps a fixed set of worker threads alive so that independent pieces of work (the cells of one
+ * anti-diagonal of a Quilt, the chunks of its candidate scoring) can be spread over every core without spawning
+ * threads each time.
+ *
+ * Work is scheduled by stealing: every thread keeps its own queue of index ranges, splits the range it is working on in
+ * half and queues the upper half, and an idle thread steals the oldest (largest) range from another thread's queue.
+ * A thread waiting for a parallelFor keeps running the queued ranges of that same parallelFor meanwhile, so
+ * parallelFor can be nested freely. It never picks up unrelated work while it waits, since that work could be another
+ * call of the very function it is in the middle of.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/20/17
+ * @version 1.1 - 04/10/17 - Waiting threads only help with their own parallelFor
+ */
+
+#include "ThreadPool.h"
+
+// The pool the current thread works for, and the index of its queue in that pool
+static thread_local const ThreadPool* t_pool = nullptr;
+static thread_local int t_queue = 0;
+
+/**
+ * Starts the worker threads of the pool. The thread calling parallelFor also takes part in the work, so a pool of
+ * N threads starts N - 1 workers.
+ *
+ * @param threads The total number of threads to use, or 0 to use one per hardware thread
+ */
+ThreadPool::ThreadPool(int threads)
+{
+    if (threads <= 0)
+    {
+        threads = max(1, (int) thread::hardware_concurrency());
+    }
+
+    m_queued = 0;
+    m_stopping = false;
+
+    // Queue 0 is shared by every thread from outside the pool
+    for (int i = 0; i < threads; i++)
+    {
+        m_queues.push_back(unique_ptr<Queue>(new Queue()));
+    }
+
+    for (int i = 1; i < threads; i++)
+    {
+        m_workers.push_back(thread(&ThreadPool::work, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_wake.notify_all();
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        m_workers[i].join();
+    }
+}
+
+/**
+ * Gets the number of threads that share the work of a parallelFor, including the calling thread
+ * @return The thread count
+ */
+int ThreadPool::getThreadCount() const
+{
+    return m_workers.size() + 1;
+}
+
+/**
+ * Calls the body once for every index in [0, count), spread over the threads of the pool, and returns once every call
+ * has finished. Calls are made in no particular order, so the body must only write to state owned by its index.
+ *
+ * @param count The number of indices
+ * @param body The function to call with each index
+ * @throws The first exception thrown by the body, once every call has finished. Indices not started by then are skipped
+ */
+void ThreadPool::parallelFor(int count, const function<void(int)>& body)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (m_workers.empty() || count == 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            body(i);
+        }
+
+        return;
+    }
+
+    int self = getQueueIndex();
+    Job job;
+
+    job.body = &body;
+    job.remaining = count;
+    job.queued = 0;
+    job.failed = false;
+
+    run(self, {&job, 0, count});
+
+    // Only ranges of this job are run while waiting. Running another, say a sibling cell of the parallelFor this one
+    // is nested in, would stack a second call of the caller on top of this one, sharing whatever the caller keeps
+    // per thread
+    while (job.remaining > 0)
+    {
+        Task task;
+
+        if (pop(self, &job, task))
+        {
+            run(self, task);
+            continue;
+        }
+
+        unique_lock<mutex> lock(m_mutex);
+        m_wake.wait(lock, [&] { return job.remaining == 0 || job.queued > 0; });
+    }
+
+    if (job.error)
+    {
+        rethrow_exception(job.error);
+    }
+}
+
+/**
+ * Loop run by each worker thread, running queued work and sleeping while there is none
+ *
+ * @param index The index of the worker's own queue
+ */
+void ThreadPool::work(int index)
+{
+    t_pool = this;
+    t_queue = index;
+
+    while (true)
+    {
+        Task task;
+
+        if (pop(index, task))
+        {
+            run(index, task);
+            continue;
+        }
+
+        unique_lock<mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stopping || m_queued > 0; });
+
+        if (m_stopping)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Runs the first index of a range, after queueing the rest of it in halves so that other threads can steal them
+ *
+ * @param self The queue of the running thread
+ * @param task The range to run
+ */
+void ThreadPool::run(int self, Task task)
+{
+    while (task.end - task.begin > 1)
+    {
+        int middle = task.begin + (task.end - task.begin) / 2;
+
+        push(self, {task.job, middle, task.end});
+        task.end = middle;
+    }
+
+    Job* job = task.job;
+
+    if (!job->failed)
+    {
+        try
+        {
+            (*job->body)(task.begin);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(job->errorLock);
+
+            if (!job->error)
+            {
+                job->error = current_exception();
+            }
+
+            job->failed = true;
+        }
+    }
+
+    // The job lives on the stack of the thread waiting for it, so it must not be touched after the last index is done
+    if (job->remaining.fetch_sub(1) == 1)
+    {
+        notify();
+    }
+}
+
+/**
+ * Adds a range to the back of a queue, and wakes the sleeping threads to steal it
+ *
+ * @param index The queue to add to
+ * @param task The range to add
+ */
+void ThreadPool::push(int index, const Task& task)
+{
+    {
+        lock_guard<mutex> lock(m_queues[index]->lock);
+        m_queues[index]->tasks.push_back(task);
+        task.job->queued++;
+        m_queued++;
+    }
+
+    notify();
+}
+
+/**
+ * Takes the next range to run: the newest range of the thread's own queue, or failing that the oldest range of
+ * another queue
+ *
+ * @param self The queue of the running thread
+ * @param task Set to the range taken
+ * @return False if every queue is empty
+ */
+bool ThreadPool::pop(int self, Task& task)
+{
+    return pop(self, nullptr, task);
+}
+
+/**
+ * Takes the next range of the given job to run: the newest such range of the thread's own queue, or failing that the
+ * oldest such range of another queue
+ *
+ * @param self The queue of the running thread
+ * @param job The job to take a range of, or nullptr to take a range of any job
+ * @param task Set to the range taken
+ * @return False if no queue holds a range of the job
+ */
+bool ThreadPool::pop(int self, const Job* job, Task& task)
+{
+    {
+        Queue& own = *m_queues[self];
+        lock_guard<mutex> lock(own.lock);
+
+        for (auto it = own.tasks.rbegin(); it != own.tasks.rend(); ++it)
+        {
+            if (job == nullptr || it->job == job)
+            {
+                task = *it;
+                own.tasks.erase(next(it).base());
+                task.job->queued--;
+                m_queued--;
+                return true;
+            }
+        }
+    }
+
+    for (size_t i = 1; i < m_queues.size(); i++)
+    {
+        Queue& other = *m_queues[(self + i) % m_queues.size()];
+        lock_guard<mutex> lock(other.lock);
+
+        for (auto it = other.tasks.begin(); it != other.tasks.end(); ++it)
+        {
+            if (job == nullptr || it->job == job)
+            {
+                task = *it;
+                other.tasks.erase(it);
+                task.job->queued--;
+                m_queued--;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Wakes every sleeping thread to check for new work or a finished job
+ */
+void ThreadPool::notify()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+    }
+
+    m_wake.notify_all();
+}
+
+/**
+ * Gets the queue of the calling thread: its own if it is a worker of this pool, the shared one otherwise
+ * @return The index of the queue
+ */
+int ThreadPool::getQueueIndex() const
+{
+    return t_pool == this ? t_queue : 0;
+}
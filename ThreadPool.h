@@ -0,0 +1,83 @@
+/**
+ * The ThreadPool class keeps a fixed set of worker threads alive so that independent pieces of work (the cells of one
+ * anti-diagonal of a Quilt, the chunks of its candidate scoring) can be spread over every core without spawning
+ * threads each time.
+ *
+ * Work is scheduled by stealing: every thread keeps its own queue of index ranges, splits the range it is working on in
+ * half and queues the upper half, and an idle thread steals the oldest (largest) range from another thread's queue.
+ * A thread waiting for a parallelFor keeps running the queued ranges of that same parallelFor meanwhile, so
+ * parallelFor can be nested freely. It never picks up unrelated work while it waits, since that work could be another
+ * call of the very function it is in the middle of.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/20/17
+ * @version 1.1 - 04/10/17 - Waiting threads only help with their own parallelFor
+ */
+
+#ifndef WANGTILE_THREADPOOL_H
+#define WANGTILE_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool
+{
+private:
+    struct Job
+    {
+        const function<void(int)>* body;
+        atomic<int> remaining;
+        atomic<int> queued;
+        atomic<bool> failed;
+        mutex errorLock;
+        exception_ptr error;
+    };
+
+    struct Task
+    {
+        Job* job;
+        int begin;
+        int end;
+    };
+
+    struct Queue
+    {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<thread> m_workers;
+    vector<unique_ptr<Queue>> m_queues;
+    atomic<int> m_queued;
+    mutex m_mutex;
+    condition_variable m_wake;
+    bool m_stopping;
+
+    void work(int);
+    void push(int, const Task&);
+    bool pop(int, Task&);
+    bool pop(int, const Job*, Task&);
+    void run(int, Task);
+    void notify();
+    int getQueueIndex() const;
+
+public:
+    ThreadPool(int);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    int getThreadCount() const;
+    void parallelFor(int, const function<void(int)>&);
+
+    virtual ~ThreadPool();
+};
+
+#endif //WANGTILE_THREADPOOL_H
@@ -5,6 +5,7 @@
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 02/05/17
  * @version 1.1 - 02/18/17 - New constructor to specify in advance the side codes rather than deriving from filename
+ * @version 1.2 - 04/07/17 - Images and codes are moved in, and tiles share their image when copied
  */
 
 #include "Tile.h"
@@ -13,11 +14,12 @@
 /**
  * Default constructor for the Tile object, given the bitmap file to make this tile from
  *
- * @param The bitmap file representing this Tile's pixel content
+ * @param The bitmap file representing this Tile's pixel content. Copies of a bitmap share its pixels, so passing one
+ *        in is cheap either way, but moving it in saves even the reference count
  */
-Tile::Tile(BMPFile& file)
-: m_image(file) {
-    m_sideCodes = util::parseFileNameForSideCodes(string(file.getFileName()), '_');
+Tile::Tile(BMPFile file)
+: m_image(move(file)) {
+    m_sideCodes = util::parseFileNameForSideCodes(string(m_image.getFileName()), '_');
 }
 
 /**
@@ -27,14 +29,8 @@ Tile::Tile(BMPFile& file)
  * @param file The bitmap file
  * @param codes The vector representing each side's code
  */
-Tile::Tile(BMPFile& file, vector<char>& codes)
-: m_image(file) {
-	m_sideCodes = codes;
-}
-
-Tile::Tile(const Tile& tile)
-: m_image(tile.m_image) {
-	m_sideCodes = tile.m_sideCodes;
+Tile::Tile(BMPFile file, vector<char> codes)
+: m_image(move(file)), m_sideCodes(move(codes)) {
 }
 
 /**
@@ -5,6 +5,7 @@
  * @author Sasha Ouellet - spaouellet@me.com
  * @version 1.0 - 02/05/17
  * @version 1.1 - 02/18/17 - New constructor to specify in advance the side codes rather than deriving from filename
+ * @version 1.2 - 04/07/17 - Images and codes are moved in, and tiles share their image when copied
  */
 
 #ifndef WANGTILE_TILE_H
@@ -27,9 +28,8 @@ public:
     static const int SOUTH = 2;
     static const int WEST = 3;
 
-    Tile(BMPFile&);
-	Tile(BMPFile&, vector<char>&);
-	Tile(const Tile&);
+    Tile(BMPFile);
+	Tile(BMPFile, vector<char>);
     char getCodeAtSide(int);
     bool hasCodeAtSide(char, int);
     void print();
@@ -1,17 +1,33 @@
 /**
  * Represents the spread of all the tiles that will be outputted to the final bitmap file
  *
- * Tiles are stored in a vector of vectors, to represent the grid layout of the Tiles.
+ * The grid layout of the Tiles is stored as one small index into the tile set per cell (8 bit, or 16 bit for sets of
+ * more than 256 tiles), so a cell costs a byte or two rather than a whole Tile.
  *
  * @author Sasha Ouellet - spaouellet@me.com
  * @version 1.0 - 02/05/17
  * @version 1.1 - 02/19/17 - Allowing construction via pre-developed vector array of Tiles
+ * @version 1.2 - 03/29/17 - Stateless hash-based mode, computing any tile on demand
+ * @version 1.3 - 03/30/17 - Cells stored as indices into the tile set
  */
 
+#include <algorithm>
 #include <cstdlib>
+#include <stdexcept>
 #include <random>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
 #include "TileMap.h"
+#include "BMPWriter.h"
+#include "util.h"
+#include "Trace.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /**
  * Default constructor for the TileMap
@@ -19,25 +35,132 @@
  * @param width The width, in number of tiles
  * @param height The height, in number of tiles
  */
-TileMap::TileMap(vector<Tile>& tileSet, unsigned int width, unsigned int height)
+TileMap::TileMap(vector<Tile> tileSet, unsigned int width, unsigned int height)
 {
-    m_tileSet = tileSet;
+    m_tileSet = move(tileSet);
     m_width = width;
     m_height = height;
     m_generator = std::default_random_engine(std::chrono::system_clock::now().time_since_epoch().count());
     m_distribution = std::uniform_int_distribution<int>(0, m_tileSet.size() - 1);
+    m_hashed = false;
+    m_wide = false;
+    m_threads = 0;
+    m_pool = nullptr;
+
+    indexTileSet();
 }
 
 /**
- * Constructs the tile map from the already generated tile set, in its grid format
- * @param tiles
+ * Constructs a stateless, hash-based TileMap. Rather than being generated and stored, every edge code is a hash of the
+ * seed and the position of the edge, so any tile can be computed on demand by getTileAt, at any coordinate (even
+ * outside of the width and height) and from any thread, without storing anything. The same seed always gives the same
+ * plane.
+ *
+ * This needs a complete tile set: one with a tile for every combination of north/south and east/west codes, as the
+ * four edges of a cell are chosen independently.
+ *
+ * @param tileSet The complete tile set
+ * @param width The width, in number of tiles, used when the map is written out
+ * @param height The height, in number of tiles, used when the map is written out
+ * @param seed The seed the edge codes are hashed from
+ * @throws invalid_argument If the tile set is not complete
+ */
+TileMap::TileMap(vector<Tile> tileSet, unsigned int width, unsigned int height, unsigned long long seed)
+{
+    m_tileSet = move(tileSet);
+    m_width = width;
+    m_height = height;
+    m_generator = std::default_random_engine(seed);
+    m_distribution = std::uniform_int_distribution<int>(0, m_tileSet.size() - 1);
+    m_hashed = true;
+    m_wide = false;
+    m_threads = 0;
+    m_pool = nullptr;
+    m_northSeed = util::hashCoordinates(seed, 0, 0);
+    m_westSeed = util::hashCoordinates(seed, 1, 0);
+    m_tileSeed = util::hashCoordinates(seed, 2, 0);
+
+    indexTileSet();
+    indexCombinations();
+}
+
+/**
+ * Constructs the tile map from the already generated tile set, in its grid format. Cells showing the same image with
+ * the same codes share one entry of the tile set.
+ *
+ * The tiles of the grid need not make up a set that could be generated from, so the set is only indexed if the map is
+ * generated again (see generate).
+ *
+ * @param tiles The grid of tiles, by row
+ * @param width The width, in number of tiles
+ * @param height The height, in number of tiles
+ * @throws invalid_argument If the grid is smaller than the width and height, or the map has no cells
  */
 TileMap::TileMap(vector<vector<Tile>> &tiles, unsigned int width, unsigned int height)
 {
-    m_tiles = tiles;
-    m_tileSet = tiles[0];
     m_width = width;
     m_height = height;
+    m_generator = std::default_random_engine(std::chrono::system_clock::now().time_since_epoch().count());
+    m_hashed = false;
+    m_indexed = false;
+    m_threads = 0;
+    m_pool = nullptr;
+
+    if (width == 0 || height == 0)
+    {
+        throw invalid_argument("Tile grid must have at least one cell");
+    }
+
+    if (tiles.size() < height)
+    {
+        throw invalid_argument("Tile grid has fewer rows than the height of the map");
+    }
+
+    map<pair<RGBPlane*, string>, int> unique;
+    vector<int> indices;
+
+    for (int i = 0; i < m_height; i++)
+    {
+        if (tiles[i].size() < width)
+        {
+            throw invalid_argument("Tile grid has fewer columns than the width of the map");
+        }
+
+        for (int j = 0; j < m_width; j++)
+        {
+            Tile& tile = tiles[i][j];
+            string codes;
+
+            for (int side = 0; side < 4; side++)
+            {
+                codes += tile.getCodeAtSide(side);
+            }
+
+            pair<RGBPlane*, string> key(tile.getImage().getPlane(), codes);
+            auto found = unique.find(key);
+
+            if (found == unique.end())
+            {
+                found = unique.insert(make_pair(key, (int) m_tileSet.size())).first;
+                m_tileSet.push_back(tile);
+            }
+
+            indices.push_back(found->second);
+        }
+    }
+
+    m_distribution = std::uniform_int_distribution<int>(0, m_tileSet.size() - 1);
+    allocateIndices();
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        setTileIndexAt(i % m_width, i / m_width, indices[i]);
+    }
+}
+
+TileMap::~TileMap()
+{
+    delete m_pool;
 }
 
 /**
@@ -58,6 +181,156 @@ int TileMap::getPixelHeight()
     return m_tileSet[0].getImage().getHeight() * m_height;
 }
 
+/**
+ * Indexes the tile set by the codes of its north and west sides, which are the sides constrained during generation,
+ * so that placing a tile is a single draw from the bucket of tiles that fit. There is one bucket per (north, west)
+ * pair, and one per west code and per north code alone, for the first row and column.
+ *
+ * @throws invalid_argument If the tile set is empty, or a code that some tile leaves on its south or east side cannot
+ *                          be matched by any tile, as generation could then get stuck
+ */
+void TileMap::indexTileSet()
+{
+    if (m_tileSet.empty())
+    {
+        throw invalid_argument("Tile set must not be empty");
+    }
+
+    m_indexed = false;
+    fill(m_codeSlots, m_codeSlots + 256, -1);
+    m_codes.clear();
+    m_sideSlots.resize(m_tileSet.size() * 4);
+
+    for (size_t i = 0; i < m_tileSet.size(); i++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            unsigned char code = m_tileSet[i].getCodeAtSide(side);
+
+            if (m_codeSlots[code] < 0)
+            {
+                m_codeSlots[code] = m_codes.size();
+                m_codes.push_back(code);
+            }
+
+            m_sideSlots[i * 4 + side] = m_codeSlots[code];
+        }
+    }
+
+    int codes = m_codes.size();
+
+    m_buckets.assign(codes * codes, vector<int>());
+    m_westBuckets.assign(codes, vector<int>());
+    m_northBuckets.assign(codes, vector<int>());
+
+    for (size_t i = 0; i < m_tileSet.size(); i++)
+    {
+        int north = m_sideSlots[i * 4 + Tile::NORTH];
+        int west = m_sideSlots[i * 4 + Tile::WEST];
+
+        m_buckets[north * codes + west].push_back(i);
+        m_westBuckets[west].push_back(i);
+        m_northBuckets[north].push_back(i);
+    }
+
+    // Only the distinct codes left on south and east sides matter, so each pair of them is checked once, however many
+    // tiles share them
+    vector<bool> souths(codes, false);
+    vector<bool> easts(codes, false);
+
+    for (size_t i = 0; i < m_tileSet.size(); i++)
+    {
+        souths[m_sideSlots[i * 4 + Tile::SOUTH]] = true;
+        easts[m_sideSlots[i * 4 + Tile::EAST]] = true;
+    }
+
+    for (int south = 0; south < codes; south++)
+    {
+        if (!souths[south])
+        {
+            continue;
+        }
+
+        if (m_northBuckets[south].empty())
+        {
+            throw invalid_argument(string("Tile set has no tile with north code ") + m_codes[south]);
+        }
+
+        for (int east = 0; east < codes; east++)
+        {
+            if (!easts[east])
+            {
+                continue;
+            }
+
+            if (m_westBuckets[east].empty())
+            {
+                throw invalid_argument(string("Tile set has no tile with west code ") + m_codes[east]);
+            }
+
+            if (m_buckets[south * codes + east].empty())
+            {
+                throw invalid_argument(string("Tile set has no tile with north code ") + m_codes[south]
+                                       + " and west code " + m_codes[east]);
+            }
+        }
+    }
+
+    m_indexed = true;
+}
+
+/**
+ * Indexes the tile set by all four of its side codes, for the hash-based mode. The north/south codes and east/west
+ * codes used by the set are gathered, and every combination of them must be covered by at least one tile.
+ *
+ * @throws invalid_argument If some combination of codes has no tile
+ */
+void TileMap::indexCombinations()
+{
+    vector<int> northSouth(m_codes.size(), -1);
+    vector<int> eastWest(m_codes.size(), -1);
+
+    for (size_t i = 0; i < m_tileSet.size(); i++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            int slot = m_sideSlots[i * 4 + side];
+            bool vertical = side == Tile::NORTH || side == Tile::SOUTH;
+            vector<int>& axis = vertical ? northSouth : eastWest;
+            vector<int>& codes = vertical ? m_northSouthCodes : m_eastWestCodes;
+
+            if (axis[slot] < 0)
+            {
+                axis[slot] = codes.size();
+                codes.push_back(slot);
+            }
+        }
+    }
+
+    int ns = m_northSouthCodes.size();
+    int ew = m_eastWestCodes.size();
+
+    m_combinations.assign(ns * ew * ns * ew, vector<int>());
+
+    for (size_t i = 0; i < m_tileSet.size(); i++)
+    {
+        int north = northSouth[m_sideSlots[i * 4 + Tile::NORTH]];
+        int east = eastWest[m_sideSlots[i * 4 + Tile::EAST]];
+        int south = northSouth[m_sideSlots[i * 4 + Tile::SOUTH]];
+        int west = eastWest[m_sideSlots[i * 4 + Tile::WEST]];
+
+        m_combinations[((north * ew + east) * ns + south) * ew + west].push_back(i);
+    }
+
+    for (size_t i = 0; i < m_combinations.size(); i++)
+    {
+        if (m_combinations[i].empty())
+        {
+            throw invalid_argument("Hash-based tile maps need a complete tile set, with a tile for every combination of codes");
+        }
+    }
+}
+
 /**
  * Runs through the generation process of the entire tile map, populating the vectors for each row of the grid
  * according to the specifications for Wang Tile tiling process
@@ -67,88 +340,163 @@ int TileMap::getPixelHeight()
  *
  * The next row must follow the same specifications, in addition to the North side codes matching the South side codes
  * of their neighbor directly above.
+ *
+ * Each placement is one random draw from the bucket of tiles matching those codes (see indexTileSet), avoiding a tile
+ * with the same codes as its left neighbour whenever the bucket has any other. A hash-based map has nothing to generate.
+ *
+ * @throws invalid_argument If the map was built from a grid whose tiles cannot be generated from (see indexTileSet)
  */
 void TileMap::generate()
 {
-    // As of now, starting with index 2 is the only known tile that will successfully tile the whole thing
-    for (int i = 0 ; i < m_height ; i++)
+    // Nothing is stored in the hash-based mode, tiles are computed as they are asked for
+    if (m_hashed)
+    {
+        return;
+    }
+
+    // Maps built from a grid are indexed the first time they are generated
+    if (!m_indexed)
     {
-        cout << "i: " << i << endl;
-        vector<Tile> row;
-        Tile* last = nullptr;
+        indexTileSet();
+    }
+
+    trace::Scope scope("generate map");
+    int codes = m_codes.size();
+    vector<int> above(m_width, -1);
+    vector<int> current(m_width, -1);
 
+    allocateIndices();
+
+    for (int i = 0 ; i < m_height ; i++)
+    {
         for (int j = 0 ; j < m_width ; j++)
         {
-            if (j != 0)
-            {
-                last = &row[j - 1];
-            }
-            cout << "\tj: " << j << endl;
+            int last = j != 0 ? current[j - 1] : -1;
+            int east = last >= 0 ? m_sideSlots[last * 4 + Tile::EAST] : -1;
+            int south = i != 0 ? m_sideSlots[above[j] * 4 + Tile::SOUTH] : -1;
+
             // Special case for first tile
             if (i == 0 && j == 0)
             {
-                row.push_back(getRandom());
+                current[j] = m_distribution(m_generator);
             }
             // Special case for first row, don't need to check for row above
             else if (i == 0)
             {
-                Tile t = getRandom();
-
-                // Pick while the codes for the E and W sides don't match
-                while (!t.hasCodeAtSide(row[j - 1].getCodeAtSide(Tile::EAST), Tile::WEST) || t.isSame(last))
-                {
-                    t = getRandom();
-                    cout << "[EAST / WEST]   Need: " << row[j - 1].getCodeAtSide(Tile::EAST) << ", Have: " << t.getCodeAtSide(Tile::WEST) << endl;
-                }
-
-                row.push_back(t);
+                current[j] = pickFromBucket(m_westBuckets[east], last);
+            }
+            // Special case for first of row, don't need to check E/W
+            else if (j == 0)
+            {
+                current[j] = pickFromBucket(m_northBuckets[south], last);
             }
             // Normal case, need to check row above for code matching as well
             else
             {
-                Tile t = getRandom();
+                current[j] = pickFromBucket(m_buckets[south * codes + east], last);
+            }
 
-                // Pick while the codes for the E and W sides don't match, AND while the codes for N and S don't match
+            setTileIndexAt(j, i, current[j]);
+        }
 
-                // Special case for first of row, don't need to check E/W
-                if (j == 0)
-                {
-                    while (!t.hasCodeAtSide(m_tiles[i - 1][j].getCodeAtSide(Tile::SOUTH), Tile::NORTH) || t.isSame(last))
-                    {
-                        t = getRandom();
-                        cout << "[NORTH / SOUTH] Need: " << m_tiles[i - 1][j].getCodeAtSide(Tile::SOUTH) << ", Have: " << t.getCodeAtSide(Tile::NORTH) << endl;
-                    }
-                }
-                // Normal case
-                else
-                {
-                    int tries = 0;
-                    while ((!t.hasCodeAtSide(row[j - 1].getCodeAtSide(Tile::EAST), Tile::WEST) || !t.hasCodeAtSide(m_tiles[i - 1][j].getCodeAtSide(Tile::SOUTH), Tile::NORTH) || t.isSame(last)) && tries < 10)
-                    {
-                        t = getRandom();
-                        cout << "[NORTH / SOUTH] Need: " << m_tiles[i - 1][j].getCodeAtSide(Tile::SOUTH) << ", Have: " << t.getCodeAtSide(Tile::NORTH) << endl;
-                        cout << "[EAST / WEST]   Need: " << row[j - 1].getCodeAtSide(Tile::EAST) << ", Have: " << t.getCodeAtSide(Tile::WEST) << endl;
-//                        tries++; // Fail safe to avoid endless cycle if location not tile-able
-                    }
-                }
+        swap(above, current);
+    }
 
-                row.push_back(t);
-            }
+    trace::count("tiles placed", (long long) m_width * m_height);
+}
+
+/**
+ * Draws a random tile from a bucket, leaving out the tiles with the same codes as the given one unless the bucket
+ * holds nothing else
+ *
+ * @param bucket The indices of the tiles in the tile set to pick from
+ * @param last The index of the tile to avoid repeating, -1 for none
+ * @return The index of the picked tile in the tile set
+ */
+int TileMap::pickFromBucket(const vector<int>& bucket, int last)
+{
+    int others = 0;
+
+    if (last >= 0)
+    {
+        for (size_t i = 0; i < bucket.size(); i++)
+        {
+            others += isSameTile(bucket[i], last) ? 0 : 1;
+        }
+    }
+
+    if (others == 0)
+    {
+        uniform_int_distribution<int> dist(0, bucket.size() - 1);
+        return bucket[dist(m_generator)];
+    }
+
+    uniform_int_distribution<int> dist(0, others - 1);
+    int pick = dist(m_generator);
+
+    for (size_t i = 0; i < bucket.size(); i++)
+    {
+        if (!isSameTile(bucket[i], last) && pick-- == 0)
+        {
+            return bucket[i];
         }
+    }
 
-        m_tiles.push_back(row);
+    return bucket.back();
+}
+
+/**
+ * Determines if two tiles of the tile set have the same codes on every side
+ *
+ * @param a The index of the first tile
+ * @param b The index of the second tile
+ * @return True if every side code matches
+ */
+bool TileMap::isSameTile(int a, int b)
+{
+    for (int side = 0; side < 4; side++)
+    {
+        if (m_sideSlots[a * 4 + side] != m_sideSlots[b * 4 + side])
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
 /**
  * Gets a random tile from the tile set
  * @return The randomly selected tile
  */
-Tile TileMap::getRandom()
+Tile& TileMap::getRandom()
 {
     return m_tileSet[m_distribution(m_generator)];
 }
 
+/**
+ * Sets the seed the random choices of generate are drawn from, so that the same tile set and seed always give the same
+ * map. Hash-based maps take their seed when they are constructed instead.
+ *
+ * @param seed The seed
+ */
+void TileMap::setSeed(unsigned long long seed)
+{
+    m_generator = std::default_random_engine(seed);
+}
+
+/**
+ * Sets the number of threads the map is rasterized with by makeArray
+ *
+ * @param threads The number of threads, or 0 to use one per hardware thread
+ */
+void TileMap::setThreadCount(int threads)
+{
+    delete m_pool;
+    m_pool = nullptr;
+    m_threads = threads;
+}
+
 /**
  * Prints the tile map configuration
  */
@@ -156,12 +504,12 @@ void TileMap::print()
 {
     for (int i = 0 ; i < m_height ; i++)
     {
-        cout << "ROW " << i << ", size: " << m_tiles[i].size() << endl << "-----------------" << endl;
+        cout << "ROW " << i << ", size: " << m_width << endl << "-----------------" << endl;
 
         for (int j = 0 ; j < m_width ; j++)
         {
             cout << "\t";
-            m_tiles[i][j].print();
+            getTileAt(j, i).print();
             cout << endl;
         }
     }
@@ -169,24 +517,249 @@ void TileMap::print()
 
 /**
  * Aggregates all the tiles in the 2-dimensional vector structure to put all the Tile pixel data into the main
- * pixel data array that will be written as the output file.
+ * pixel data array that will be written as the output file. For large maps, prefer writeFile which never holds more
+ * than a row of the output.
  *
- * @return The final output pixel data array of all the tile's pixel data combined
+ * @return The final output plane of all the tile's pixel data combined
  */
-unsigned char* TileMap::makeArray()
+RGBPlane TileMap::makeArray()
 {
-    int size = 3 * getPixelWidth() * getPixelHeight();
-    unsigned char *data = new unsigned char[size];
+    trace::Scope scope("rasterize map");
+    long long size = 3LL * getPixelWidth() * getPixelHeight();
+    RGBPlane output(getPixelWidth(), getPixelHeight());
+    unsigned char* data = output.getRawData();
+    // An output far larger than the caches would only evict everything else on its way to memory
+    bool streaming = size >= STREAMING_THRESHOLD;
 
-    for (int i = 0 ; i < m_height ; i++)
+    // Started on first use and kept for the next calls, as maps that are only written out never need one
+    if (m_pool == nullptr)
     {
-        for (int j = 0 ; j < m_width ; j++)
+        m_pool = new ThreadPool(m_threads);
+    }
+
+    // Planes are decoded on first use, which must not happen on several threads at once
+    for (size_t i = 0; i < m_tileSet.size(); i++)
+    {
+        m_tileSet[i].getImage().getPlane();
+    }
+
+    // Each tile row covers its own band of the output, so rows are placed in parallel
+    m_pool->parallelFor(m_height, [&](int i)
+    {
+        trace::Scope rowScope("rasterize row");
+
+        if (!streaming)
         {
-            placeTile(m_tiles[i][j], j, i, data);
+            for (int j = 0 ; j < m_width ; j++)
+            {
+                placeTile(getTileAt(j, i), j, i, data);
+            }
+
+            return;
+        }
+
+        // Non-temporal stores only pay off on long runs, so each scanline of the band is gathered in the cache first
+        // and then streamed out whole
+        int tileHeight = getTileAt(0, i).getImage().getHeight();
+        long long rowSize = 3LL * getPixelWidth();
+        vector<unsigned char> scanline(rowSize);
+        unsigned char* band = data + (long long) (m_height - 1 - i) * tileHeight * rowSize;
+
+        for (int row = 0; row < tileHeight; row++)
+        {
+            unsigned char* dst = scanline.data();
+
+            for (int j = 0; j < m_width; j++)
+            {
+                RGBPlane* image = getTileAt(j, i).getImage().getPlane();
+
+                memcpy(dst, image->getRow(row), image->getWidth() * 3);
+                dst += image->getWidth() * 3;
+            }
+
+            streamRow(band + row * rowSize, scanline.data(), rowSize);
+        }
+
+        finishStreaming();
+    });
+
+    return output;
+}
+
+/**
+ * Writes the whole map as a BMP file, streaming it one scanline at a time so that only a single row of the output is
+ * ever held in memory. Scanlines are assembled from the rows of the tiles they cross, starting from the bottom tile row
+ * as the file is stored bottom-up.
+ *
+ * @param name The name of the file to save to (should include .bmp, i.e. "image.bmp")
+ */
+void TileMap::writeFile(const char* name)
+{
+    trace::Scope scope("write map");
+    BMPWriter writer(name, getPixelWidth(), getPixelHeight());
+    vector<unsigned char> scanline(3LL * getPixelWidth());
+
+    for (int i = m_height - 1; i >= 0; i--)
+    {
+        int tileHeight = getTileAt(0, i).getImage().getHeight();
+
+        for (int row = 0; row < tileHeight; row++)
+        {
+            unsigned char* dst = scanline.data();
+
+            for (int j = 0; j < m_width; j++)
+            {
+                RGBPlane* image = getTileAt(j, i).getImage().getPlane();
+                const unsigned char* src = image->getRow(row);
+
+                dst = copy(src, src + image->getWidth() * 3, dst);
+            }
+
+            writer.writeRow(scanline.data());
         }
     }
 
-	return data;
+    writer.close();
+}
+
+/**
+ * Writes a little endian 32 bit value to a file
+ *
+ * @param file The file to write to
+ * @param value The value to write
+ * @return True if the value was written
+ */
+static bool writeInt(FILE* file, unsigned int value)
+{
+    unsigned char bytes[4] = {(unsigned char) value, (unsigned char) (value >> 8), (unsigned char) (value >> 16),
+                              (unsigned char) (value >> 24)};
+
+    return fwrite(bytes, 1, 4, file) == 4;
+}
+
+/**
+ * Exports the map the way a renderer wants it, rather than rasterized: each tile of the tile set once, packed into an
+ * atlas image, and a compact binary map of which tile goes in each cell.
+ *
+ * The atlas is a grid of ceil(sqrt(tiles)) columns, filled left to right from the top. Every tile is surrounded by a
+ * gutter of its own edge pixels repeated outwards, so filtering near a tile edge never picks up its neighbour in the
+ * atlas. Tile k therefore starts at ((k % columns) * (size + 2 * gutter) + gutter, (k / columns) * (size + 2 * gutter)
+ * + gutter), counted from the top left of the atlas.
+ *
+ * The index map is little endian:
+ *
+ *   "WTIM", version (1), map width, map height, tile count, bytes per index (1 or 2), tile size, gutter, atlas columns
+ *   (all 32 bit), then the N, E, S, W codes of each tile (4 bytes each), then one index per cell, by row from the top
+ *
+ * @param atlasName The name of the BMP file to save the atlas to
+ * @param indexName The name of the file to save the index map to
+ * @param gutter The width of the gutter around each tile, in pixels
+ * @throws invalid_argument If the gutter is negative, the tiles are not all square and of the same size, or a file
+ *                          cannot be written
+ */
+void TileMap::writeAtlas(const char* atlasName, const char* indexName, int gutter)
+{
+    trace::Scope scope("write atlas");
+    int count = m_tileSet.size();
+    int size = m_tileSet[0].getImage().getWidth();
+
+    if (gutter < 0)
+    {
+        throw invalid_argument("Atlas gutter must not be negative");
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        BMPFile& image = m_tileSet[i].getImage();
+
+        if (image.getWidth() != size || image.getHeight() != size)
+        {
+            throw invalid_argument("Every tile of an atlas must be square and of the same size");
+        }
+    }
+
+    int columns = (int) ceil(sqrt((double) count));
+    int rows = (count + columns - 1) / columns;
+    int cell = size + 2 * gutter;
+    RGBPlane atlas(columns * cell, rows * cell);
+
+    for (int i = 0; i < count; i++)
+    {
+        // The atlas is stored bottom-up, like every other plane
+        int originX = (i % columns) * cell;
+        int originY = (rows - 1 - i / columns) * cell;
+
+        atlas.copyRegionFrom(*m_tileSet[i].getImage().getPlane(), 0, 0, size, size, originX + gutter, originY + gutter);
+
+        for (int y = originY + gutter; y < originY + gutter + size; y++)
+        {
+            unsigned char* row = atlas.getPixel(originX, y);
+
+            for (int x = 0; x < gutter; x++)
+            {
+                copy(row + gutter * 3, row + gutter * 3 + 3, row + x * 3);
+                copy(row + (gutter + size - 1) * 3, row + (gutter + size) * 3, row + (gutter + size + x) * 3);
+            }
+        }
+
+        for (int y = 0; y < gutter; y++)
+        {
+            atlas.copyRegionFrom(atlas, originX, originY + gutter, cell, 1, originX, originY + y);
+            atlas.copyRegionFrom(atlas, originX, originY + gutter + size - 1, cell, 1, originX, originY + gutter + size + y);
+        }
+    }
+
+    BMPFile::writeFile(atlas.getWidth(), atlas.getHeight(), atlas.getRawData(), atlasName);
+
+    FILE* file = fopen(indexName, "wb");
+
+    if (file == NULL)
+    {
+        throw invalid_argument("Could not open index map file for writing");
+    }
+
+    int bytesPerIndex = count > 256 ? 2 : 1;
+    bool written = fwrite("WTIM", 1, 4, file) == 4;
+    unsigned int header[] = {1, (unsigned int) m_width, (unsigned int) m_height, (unsigned int) count,
+                             (unsigned int) bytesPerIndex, (unsigned int) size, (unsigned int) gutter,
+                             (unsigned int) columns};
+
+    for (int i = 0; i < 8; i++)
+    {
+        written = written && writeInt(file, header[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            written = written && fputc(m_tileSet[i].getCodeAtSide(side), file) != EOF;
+        }
+    }
+
+    vector<unsigned char> row((long long) m_width * bytesPerIndex);
+
+    for (int i = 0; i < m_height && written; i++)
+    {
+        for (int j = 0; j < m_width; j++)
+        {
+            int index = getTileIndexAt(j, i);
+
+            row[j * bytesPerIndex] = (unsigned char) index;
+
+            if (bytesPerIndex == 2)
+            {
+                row[j * 2 + 1] = (unsigned char) (index >> 8);
+            }
+        }
+
+        written = fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+
+    if (fclose(file) != 0 || !written)
+    {
+        throw invalid_argument("Could not write index map file");
+    }
 }
 
 /**
@@ -202,27 +775,163 @@ unsigned char* TileMap::makeArray()
 void TileMap::placeTile(Tile &tile, int x, int y, unsigned char *data)
 {
     y = m_height - 1 - y;
-    BMPFile& image = tile.getImage();
-    const unsigned char *imagePixels = image.getPlane()->getRawData();
-    int tileWidth = image.getWidth();
-    int size = tileWidth * image.getHeight() * 3;
-    int offset = y * m_width * size;
+    RGBPlane* image = tile.getImage().getPlane();
+    int tileWidth = image->getWidth();
+    int tileHeight = image->getHeight();
+    int rowSize = tileWidth * 3;
+    unsigned char* start = data + ((long long) y * tileHeight * m_width + x) * rowSize;
 
-    for (int i = 0; i < size; i++)
+    for (int row = 0; row < tileHeight; row++)
     {
-        int row = i / (tileWidth * 3);
-        int col = i % (tileWidth * 3);
-        data[offset + (tileWidth * 3 * (x + (m_width * row))) + col] = imagePixels[i];
+        memcpy(start + (long long) row * m_width * rowSize, image->getRow(row), rowSize);
     }
 }
 
+/**
+ * Copies a row with non-temporal stores where the CPU has them (SSE2), falling back to memcpy. Only the 16 byte
+ * aligned middle of the destination is streamed, the unaligned ends are copied normally.
+ *
+ * @param dst Where to copy the row to
+ * @param src The row to copy
+ * @param bytes The length of the row
+ */
+void TileMap::streamRow(unsigned char* dst, const unsigned char* src, long long bytes)
+{
+#ifdef __SSE2__
+    long long head = min(bytes, (long long) ((16 - ((uintptr_t) dst & 15)) & 15));
+    long long i = head;
+
+    memcpy(dst, src, head);
+
+    for (; i + 16 <= bytes; i += 16)
+    {
+        _mm_stream_si128((__m128i*) (dst + i), _mm_loadu_si128((const __m128i*) (src + i)));
+    }
+
+    memcpy(dst + i, src + i, bytes - i);
+#else
+    memcpy(dst, src, bytes);
+#endif
+}
+
+/**
+ * Orders any non-temporal stores made by this thread before everything it writes afterwards
+ */
+void TileMap::finishStreaming()
+{
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+}
+
 /**
  * Gets the tile at the specified x and y coordinates in the TileMap plane
  * @param x The x value of the tile
  * @param y The y value of the tile
- * @return The tile at these coordinates
+ * @return The tile at these coordinates, shared with every other cell showing it (NOT A COPY)
+ * @throws invalid_argument If the coordinates are outside of a stored map
+ */
+Tile& TileMap::getTileAt(int x, int y)
+{
+    return m_tileSet[getTileIndexAt(x, y)];
+}
+
+/**
+ * Gets the index within the tile set of the tile at the specified coordinates.
+ *
+ * In the hash-based mode this works for any coordinate: the north and west codes of the cell are hashed from the
+ * position of those edges, and its south and east codes are the north and west codes of the cells below and to the
+ * right.
+ *
+ * @param x The x value of the tile
+ * @param y The y value of the tile
+ * @return The index of the tile in the tile set
+ * @throws invalid_argument If the coordinates are outside of a stored map, or it has not been generated
+ */
+int TileMap::getTileIndexAt(int x, int y)
+{
+    if (m_hashed)
+    {
+        int ns = m_northSouthCodes.size();
+        int ew = m_eastWestCodes.size();
+        int north = util::hashCoordinates(m_northSeed, x, y) % ns;
+        int south = util::hashCoordinates(m_northSeed, x, y + 1) % ns;
+        int west = util::hashCoordinates(m_westSeed, x, y) % ew;
+        int east = util::hashCoordinates(m_westSeed, x + 1, y) % ew;
+        const vector<int>& tiles = m_combinations[((north * ew + east) * ns + south) * ew + west];
+
+        return tiles[util::hashCoordinates(m_tileSeed, x, y) % tiles.size()];
+    }
+
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height)
+    {
+        throw invalid_argument("Tile coordinates are outside of the map");
+    }
+
+    size_t cell = (size_t) y * m_width + x;
+
+    if (m_wide ? cell >= m_wideIndices.size() : cell >= m_narrowIndices.size())
+    {
+        throw invalid_argument("Tile map has not been generated");
+    }
+
+    return m_wide ? m_wideIndices[cell] : m_narrowIndices[cell];
+}
+
+/**
+ * Sizes the index grid for the width and height of the map, with indices wide enough for the tile set
+ *
+ * @throws invalid_argument If the tile set has more tiles than a 16 bit index can address
+ */
+void TileMap::allocateIndices()
+{
+    if (m_tileSet.size() > 65536)
+    {
+        throw invalid_argument("Tile set has too many tiles to index");
+    }
+
+    long long cells = (long long) m_width * m_height;
+
+    m_wide = m_tileSet.size() > 256;
+    m_narrowIndices.assign(m_wide ? 0 : cells, 0);
+    m_wideIndices.assign(m_wide ? cells : 0, 0);
+}
+
+/**
+ * Stores the index of the tile of a cell
+ *
+ * @param x The x value of the cell
+ * @param y The y value of the cell
+ * @param index The index of its tile in the tile set
+ */
+void TileMap::setTileIndexAt(int x, int y, int index)
+{
+    long long cell = (long long) y * m_width + x;
+
+    if (m_wide)
+    {
+        m_wideIndices[cell] = (uint16_t) index;
+    }
+    else
+    {
+        m_narrowIndices[cell] = (uint8_t) index;
+    }
+}
+
+/**
+ * Whether this map is hash-based, computing its tiles on demand
+ * @return True in the hash-based mode
+ */
+bool TileMap::isHashed()
+{
+    return m_hashed;
+}
+
+/**
+ * Gets the tile set the cells of this map index into
+ * @return The tile set
  */
-Tile TileMap::getTileAt(int x, int y)
+vector<Tile>& TileMap::getTileSet()
 {
-    return m_tiles[y][x];
+    return m_tileSet;
 }
@@ -1,41 +1,86 @@
 /**
  * Represents the spread of all the tiles that will be outputted to the final bitmap file
  *
- * Tiles are stored in a vector of vectors, to represent the grid layout of the Tiles.
+ * The grid layout of the Tiles is stored as one small index into the tile set per cell (8 bit, or 16 bit for sets of
+ * more than 256 tiles), so a cell costs a byte or two rather than a whole Tile.
  *
  * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
  * @version 1.0 - 02/05/17
  * @version 1.1 - 02/19/17 - Allowing construction via pre-developed vector array of Tiles
+ * @version 1.2 - 03/29/17 - Stateless hash-based mode, computing any tile on demand
+ * @version 1.3 - 03/30/17 - Cells stored as indices into the tile set
  */
 
 #ifndef WANGTILE_TILEMAP_H
 #define WANGTILE_TILEMAP_H
 
 #include "Tile.h"
+#include "ThreadPool.h"
+#include <cstdint>
 #include <random>
 
 class TileMap
 {
 private:
-    vector<vector<Tile>> m_tiles;
+    vector<uint8_t> m_narrowIndices;
+    vector<uint16_t> m_wideIndices;
+    bool m_wide;
     vector<Tile> m_tileSet;
     int m_width;
     int m_height;
     default_random_engine m_generator;
     uniform_int_distribution<int> m_distribution;
+    vector<char> m_codes;
+    int m_codeSlots[256];
+    vector<int> m_sideSlots;
+    vector<vector<int>> m_buckets;
+    vector<vector<int>> m_westBuckets;
+    vector<vector<int>> m_northBuckets;
+    bool m_indexed;
+    bool m_hashed;
+    unsigned long long m_northSeed;
+    unsigned long long m_westSeed;
+    unsigned long long m_tileSeed;
+    vector<int> m_northSouthCodes;
+    vector<int> m_eastWestCodes;
+    vector<vector<int>> m_combinations;
+    int m_threads;
+    ThreadPool* m_pool;
+
+    void indexTileSet();
+    void indexCombinations();
+    void allocateIndices();
+    static void streamRow(unsigned char*, const unsigned char*, long long);
+    static void finishStreaming();
+    void setTileIndexAt(int, int, int);
+    int pickFromBucket(const vector<int>&, int);
+    bool isSameTile(int, int);
 
 public:
-    TileMap(vector<Tile>&, unsigned int, unsigned int);
+    const static long long STREAMING_THRESHOLD = 256LL * 1024 * 1024;
+
+    TileMap(vector<Tile>, unsigned int, unsigned int);
+    TileMap(vector<Tile>, unsigned int, unsigned int, unsigned long long);
 	TileMap(vector<vector<Tile>>&, unsigned int, unsigned int);
+    TileMap(const TileMap&) = delete;
+    TileMap& operator=(const TileMap&) = delete;
     void generate();
-    Tile getRandom();
+    Tile& getRandom();
+    void setSeed(unsigned long long);
+    void setThreadCount(int);
     void print();
-    unsigned char* makeArray();
+    RGBPlane makeArray();
+    void writeFile(const char*);
+    void writeAtlas(const char*, const char*, int);
     void placeTile(Tile&, int, int, unsigned char*);
     int getPixelWidth();
     int getPixelHeight();
-	Tile getTileAt(int, int);
-	//TODO: addTile to original tile set method
+	Tile& getTileAt(int, int);
+    int getTileIndexAt(int, int);
+    bool isHashed();
+    vector<Tile>& getTileSet();
+
+    virtual ~TileMap();
 };
 
 #endif //WANGTILE_TILEMAP_H
@@ -0,0 +1,270 @@
+/**
+ * The TilePack class reads and writes a whole tile set as a single pack file, which is memory mapped when it is read
+ * so that a set can be loaded without decoding (or even reading) any of its pixels.
+ *
+ * The pack is little endian:
+ *
+ *   "WTPK", version (1), tile count, tile size, alignment (all 32 bit), then the offset of the first pixel blob and a
+ *   64 bit FNV-1a hash of the codes and pixels (both 64 bit), then the N, E, S, W codes of each tile (4 bytes each)
+ *
+ * followed by one pixel blob per tile, each starting on a multiple of the alignment. A blob holds the R, G, B values
+ * of its tile row by row from the bottom, exactly as an RGBPlane holds them, so tiles read from a pack use the mapped
+ * blobs as their planes directly.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/01/17
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "TilePack.h"
+#include "Trace.h"
+
+/**
+ * Reads a little endian value of the given number of bytes
+ *
+ * @param bytes The first byte of the value
+ * @param count The number of bytes of the value (at most 8)
+ * @return The value
+ */
+static unsigned long long readValue(const unsigned char* bytes, int count)
+{
+    unsigned long long value = 0;
+
+    for (int i = count - 1; i >= 0; i--)
+    {
+        value = (value << 8) | bytes[i];
+    }
+
+    return value;
+}
+
+/**
+ * Writes a little endian value of the given number of bytes
+ *
+ * @param file The file to write to
+ * @param value The value to write
+ * @param count The number of bytes of the value (at most 8)
+ * @return True if the value was written
+ */
+static bool writeValue(FILE* file, unsigned long long value, size_t count)
+{
+    unsigned char bytes[8];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        bytes[i] = (unsigned char) (value >> (8 * i));
+    }
+
+    return fwrite(bytes, 1, count, file) == count;
+}
+
+/**
+ * Continues a 64 bit FNV-1a hash over the given bytes
+ *
+ * @param hash The hash of everything before these bytes
+ * @param bytes The bytes to hash
+ * @param count The number of bytes
+ * @return The hash including these bytes
+ */
+static unsigned long long hashBytes(unsigned long long hash, const unsigned char* bytes, long long count)
+{
+    for (long long i = 0; i < count; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+static const unsigned long long HASH_BASIS = 0xCBF29CE484222325ULL;
+
+/**
+ * Loads the pack with the given name. The pack is mapped copy-on-write and its layout checked, but no pixel is read:
+ * the planes of its tiles are the blobs of the mapping itself, which stays mapped as long as any of its tiles exist.
+ *
+ * @param fileName The name of the pack file
+ * @throws invalid_argument If the file cannot be read, is not a tile pack, or is truncated
+ */
+TilePack::TilePack(const char* fileName)
+{
+    trace::Scope scope("load pack");
+    m_mapping = make_shared<MappedFile>(fileName, true);
+
+    unsigned char* data = m_mapping->getWritableData();
+    size_t size = m_mapping->getSize();
+
+    if (size < HEADER_SIZE || memcmp(data, "WTPK", 4) != 0)
+    {
+        throw invalid_argument("File is not a tile pack");
+    }
+
+    // The 32 bit fields are read as such, and every size derived from them is worked out in 64 bits
+    uint32_t version = (uint32_t) readValue(data + 4, 4);
+    uint32_t count = (uint32_t) readValue(data + 8, 4);
+    uint32_t tileSize = (uint32_t) readValue(data + 12, 4);
+    uint32_t alignment = (uint32_t) readValue(data + 16, 4);
+
+    m_pixelOffset = readValue(data + 20, 8);
+    m_hash = readValue(data + 28, 8);
+
+    if (version != VERSION || count == 0 || tileSize == 0 || tileSize > 0xFFFF || alignment == 0
+        || m_pixelOffset % alignment != 0 || m_pixelOffset < HEADER_SIZE + 4ULL * count)
+    {
+        throw invalid_argument("Tile pack header is malformed");
+    }
+
+    // Blobs are rounded up to the alignment the pack was written with, whatever this build writes
+    m_blobStride = ((unsigned long long) tileSize * tileSize * 3 + alignment - 1) / alignment * alignment;
+
+    if (m_pixelOffset > size || (size - m_pixelOffset) / m_blobStride < count)
+    {
+        throw invalid_argument("Tile pack is truncated");
+    }
+
+    m_tileSize = (int) tileSize;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const unsigned char* sides = data + HEADER_SIZE + 4 * i;
+        vector<char> codes(sides, sides + 4);
+        BMPFile image(m_mapping, data + m_pixelOffset + i * m_blobStride, m_tileSize, m_tileSize);
+
+        m_tiles.push_back(Tile(move(image), move(codes)));
+    }
+}
+
+/**
+ * Gets the tiles of the pack, in the order they were written
+ * @return The tiles
+ */
+vector<Tile>& TilePack::getTiles()
+{
+    return m_tiles;
+}
+
+/**
+ * Gets the side length shared by every tile of the pack
+ * @return The tile size
+ */
+int TilePack::getTileSize()
+{
+    return m_tileSize;
+}
+
+/**
+ * Gets the hash of the codes and pixels of the pack, as written in its header
+ * @return The hash
+ */
+unsigned long long TilePack::getHash()
+{
+    return m_hash;
+}
+
+/**
+ * Checks the codes and pixels of the pack against the hash in its header. This reads the whole pack, so it is left to
+ * the caller to decide when it is worth it, rather than done on every load.
+ *
+ * @return True if the contents match the hash
+ */
+bool TilePack::verify()
+{
+    trace::Scope scope("verify pack");
+    const unsigned char* data = m_mapping->getData();
+    long long blobSize = (long long) m_tileSize * m_tileSize * 3;
+    unsigned long long hash = hashBytes(HASH_BASIS, data + HEADER_SIZE, 4LL * m_tiles.size());
+
+    for (size_t i = 0; i < m_tiles.size(); i++)
+    {
+        hash = hashBytes(hash, data + m_pixelOffset + i * m_blobStride, blobSize);
+    }
+
+    return hash == m_hash;
+}
+
+/**
+ * Gets the distance from the start of one pixel blob to the next
+ *
+ * @param tileSize The side length of the tiles
+ * @return The size of a blob, rounded up to the alignment
+ */
+unsigned long long TilePack::getBlobStride(int tileSize)
+{
+    return ((unsigned long long) tileSize * tileSize * 3 + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+/**
+ * Writes the given tile set to a pack file
+ *
+ * @param tiles The tiles to write, which must all be the same size
+ * @param fileName The name of the file to save to
+ * @throws invalid_argument If there are no tiles, their sizes differ, or the file cannot be written
+ */
+void TilePack::writeFile(vector<Tile>& tiles, const char* fileName)
+{
+    trace::Scope scope("write pack");
+    if (tiles.empty())
+    {
+        throw invalid_argument("Tile pack must hold at least one tile");
+    }
+
+    int tileSize = tiles[0].getDimension();
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        RGBPlane* plane = tiles[i].getImage().getPlane();
+
+        if (plane->getWidth() != tileSize || plane->getHeight() != tileSize)
+        {
+            throw invalid_argument("Every tile of a pack must be the same size");
+        }
+    }
+
+    FILE* file = fopen(fileName, "wb");
+
+    if (file == NULL)
+    {
+        throw invalid_argument("Could not open tile pack for writing");
+    }
+
+    size_t blobSize = (size_t) tileSize * tileSize * 3;
+    size_t stride = getBlobStride(tileSize);
+    size_t codesEnd = HEADER_SIZE + 4 * tiles.size();
+    size_t pixelOffset = (codesEnd + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    vector<unsigned char> padding(ALIGNMENT, 0);
+    vector<unsigned char> codes;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            codes.push_back((unsigned char) tiles[i].getCodeAtSide(side));
+        }
+    }
+
+    // The hash is filled in once the pixels have been written
+    bool written = fwrite("WTPK", 1, 4, file) == 4 && writeValue(file, VERSION, 4)
+                   && writeValue(file, tiles.size(), 4) && writeValue(file, tileSize, 4)
+                   && writeValue(file, ALIGNMENT, 4) && writeValue(file, pixelOffset, 8) && writeValue(file, 0, 8)
+                   && fwrite(codes.data(), 1, codes.size(), file) == codes.size()
+                   && fwrite(padding.data(), 1, pixelOffset - codesEnd, file) == pixelOffset - codesEnd;
+
+    unsigned long long hash = hashBytes(HASH_BASIS, codes.data(), codes.size());
+
+    for (size_t i = 0; i < tiles.size() && written; i++)
+    {
+        const unsigned char* pixels = tiles[i].getImage().getPlane()->getRawData();
+
+        hash = hashBytes(hash, pixels, blobSize);
+        written = fwrite(pixels, 1, blobSize, file) == blobSize
+                  && fwrite(padding.data(), 1, stride - blobSize, file) == stride - blobSize;
+    }
+
+    written = written && fseek(file, 28, SEEK_SET) == 0 && writeValue(file, hash, 8);
+
+    if (fclose(file) != 0 || !written)
+    {
+        throw invalid_argument("Could not write tile pack");
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ * The TilePack class reads and writes a whole tile set as a single pack file, which is memory mapped when it is read
+ * so that a set can be loaded without decoding (or even reading) any of its pixels.
+ *
+ * The pack is little endian:
+ *
+ *   "WTPK", version (1), tile count, tile size, alignment (all 32 bit), then the offset of the first pixel blob and a
+ *   64 bit FNV-1a hash of the codes and pixels (both 64 bit), then the N, E, S, W codes of each tile (4 bytes each)
+ *
+ * followed by one pixel blob per tile, each starting on a multiple of the alignment. A blob holds the R, G, B values
+ * of its tile row by row from the bottom, exactly as an RGBPlane holds them, so tiles read from a pack use the mapped
+ * blobs as their planes directly.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/01/17
+ */
+
+#ifndef WANGTILE_TILEPACK_H
+#define WANGTILE_TILEPACK_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "MappedFile.h"
+#include "Tile.h"
+
+using namespace std;
+
+class TilePack
+{
+private:
+    shared_ptr<MappedFile> m_mapping;
+    vector<Tile> m_tiles;
+    int m_tileSize;
+    unsigned long long m_pixelOffset;
+    unsigned long long m_blobStride;
+    unsigned long long m_hash;
+
+    static unsigned long long getBlobStride(int);
+
+public:
+    const static int VERSION = 1;
+    const static int ALIGNMENT = 64;
+    const static int HEADER_SIZE = 36;
+
+    TilePack(const char*);
+    vector<Tile>& getTiles();
+    int getTileSize();
+    unsigned long long getHash();
+    bool verify();
+
+    static void writeFile(vector<Tile>&, const char*);
+};
+
+#endif //WANGTILE_TILEPACK_H
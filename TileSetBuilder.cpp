@@ -0,0 +1,332 @@
+/**
+ * The TileSetBuilder class synthesizes a whole set of Wang Tiles from one exemplar image. The exemplar is split into
+ * one square patch per edge colour, and each tile is cut from a 2x2 quilt of the patches of its four edge colours.
+ *
+ * Edge colours are given per axis, with the north and south edges drawing from one set of colours and the east and
+ * west edges from another. With 2 colours per axis, the 8 tile set has two tiles for every north and west pair and the
+ * complete set has all 16 tiles; with 3 colours per axis only the complete 81 tile set is made.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/31/17
+ */
+
+#include <memory>
+#include <stdexcept>
+#include "TileSetBuilder.h"
+#include "Quilt.h"
+#include "Trace.h"
+
+const char TileSetBuilder::NORTH_SOUTH_CODES[3] = {Patch::CODE_R, Patch::CODE_G, Patch::CODE_M};
+const char TileSetBuilder::EAST_WEST_CODES[3] = {Patch::CODE_Y, Patch::CODE_B, Patch::CODE_C};
+
+/**
+ * Creates the builder with the largest patch size that fits one patch per edge colour in the source
+ *
+ * @param source The exemplar image to make the tiles from
+ * @param colours The number of edge colours per axis, 2 or 3
+ * @param complete True to make every combination of edge colours, false for the 8 tile set (2 colours only)
+ * @see TileSetBuilder::getLargestPatchSize
+ */
+TileSetBuilder::TileSetBuilder(BMPFile& source, int colours, bool complete)
+ : TileSetBuilder(source, colours, complete, getLargestPatchSize(source, colours)) {
+}
+
+/**
+ * Creates the builder, extracting the patch of every edge colour from the source. The patches are taken from a grid of
+ * patchSize blocks over the source, in row-major order: red, yellow, blue, green, then magenta and cyan for 3 colours.
+ *
+ * @param source The exemplar image to make the tiles from
+ * @param colours The number of edge colours per axis, 2 or 3
+ * @param complete True to make every combination of edge colours, false for the 8 tile set (2 colours only)
+ * @param patchSize The side length of each patch
+ * @throws invalid_argument If the colour count is not supported, or the source does not hold a patch per colour
+ */
+TileSetBuilder::TileSetBuilder(BMPFile& source, int colours, bool complete, int patchSize)
+ : m_source(source) {
+    if (colours != 2 && !(colours == 3 && complete))
+    {
+        throw invalid_argument("Tile sets are made with 2 colours per axis, or 3 for a complete set");
+    }
+
+    if (patchSize < MIN_PATCH_SIZE
+        || (long long) (source.getWidth() / patchSize) * (source.getHeight() / patchSize) < 2 * colours)
+    {
+        throw invalid_argument("Source image must hold a patch of at least the minimum size for every edge colour");
+    }
+
+    m_colours = colours;
+    m_complete = complete;
+    m_patchSize = patchSize;
+    m_pool = new ThreadPool(0);
+
+    extractPatches();
+}
+
+TileSetBuilder::~TileSetBuilder()
+{
+    for (int i = 0; i < m_colours; i++)
+    {
+        delete m_northSouthPatches[i];
+        delete m_eastWestPatches[i];
+    }
+
+    delete m_pool;
+}
+
+/**
+ * Extracts the patch of every edge colour from the grid of blocks over the source
+ */
+void TileSetBuilder::extractPatches()
+{
+    const char order[6] = {Patch::CODE_R, Patch::CODE_Y, Patch::CODE_B, Patch::CODE_G, Patch::CODE_M, Patch::CODE_C};
+    int columns = m_source.getWidth() / m_patchSize;
+
+    for (int i = 0; i < 2 * m_colours; i++)
+    {
+        int x = (i % columns) * m_patchSize;
+        int y = (i / columns) * m_patchSize;
+        Patch* patch = Quilt::getPatchFromSourceAt(m_source, m_patchSize, x, y, x + m_patchSize - 1,
+                                                   y + m_patchSize - 1, order[i]);
+
+        if (i == 0 || i == 3 || i == 4)
+        {
+            m_northSouthPatches.push_back(patch);
+        }
+        else
+        {
+            m_eastWestPatches.push_back(patch);
+        }
+    }
+}
+
+/**
+ * Gets the patch of the given edge colour
+ *
+ * @param code The code of the edge colour
+ * @return The patch, shared by every tile with that colour
+ * @throws invalid_argument If no patch has that code
+ */
+Patch* TileSetBuilder::getPatch(char code)
+{
+    for (int i = 0; i < m_colours; i++)
+    {
+        if (m_northSouthPatches[i]->getCode() == code)
+        {
+            return m_northSouthPatches[i];
+        }
+
+        if (m_eastWestPatches[i]->getCode() == code)
+        {
+            return m_eastWestPatches[i];
+        }
+    }
+
+    throw invalid_argument("No patch has the given code");
+}
+
+/**
+ * Gets the side codes of every tile of the set, in the order they are built
+ *
+ * @return The N, E, S, W codes of each tile
+ */
+vector<vector<char>> TileSetBuilder::getTileCodes()
+{
+    vector<vector<char>> codes;
+
+    if (!m_complete)
+    {
+        // Each north and west pair gets two tiles that differ in both their south and east, so a tiling always has a
+        // choice to make at every cell
+        char r = NORTH_SOUTH_CODES[0];
+        char g = NORTH_SOUTH_CODES[1];
+        char y = EAST_WEST_CODES[0];
+        char b = EAST_WEST_CODES[1];
+
+        codes = {{r, y, g, b}, {g, b, g, b}, {r, y, r, y}, {g, b, r, y},
+                 {r, b, g, y}, {g, y, g, y}, {r, b, r, b}, {g, y, r, b}};
+
+        return codes;
+    }
+
+    for (int n = 0; n < m_colours; n++)
+    {
+        for (int e = 0; e < m_colours; e++)
+        {
+            for (int s = 0; s < m_colours; s++)
+            {
+                for (int w = 0; w < m_colours; w++)
+                {
+                    codes.push_back({NORTH_SOUTH_CODES[n], EAST_WEST_CODES[e], NORTH_SOUTH_CODES[s], EAST_WEST_CODES[w]});
+                }
+            }
+        }
+    }
+
+    return codes;
+}
+
+/**
+ * Gets the number of tiles in the set
+ * @return 8 for the 8 tile set, otherwise the number of colours per axis to the fourth power
+ */
+int TileSetBuilder::getTileCount()
+{
+    return m_complete ? m_colours * m_colours * m_colours * m_colours : 8;
+}
+
+/**
+ * Gets the side length of the patches the tiles are quilted from
+ * @return The patch size
+ */
+int TileSetBuilder::getPatchSize()
+{
+    return m_patchSize;
+}
+
+/**
+ * Sets the number of threads the tiles are built with
+ *
+ * @param threads The number of threads, or 0 to use one per hardware thread
+ */
+void TileSetBuilder::setThreadCount(int threads)
+{
+    delete m_pool;
+    m_pool = new ThreadPool(threads);
+}
+
+/**
+ * Builds every tile of the set. Tiles are built in parallel, each from its own quilt, and the quilts run their cuts on
+ * the same pool so no core is left idle once fewer tiles than threads remain. The copies of the patches each quilt
+ * works on are carved from an arena of the builder, which is reset as soon as the tile is done, so only the tiles
+ * being built at any one time hold patch memory.
+ *
+ * @return The tiles, in the order of getTileCodes
+ */
+vector<Tile> TileSetBuilder::build()
+{
+    trace::Scope scope("build tile set");
+    vector<vector<char>> codes = getTileCodes();
+    vector<unique_ptr<Tile>> tiles(codes.size());
+
+    m_pool->parallelFor(codes.size(), [&](int i)
+    {
+        trace::Scope tileScope("build tile");
+        const vector<char>& sides = codes[i];
+
+        Arena* arena = acquireArena();
+
+        // Laid out by rows from the bottom of the quilt, so that each patch lands on the edge of the tile that takes
+        // its colour (see Quilt::getTile): west and south below, north and east above. The quilt writes its error and
+        // cuts into its patches, so it is given copies of the shared ones
+        vector<Patch*> patches = {new Patch(*getPatch(sides[Tile::WEST]), *arena),
+                                  new Patch(*getPatch(sides[Tile::SOUTH]), *arena),
+                                  new Patch(*getPatch(sides[Tile::NORTH]), *arena),
+                                  new Patch(*getPatch(sides[Tile::EAST]), *arena)};
+
+        {
+            Quilt quilt(m_source, 2, patches, m_pool);
+
+            quilt.makeSeamsAndQuilt();
+            tiles[i].reset(new Tile(quilt.getTile()));
+        }
+
+        for (size_t j = 0; j < patches.size(); j++)
+        {
+            delete patches[j];
+        }
+
+        releaseArena(arena);
+
+        trace::count("tiles built", 1);
+    });
+
+    vector<Tile> set;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        set.push_back(move(*tiles[i]));
+    }
+
+    return set;
+}
+
+/**
+ * Takes a free arena for the patches of one tile, making a new one if every arena is in use. There are only ever as
+ * many arenas as tiles built at once
+ *
+ * @return The arena, which is empty
+ */
+Arena* TileSetBuilder::acquireArena()
+{
+    lock_guard<mutex> guard(m_arenaLock);
+
+    if (m_freeArenas.empty())
+    {
+        m_arenas.push_back(unique_ptr<Arena>(new Arena()));
+        return m_arenas.back().get();
+    }
+
+    Arena* arena = m_freeArenas.back();
+
+    m_freeArenas.pop_back();
+
+    return arena;
+}
+
+/**
+ * Resets an arena once the patches of its tile are deleted, and gives it back for the next tile
+ *
+ * @param arena The arena, from acquireArena
+ */
+void TileSetBuilder::releaseArena(Arena* arena)
+{
+    arena->reset();
+
+    lock_guard<mutex> guard(m_arenaLock);
+
+    m_freeArenas.push_back(arena);
+}
+
+/**
+ * Gets the stats of every arena the patches of the tiles are carved from, added together. The high-water mark is the
+ * sum of that of each arena, so it is an upper bound of the patch memory the builder ever held at once
+ *
+ * @return The combined stats
+ */
+Arena::Stats TileSetBuilder::getArenaStats()
+{
+    lock_guard<mutex> guard(m_arenaLock);
+    Arena::Stats total = Arena::Stats();
+
+    for (size_t i = 0; i < m_arenas.size(); i++)
+    {
+        Arena::Stats stats = m_arenas[i]->getStats();
+
+        total.allocations += stats.allocations;
+        total.bytesInUse += stats.bytesInUse;
+        total.highWaterMark += stats.highWaterMark;
+        total.bytesReserved += stats.bytesReserved;
+        total.blocks += stats.blocks;
+    }
+
+    return total;
+}
+
+/**
+ * Gets the largest patch size for which a grid of patches over the source holds one patch per edge colour
+ *
+ * @param source The exemplar image
+ * @param colours The number of edge colours per axis
+ * @return The patch size
+ */
+int TileSetBuilder::getLargestPatchSize(BMPFile& source, int colours)
+{
+    int size = min(source.getWidth(), source.getHeight());
+
+    while (size > 1 && (long long) (source.getWidth() / size) * (source.getHeight() / size) < 2 * colours)
+    {
+        size--;
+    }
+
+    return size;
+}
@@ -0,0 +1,67 @@
+/**
+ * The TileSetBuilder class synthesizes a whole set of Wang Tiles from one exemplar image. The exemplar is split into
+ * one square patch per edge colour, and each tile is cut from a 2x2 quilt of the patches of its four edge colours.
+ *
+ * Edge colours are given per axis, with the north and south edges drawing from one set of colours and the east and
+ * west edges from another. With 2 colours per axis, the 8 tile set has two tiles for every north and west pair and the
+ * complete set has all 16 tiles; with 3 colours per axis only the complete 81 tile set is made.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 03/31/17
+ */
+
+#ifndef WANGTILE_TILESETBUILDER_H
+#define WANGTILE_TILESETBUILDER_H
+
+#include "BMPFile.h"
+#include "Patch.h"
+#include "Tile.h"
+#include "ThreadPool.h"
+#include "Arena.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+class TileSetBuilder
+{
+private:
+    BMPFile& m_source;
+    int m_colours;
+    bool m_complete;
+    int m_patchSize;
+    vector<Patch*> m_northSouthPatches;
+    vector<Patch*> m_eastWestPatches;
+    ThreadPool* m_pool;
+    vector<unique_ptr<Arena>> m_arenas;
+    vector<Arena*> m_freeArenas;
+    mutex m_arenaLock;
+
+    void extractPatches();
+    Patch* getPatch(char);
+    Arena* acquireArena();
+    void releaseArena(Arena*);
+
+public:
+    const static int MIN_PATCH_SIZE = 32;
+    const static char NORTH_SOUTH_CODES[3];
+    const static char EAST_WEST_CODES[3];
+
+    TileSetBuilder(BMPFile&, int, bool);
+    TileSetBuilder(BMPFile&, int, bool, int);
+    TileSetBuilder(const TileSetBuilder&) = delete;
+    TileSetBuilder& operator=(const TileSetBuilder&) = delete;
+    vector<vector<char>> getTileCodes();
+    int getTileCount();
+    int getPatchSize();
+    void setThreadCount(int);
+    vector<Tile> build();
+    Arena::Stats getArenaStats();
+
+    static int getLargestPatchSize(BMPFile&, int);
+
+    virtual ~TileSetBuilder();
+};
+
+#endif //WANGTILE_TILESETBUILDER_H
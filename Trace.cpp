@@ -0,0 +1,304 @@
+/**
+ * Houses the instrumentation of the synthesizer: scoped timers around each phase (extraction, candidate scoring, seam
+ * cutting, compositing, rotation, I/O) and named counters, which can be exported as a Chrome trace (chrome://tracing,
+ * or Perfetto) or summed up into a table.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/04/17
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Trace.h"
+
+namespace trace
+{
+    struct Event
+    {
+        const char* name;
+        long long start;
+        long long end;
+    };
+
+    // The events and counters of one thread. Buffers are never freed, so they outlive the pool threads that fill them
+    struct Buffer
+    {
+        int thread;
+        vector<Event> events;
+        vector<pair<const char*, long long>> counters;
+    };
+
+    atomic<bool> enabled(false);
+
+    static const chrono::steady_clock::time_point g_origin = chrono::steady_clock::now();
+    static mutex g_lock;
+    static vector<unique_ptr<Buffer>> g_buffers;
+    static thread_local Buffer* t_buffer = nullptr;
+
+    /**
+     * Gets the buffer of the calling thread, registering it the first time the thread records anything
+     * @return The buffer
+     */
+    static Buffer& getBuffer()
+    {
+        if (t_buffer == nullptr)
+        {
+            lock_guard<mutex> guard(g_lock);
+
+            g_buffers.push_back(unique_ptr<Buffer>(new Buffer()));
+            t_buffer = g_buffers.back().get();
+            t_buffer->thread = (int) g_buffers.size();
+        }
+
+        return *t_buffer;
+    }
+
+    /**
+     * Turns recording on or off. Events already recorded are kept either way
+     * @param on True to record events
+     */
+    void setEnabled(bool on)
+    {
+        enabled.store(on, memory_order_relaxed);
+    }
+
+    /**
+     * Gets the current time of the trace clock
+     * @return The nanoseconds since the program started
+     */
+    long long now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - g_origin).count();
+    }
+
+    /**
+     * Records a timed event on the calling thread
+     *
+     * @param name The name of the event
+     * @param start The time it started, from now()
+     * @param end The time it ended, from now()
+     */
+    void record(const char* name, long long start, long long end)
+    {
+        getBuffer().events.push_back({name, start, end});
+    }
+
+    /**
+     * Adds to a named counter on the calling thread
+     *
+     * @param name The name of the counter
+     * @param amount The amount to add
+     */
+    void add(const char* name, long long amount)
+    {
+        vector<pair<const char*, long long>>& counters = getBuffer().counters;
+
+        // Only a handful of counters exist, and a name is nearly always the very same literal
+        for (size_t i = 0; i < counters.size(); i++)
+        {
+            if (counters[i].first == name)
+            {
+                counters[i].second += amount;
+                return;
+            }
+        }
+
+        counters.push_back(make_pair(name, amount));
+    }
+
+    /**
+     * Discards every event and counter recorded so far
+     */
+    void reset()
+    {
+        lock_guard<mutex> guard(g_lock);
+
+        for (size_t i = 0; i < g_buffers.size(); i++)
+        {
+            g_buffers[i]->events.clear();
+            g_buffers[i]->counters.clear();
+        }
+    }
+
+    /**
+     * Sums every thread's counters by name, as the same name may be a different literal in each translation unit
+     * @return The total of each counter
+     */
+    static map<string, long long> getCounterTotals()
+    {
+        map<string, long long> totals;
+
+        for (size_t i = 0; i < g_buffers.size(); i++)
+        {
+            for (size_t j = 0; j < g_buffers[i]->counters.size(); j++)
+            {
+                totals[g_buffers[i]->counters[j].first] += g_buffers[i]->counters[j].second;
+            }
+        }
+
+        return totals;
+    }
+
+    /**
+     * Writes a string as a JSON string literal
+     */
+    static void writeString(FILE* file, const string& text)
+    {
+        fputc('"', file);
+
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '"' || text[i] == '\\')
+            {
+                fputc('\\', file);
+            }
+
+            fputc(text[i], file);
+        }
+
+        fputc('"', file);
+    }
+
+    /**
+     * Writes everything recorded so far in the Chrome trace event format: one complete event per timed scope on the
+     * lane of the thread that ran it, and the final value of each counter at the end of the trace
+     *
+     * @param fileName The name of the JSON file to save to
+     * @throws invalid_argument If the file cannot be written
+     */
+    void writeChromeTrace(const char* fileName)
+    {
+        lock_guard<mutex> guard(g_lock);
+        FILE* file = fopen(fileName, "w");
+
+        if (file == NULL)
+        {
+            throw invalid_argument("Could not open trace file for writing");
+        }
+
+        long long last = 0;
+        const char* separator = "\n";
+
+        fprintf(file, "{\"traceEvents\": [");
+
+        for (size_t i = 0; i < g_buffers.size(); i++)
+        {
+            Buffer& buffer = *g_buffers[i];
+
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                          "\"args\": {\"name\": \"thread %d\"}}", separator, buffer.thread, buffer.thread);
+            separator = ",\n";
+
+            for (size_t j = 0; j < buffer.events.size(); j++)
+            {
+                Event& event = buffer.events[j];
+
+                fprintf(file, ",\n{\"name\": ");
+                writeString(file, event.name);
+                fprintf(file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}", buffer.thread,
+                        event.start / 1000.0, (event.end - event.start) / 1000.0);
+                last = max(last, event.end);
+            }
+        }
+
+        map<string, long long> counters = getCounterTotals();
+
+        for (map<string, long long>::iterator it = counters.begin(); it != counters.end(); ++it)
+        {
+            fprintf(file, "%s{\"name\": ", separator);
+            writeString(file, it->first);
+            fprintf(file, ", \"ph\": \"C\", \"pid\": 1, \"ts\": %.3f, \"args\": {\"value\": %lld}}", last / 1000.0,
+                    it->second);
+            separator = ",\n";
+        }
+
+        fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+        if (fclose(file) != 0)
+        {
+            throw invalid_argument("Could not write trace file");
+        }
+    }
+
+    /**
+     * Writes a table of every phase recorded so far, slowest first, followed by the counters. Phases nest and run on
+     * several threads at once, so their totals are time spent by threads, which can add up to more than the run took.
+     *
+     * @param out The stream to write to
+     */
+    void writeSummary(ostream& out)
+    {
+        struct Phase
+        {
+            string name;
+            long long calls;
+            long long total;
+            long long longest;
+        };
+
+        lock_guard<mutex> guard(g_lock);
+        map<string, Phase> phases;
+
+        for (size_t i = 0; i < g_buffers.size(); i++)
+        {
+            for (size_t j = 0; j < g_buffers[i]->events.size(); j++)
+            {
+                Event& event = g_buffers[i]->events[j];
+                Phase& phase = phases[event.name];
+                long long duration = event.end - event.start;
+
+                phase.name = event.name;
+                phase.calls++;
+                phase.total += duration;
+                phase.longest = max(phase.longest, duration);
+            }
+        }
+
+        vector<Phase> sorted;
+
+        for (map<string, Phase>::iterator it = phases.begin(); it != phases.end(); ++it)
+        {
+            sorted.push_back(it->second);
+        }
+
+        sort(sorted.begin(), sorted.end(), [](const Phase& a, const Phase& b)
+        {
+            return a.total > b.total;
+        });
+
+        char line[256];
+
+        snprintf(line, sizeof(line), "%-24s %10s %12s %12s %12s\n", "phase", "calls", "total ms", "mean us", "max us");
+        out << line;
+
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            snprintf(line, sizeof(line), "%-24s %10lld %12.2f %12.1f %12.1f\n", sorted[i].name.c_str(),
+                     sorted[i].calls, sorted[i].total / 1e6, sorted[i].total / 1e3 / sorted[i].calls,
+                     sorted[i].longest / 1e3);
+            out << line;
+        }
+
+        map<string, long long> counters = getCounterTotals();
+
+        if (!counters.empty())
+        {
+            snprintf(line, sizeof(line), "\n%-24s %10s\n", "counter", "value");
+            out << line;
+        }
+
+        for (map<string, long long>::iterator it = counters.begin(); it != counters.end(); ++it)
+        {
+            snprintf(line, sizeof(line), "%-24s %10lld\n", it->first.c_str(), it->second);
+            out << line;
+        }
+    }
+};
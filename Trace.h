@@ -0,0 +1,90 @@
+/**
+ * Houses the instrumentation of the synthesizer: scoped timers around each phase (extraction, candidate scoring, seam
+ * cutting, compositing, rotation, I/O) and named counters, which can be exported as a Chrome trace (chrome://tracing,
+ * or Perfetto) or summed up into a table.
+ *
+ * Nothing is recorded until tracing is enabled. While it is off, a Scope or count costs a single relaxed load of the
+ * enabled flag. Events are kept per thread, so recording never takes a lock, and must only be exported or reset once
+ * the work being traced has finished.
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/04/17
+ */
+
+#ifndef WANGTILE_TRACE_H
+#define WANGTILE_TRACE_H
+
+#include <atomic>
+#include <ostream>
+
+using namespace std;
+
+namespace trace
+{
+    extern atomic<bool> enabled;
+
+    void setEnabled(bool);
+    long long now();
+    void record(const char*, long long, long long);
+    void add(const char*, long long);
+    void reset();
+    void writeChromeTrace(const char*);
+    void writeSummary(ostream&);
+
+    /**
+     * Whether events are being recorded
+     * @return True if tracing is enabled
+     */
+    inline bool isEnabled()
+    {
+        return enabled.load(memory_order_relaxed);
+    }
+
+    /**
+     * Adds to a named counter, if tracing is enabled
+     *
+     * @param name The name of the counter, which must be a string literal (or otherwise outlive the trace)
+     * @param amount The amount to add
+     */
+    inline void count(const char* name, long long amount)
+    {
+        if (isEnabled())
+        {
+            add(name, amount);
+        }
+    }
+
+    /**
+     * Times the block of code it is declared in, from its construction to the end of the block, as one event
+     */
+    class Scope
+    {
+    private:
+        const char* m_name;
+        long long m_start;
+
+    public:
+        /**
+         * Starts timing the block, if tracing is enabled
+         * @param name The name of the event, which must be a string literal (or otherwise outlive the trace)
+         */
+        Scope(const char* name)
+        {
+            m_name = name;
+            m_start = isEnabled() ? now() : -1;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            if (m_start >= 0)
+            {
+                record(m_name, m_start, now());
+            }
+        }
+    };
+};
+
+#endif //WANGTILE_TRACE_H
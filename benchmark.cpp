@@ -0,0 +1,434 @@
+/**
+ * Micro-benchmarks of the synthesis kernels, built as its own executable from every source file except main.cpp and
+ * tests.cpp.
+ *
+ * Each kernel is swept over patch sizes (16 to 128) or source sizes (256 to 4096), and run until it has taken at least
+ * the minimum time. For each case the time per operation, the bytes (and number of blocks) allocated per operation,
+ * and the throughput in megapixels per second are reported. Sources are generated, so no input files are needed.
+ *
+ * usage: benchmark [--filter text] [--min-time seconds] [--max-source size] [--threads T]
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/03/17
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include "BMPFile.h"
+#include "Patch.h"
+#include "Quilt.h"
+#include "TileMap.h"
+
+using namespace std;
+
+static atomic<long long> g_allocations(0);
+static atomic<long long> g_allocatedBytes(0);
+
+// Kept out of line, as GCC mistakes the malloc and free of inlined copies for a mismatched new and delete
+#if defined(__GNUC__)
+#define OUT_OF_LINE __attribute__((noinline))
+#else
+#define OUT_OF_LINE
+#endif
+
+// Every allocation made through new is counted, whichever thread makes it
+OUT_OF_LINE void* operator new(size_t size)
+{
+    void* block = malloc(size == 0 ? 1 : size);
+
+    if (block == nullptr)
+    {
+        throw bad_alloc();
+    }
+
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, memory_order_relaxed);
+
+    return block;
+}
+
+OUT_OF_LINE void operator delete(void* block) noexcept
+{
+    free(block);
+}
+
+OUT_OF_LINE void operator delete(void* block, size_t) noexcept
+{
+    free(block);
+}
+
+static const int PATCH_SIZES[] = {16, 32, 64, 128};
+static const int SOURCE_SIZES[] = {256, 512, 1024, 2048, 4096};
+static const char* FILTER_NAMES[] = {"nearest", "bilinear", "bicubic"};
+static const RGBPlane::Layout LAYOUTS[] = {RGBPlane::INTERLEAVED, RGBPlane::PLANAR};
+
+static string g_filter;
+static double g_minTime = 0.25;
+static int g_maxSource = 4096;
+static int g_threads = 0;
+
+/**
+ * Times an operation and prints its line of the report. The operation is run in batches that double in size until a
+ * batch takes at least the minimum time, and that last batch is the one reported.
+ *
+ * @param name The name of the kernel
+ * @param parameters The parameters of this case (such as the patch size)
+ * @param pixels The number of pixels one operation processes, for the throughput
+ * @param operation Runs the operation once
+ */
+static void measure(const string& name, const string& parameters, long long pixels, const function<void()>& operation)
+{
+    string label = name + "/" + parameters;
+
+    if (label.find(g_filter) == string::npos)
+    {
+        return;
+    }
+
+    // Warm up the caches and any scratch buffers first
+    operation();
+
+    long long iterations = 1;
+    double elapsed = 0;
+    long long allocations = 0;
+    long long allocatedBytes = 0;
+
+    while (true)
+    {
+        long long allocationsBefore = g_allocations.load();
+        long long bytesBefore = g_allocatedBytes.load();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (long long i = 0; i < iterations; i++)
+        {
+            operation();
+        }
+
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocations = g_allocations.load() - allocationsBefore;
+        allocatedBytes = g_allocatedBytes.load() - bytesBefore;
+
+        if (elapsed >= g_minTime)
+        {
+            break;
+        }
+
+        iterations *= 2;
+    }
+
+    double nanoseconds = elapsed * 1e9 / iterations;
+
+    printf("%-28s %-24s %10lld %14.0f %14.0f %10.1f %10.2f\n", name.c_str(), parameters.c_str(), iterations,
+           nanoseconds, (double) allocatedBytes / iterations, (double) allocations / iterations,
+           pixels / (nanoseconds / 1e9) / 1e6);
+    fflush(stdout);
+}
+
+/**
+ * Makes a square source image of smooth, repeating noise, so that overlaps have realistic rather than flat errors
+ *
+ * @param size The side length of the image
+ * @return The image
+ */
+static RGBPlane* makeSource(int size)
+{
+    RGBPlane* plane = new RGBPlane(size, size);
+    default_random_engine generator(size);
+    uniform_int_distribution<int> noise(0, 63);
+
+    for (int y = 0; y < size; y++)
+    {
+        unsigned char* row = plane->getRow(y);
+
+        for (int x = 0; x < size; x++)
+        {
+            row[x * 3] = (unsigned char) (((x * 7) ^ (y * 3)) % 192 + noise(generator));
+            row[x * 3 + 1] = (unsigned char) (((x + y) * 5) % 192 + noise(generator));
+            row[x * 3 + 2] = (unsigned char) ((x * y) % 192 + noise(generator));
+        }
+    }
+
+    return plane;
+}
+
+/**
+ * Gets a patch of the given source, with its origin at the given offset along both axes
+ */
+static Patch* makePatch(RGBPlane& source, int size, int offset)
+{
+    return new Patch(PatchView(source, offset, offset, size), Patch::CODE_R);
+}
+
+static string sizeParameter(const string& name, int size)
+{
+    return name + "=" + to_string(size);
+}
+
+/**
+ * Gets the suffix of the cases run on planes of the given layout. Interleaved cases have none, so they keep the names
+ * they had before there was a choice
+ */
+static string layoutParameter(RGBPlane::Layout layout)
+{
+    return layout == RGBPlane::PLANAR ? ",planar" : "";
+}
+
+/**
+ * The kernels of a single patch: scoring its overlap, cutting through it, and both together, in both layouts
+ */
+static void benchmarkPatches()
+{
+    RGBPlane* interleaved = makeSource(512);
+    RGBPlane planar = interleaved->toLayout(RGBPlane::PLANAR);
+
+    for (RGBPlane::Layout layout : LAYOUTS)
+    {
+        for (int size : PATCH_SIZES)
+        {
+            RGBPlane* source = layout == RGBPlane::PLANAR ? &planar : interleaved;
+            Patch* left = makePatch(*source, size, 0);
+            Patch* top = makePatch(*source, size, size);
+            Patch* patch = makePatch(*source, size, 2 * size);
+            string parameters = sizeParameter("patch", size) + layoutParameter(layout);
+            long long pixels = (long long) size * size;
+
+            measure("Patch::getOverlapScore", parameters, pixels, [&]()
+            {
+                patch->getOverlapScore(left, top);
+            });
+
+            patch->getOverlapScore(left, top);
+
+            measure("Patch::getVerticalCut", parameters, pixels, [&]()
+            {
+                patch->getVerticalCut();
+            });
+
+            measure("Patch::getHorizontalCut", parameters, pixels, [&]()
+            {
+                patch->getHorizontalCut();
+            });
+
+            measure("Patch::calculateLeastCost", parameters, pixels, [&]()
+            {
+                patch->calculateLeastCostBoundaries(left, top);
+            });
+
+            delete left;
+            delete top;
+            delete patch;
+        }
+    }
+
+    delete interleaved;
+}
+
+/**
+ * Choosing the best fitting patch for a cell with both a left and a top neighbour, over every source and patch size.
+ * Candidates are sampled every 4 pixels, so the candidate count (and the way they are searched) grows with the source
+ */
+static void benchmarkGetPatch()
+{
+    for (int sourceSize : SOURCE_SIZES)
+    {
+        if (sourceSize > g_maxSource)
+        {
+            continue;
+        }
+
+        RGBPlane* plane = makeSource(sourceSize);
+        BMPFile source(*plane);
+        RGBPlane planar = plane->toLayout(RGBPlane::PLANAR);
+
+        for (RGBPlane::Layout layout : LAYOUTS)
+        {
+            for (int size : PATCH_SIZES)
+            {
+                RGBPlane* neighbours = layout == RGBPlane::PLANAR ? &planar : source.getPlane();
+                Quilt quilt(source, 2, size, 4, layout);
+                Patch* left = makePatch(*neighbours, size, 0);
+                Patch* top = makePatch(*neighbours, size, size);
+                default_random_engine generator(1);
+
+                quilt.setThreadCount(g_threads);
+
+                measure("Quilt::getPatch", sizeParameter("source", sourceSize) + "," + sizeParameter("patch", size)
+                        + layoutParameter(layout), (long long) size * size, [&]()
+                {
+                    delete quilt.getPatch(left, top, generator);
+                    quilt.getArena().reset();
+                });
+
+                delete left;
+                delete top;
+            }
+        }
+
+        delete plane;
+    }
+}
+
+/**
+ * The whole-image kernels: cutting out a region, rotating, and reading and writing BMP files
+ */
+static void benchmarkImages()
+{
+    string fileName = "benchmark_" + to_string(rand()) + ".bmp";
+
+    for (int size : SOURCE_SIZES)
+    {
+        if (size > g_maxSource)
+        {
+            continue;
+        }
+
+        RGBPlane* plane = makeSource(size);
+        string parameters = sizeParameter("source", size);
+        long long pixels = (long long) size * size;
+
+        measure("RGBPlane::getRegion", parameters, pixels / 4, [&]()
+        {
+            plane->getRegion(size / 4, size / 4, size * 3 / 4 - 1, size * 3 / 4 - 1, true);
+        });
+
+        measure("RGBPlane::toLayout", parameters + ",planar", pixels, [&]()
+        {
+            plane->toLayout(RGBPlane::PLANAR);
+        });
+
+        RGBPlane planar = plane->toLayout(RGBPlane::PLANAR);
+
+        measure("RGBPlane::toLayout", parameters + ",interleaved", pixels, [&]()
+        {
+            planar.toLayout(RGBPlane::INTERLEAVED);
+        });
+
+        for (int filter = resample::NEAREST; filter <= resample::BICUBIC; filter++)
+        {
+            string filterParameters = parameters + "," + FILTER_NAMES[filter];
+
+            measure("RGBPlane::rotate", filterParameters, pixels, [&]()
+            {
+                plane->rotate(45, (resample::Filter) filter);
+            });
+
+            measure("RGBPlane::resize", filterParameters, pixels * 9 / 4, [&]()
+            {
+                plane->resize(size * 3 / 2, size * 3 / 2, (resample::Filter) filter);
+            });
+        }
+
+        measure("BMPFile::writeFile", parameters, pixels, [&]()
+        {
+            BMPFile::writeFile(size, size, plane->getRawData(), fileName.c_str());
+        });
+
+        measure("BMPFile::read", parameters, pixels, [&]()
+        {
+            BMPFile file(fileName.c_str());
+
+            file.getPlane();
+        });
+
+        delete plane;
+    }
+
+    remove(fileName.c_str());
+}
+
+/**
+ * Rasterizing a hash-based map of a complete 16 tile set, sized to cover about the same area as each source size
+ */
+static void benchmarkMakeArray()
+{
+    const char northSouth[2] = {Patch::CODE_R, Patch::CODE_G};
+    const char eastWest[2] = {Patch::CODE_Y, Patch::CODE_B};
+
+    for (int tileSize : PATCH_SIZES)
+    {
+        RGBPlane* source = makeSource(tileSize * 4);
+        vector<Tile> tiles;
+
+        for (int i = 0; i < 16; i++)
+        {
+            BMPFile image(source->getRegion((i % 4) * tileSize, (i / 4) * tileSize, (i % 4 + 1) * tileSize - 1,
+                                            (i / 4 + 1) * tileSize - 1, false));
+            vector<char> codes = {northSouth[i >> 3 & 1], eastWest[i >> 2 & 1], northSouth[i >> 1 & 1], eastWest[i & 1]};
+
+            tiles.push_back(Tile(move(image), move(codes)));
+        }
+
+        for (int size : SOURCE_SIZES)
+        {
+            if (size > g_maxSource)
+            {
+                continue;
+            }
+
+            int side = size / tileSize;
+            TileMap map(tiles, side, side, 1ULL);
+
+            map.setThreadCount(g_threads);
+
+            measure("TileMap::makeArray", sizeParameter("tile", tileSize) + "," + sizeParameter("map", size),
+                    (long long) size * size, [&]()
+            {
+                map.makeArray();
+            });
+        }
+
+        delete source;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i += 2)
+    {
+        string option = argv[i];
+
+        if (i + 1 == argc)
+        {
+            option = "";
+        }
+
+        if (option == "--filter")
+        {
+            g_filter = argv[i + 1];
+        }
+        else if (option == "--min-time")
+        {
+            g_minTime = atof(argv[i + 1]);
+        }
+        else if (option == "--max-source")
+        {
+            g_maxSource = atoi(argv[i + 1]);
+        }
+        else if (option == "--threads")
+        {
+            g_threads = atoi(argv[i + 1]);
+        }
+        else
+        {
+            fprintf(stderr, "usage: benchmark [--filter text] [--min-time seconds] [--max-source size] [--threads T]\n");
+            return 1;
+        }
+    }
+
+    printf("%-28s %-24s %10s %14s %14s %10s %10s\n", "kernel", "case", "iterations", "ns/op", "bytes alloc/op",
+           "allocs/op", "MP/s");
+
+    benchmarkPatches();
+    benchmarkGetPatch();
+    benchmarkImages();
+    benchmarkMakeArray();
+
+    return 0;
+}
@@ -1,191 +1,529 @@
 #include <iostream>
 #include <sstream>
-#include <limits.h>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <stdexcept>
 #include "BMPFile.h"
 #include "Tile.h"
 #include "TileMap.h"
 #include "Quilt.h"
+#include "TileSetBuilder.h"
+#include "TilePack.h"
+#include "Trace.h"
 
 using namespace std;
 
-void makeQuiltedImage();
-void makeWangTiles();
-
-int main() {
-<<<<<<< HEAD
-	makeWangTiles();
-//    makeQuiltedImage();
-=======
-<<<<<<< HEAD
-//    makeWangTiles();
-    makeQuiltedImage();
-=======
-	makeWangTiles();
-//    makeQuiltedImage();
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
+/**
+ * The arguments of a command: its positional arguments in order, the value given to each "--option value", and the
+ * "--flag"s that take no value
+ */
+struct Arguments
+{
+    vector<string> positional;
+    map<string, string> values;
+    set<string> flags;
+};
 
-    return 0;
+static const char* USAGE =
+    "usage:\n"
+    "  wangtile quilt <input.bmp> <output.bmp> [--patches N] [--patch-size N] [--step N] [--seed S] [--threads T]\n"
+    "                 [--planar] [--scale P [--filter F]] [--bench N]\n"
+    "  wangtile build-tileset <input.bmp> <output.wtpk> [--colours 2|3] [--complete] [--patch-size N] [--threads T]\n"
+    "                 [--scale P [--filter F]] [--bench N]\n"
+    "  wangtile tilemap <tileset.wtpk> <output.bmp> [--width N] [--height N] [--seed S] [--hashed] [--threads T]\n"
+    "                 [--atlas <atlas.bmp> --index <map.wtim> [--gutter G]] [--verify] [--bench N]\n"
+    "  wangtile bench <input.bmp> [--runs N] [--threads T]\n"
+    "\n"
+    "With --bench N the synthesis is run N times, and the median wall time and throughput (in output megapixels per\n"
+    "second) are reported. Reading the input and writing the output are not timed, and the output is written once,\n"
+    "except by tilemap: it rasterizes the map as it streams it to the file, so that is written and timed every run.\n"
+    "A thread count of 0 (the default) uses one thread per hardware thread.\n"
+    "\n"
+    "With --scale P the input is resized to P percent before synthesis, with --filter nearest, bilinear or bicubic\n"
+    "(the default).\n"
+    "\n"
+    "With --verify, tilemap checks the whole tile pack against the hash in its header before using it, rather than\n"
+    "only reading the tiles the map needs.\n"
+    "\n"
+    "With --planar, quilt scores candidates and cuts seams with each colour channel held apart. The quilt is the same\n"
+    "either way.\n"
+    "\n"
+    "Every command also takes --profile, which prints the time spent in each phase and the counters once it is done,\n"
+    "and --trace <trace.json>, which saves every phase as a Chrome trace (for chrome://tracing or Perfetto).\n";
+
+/**
+ * Splits the arguments of a command into positional arguments, options and flags
+ *
+ * @param argc The number of arguments, counting from the first one after the command name
+ * @param argv The arguments
+ * @param flagNames The options that take no value
+ * @return The split arguments
+ * @throws invalid_argument If an option is missing its value
+ */
+static Arguments parseArguments(int argc, char** argv, const set<string>& flagNames)
+{
+    Arguments arguments;
+
+    for (int i = 0; i < argc; i++)
+    {
+        string argument = argv[i];
+
+        if (argument.compare(0, 2, "--") != 0)
+        {
+            arguments.positional.push_back(argument);
+        }
+        else if (flagNames.count(argument) != 0)
+        {
+            arguments.flags.insert(argument);
+        }
+        else if (i + 1 < argc)
+        {
+            arguments.values[argument] = argv[++i];
+        }
+        else
+        {
+            throw invalid_argument("Option " + argument + " needs a value");
+        }
+    }
+
+    return arguments;
+}
+
+/**
+ * Checks that a command was given exactly the options it knows and the number of positional arguments it needs
+ *
+ * @param arguments The arguments of the command
+ * @param positional The number of positional arguments the command takes
+ * @param known Every option and flag the command takes
+ * @throws invalid_argument If the arguments do not match
+ */
+static void checkArguments(const Arguments& arguments, size_t positional, const set<string>& known)
+{
+    if (arguments.positional.size() != positional)
+    {
+        throw invalid_argument("Wrong number of arguments");
+    }
+
+    for (map<string, string>::const_iterator it = arguments.values.begin(); it != arguments.values.end(); it++)
+    {
+        if (known.count(it->first) == 0)
+        {
+            throw invalid_argument("Unknown option " + it->first);
+        }
+    }
+
+    for (set<string>::const_iterator it = arguments.flags.begin(); it != arguments.flags.end(); it++)
+    {
+        if (known.count(*it) == 0)
+        {
+            throw invalid_argument("Unknown option " + *it);
+        }
+    }
+}
+
+/**
+ * Gets the value of an integer option
+ *
+ * @param arguments The arguments of the command
+ * @param name The name of the option
+ * @param fallback The value to use if the option was not given
+ * @return The value
+ * @throws invalid_argument If the value is not a whole number
+ */
+static long long getNumber(const Arguments& arguments, const string& name, long long fallback)
+{
+    map<string, string>::const_iterator it = arguments.values.find(name);
+
+    if (it == arguments.values.end())
+    {
+        return fallback;
+    }
+
+    size_t end = 0;
+    long long value = 0;
+
+    try
+    {
+        value = stoll(it->second, &end);
+    }
+    catch (exception&)
+    {
+        end = 0;
+    }
+
+    if (end == 0 || end != it->second.size())
+    {
+        throw invalid_argument("Option " + name + " needs a whole number, not " + it->second);
+    }
+
+    return value;
+}
+
+/**
+ * Gets the seed option, or a seed from the clock if none was given
+ *
+ * @param arguments The arguments of the command
+ * @return The seed
+ */
+static unsigned long long getSeed(const Arguments& arguments)
+{
+    return (unsigned long long) getNumber(arguments, "--seed", chrono::system_clock::now().time_since_epoch().count());
+}
+
+/**
+ * Runs a piece of synthesis the number of times asked for by --bench (once without it), and reports the median wall
+ * time and throughput when benchmarking
+ *
+ * @param label The name to report the runs under
+ * @param runs The number of runs
+ * @param run Runs the synthesis once, and returns the number of output pixels it made
+ */
+static void runTimed(const string& label, int runs, const function<long long()>& run)
+{
+    if (runs < 1)
+    {
+        throw invalid_argument("Number of runs must be at least 1");
+    }
+
+    vector<double> times;
+    long long pixels = 0;
+
+    for (int i = 0; i < runs; i++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        pixels = run();
+        times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+
+    if (runs == 1)
+    {
+        return;
+    }
+
+    sort(times.begin(), times.end());
+
+    double median = runs % 2 == 1 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+
+    cout << label << ": " << runs << " runs, median " << median << " s (min " << times.front() << " s, max "
+         << times.back() << " s), " << pixels / 1e6 / median << " MP/s" << endl;
+}
+
+/**
+ * Reports how much of an arena a piece of synthesis used
+ *
+ * @param label The name to report the arena under
+ * @param stats The stats of the arena
+ */
+static void printArenaStats(const string& label, const Arena::Stats& stats)
+{
+    cout << label << " arena: " << stats.allocations << " allocations, high-water mark " << stats.highWaterMark / 1e6
+         << " MB, " << stats.bytesReserved / 1e6 << " MB reserved in " << stats.blocks << " blocks" << endl;
+}
+
+/**
+ * Reads the input image of a command, resized as asked for by --scale and --filter
+ *
+ * @param arguments The arguments of the command, whose first positional argument is the input image
+ * @return The input image
+ * @throws invalid_argument If the scale is not positive, or the filter is unknown
+ */
+static BMPFile loadExemplar(const Arguments& arguments)
+{
+    BMPFile source(arguments.positional[0].c_str());
+
+    if (arguments.values.count("--scale") == 0)
+    {
+        if (arguments.values.count("--filter") != 0)
+        {
+            throw invalid_argument("A filter is only used with --scale");
+        }
+
+        return source;
+    }
+
+    long long scale = getNumber(arguments, "--scale", 100);
+    map<string, string>::const_iterator filter = arguments.values.find("--filter");
+    resample::Filter kind = filter == arguments.values.end() ? resample::BICUBIC : resample::parseFilter(filter->second);
+
+    if (scale <= 0)
+    {
+        throw invalid_argument("Scale must be a positive percentage");
+    }
+
+    int width = (int) max(1LL, source.getWidth() * scale / 100);
+    int height = (int) max(1LL, source.getHeight() * scale / 100);
+
+    return BMPFile(source.getPlane()->resize(width, height, kind));
+}
+
+/**
+ * Quilts a texture from an input image, as in Efros and Freeman
+ */
+static void runQuilt(const Arguments& arguments)
+{
+    checkArguments(arguments, 2, {"--patches", "--patch-size", "--step", "--seed", "--threads", "--planar", "--scale",
+                                  "--filter", "--bench"});
+
+    BMPFile source = loadExemplar(arguments);
+    int patches = (int) getNumber(arguments, "--patches", 8);
+    int patchSize = (int) getNumber(arguments, "--patch-size", 32);
+    int step = (int) getNumber(arguments, "--step", Quilt::GRID_SAMPLING);
+    unsigned long long seed = getSeed(arguments);
+    int threads = (int) getNumber(arguments, "--threads", 0);
+    RGBPlane::Layout layout = arguments.flags.count("--planar") != 0 ? RGBPlane::PLANAR : RGBPlane::INTERLEAVED;
+    Quilt* quilt = nullptr;
+
+    if (patches <= 0 || patchSize <= 0)
+    {
+        throw invalid_argument("Patches per side and patch size must be positive");
+    }
+
+    runTimed("quilt", (int) getNumber(arguments, "--bench", 1), [&]()
+    {
+        delete quilt;
+        quilt = new Quilt(source, patches, patchSize, step, layout);
+        quilt->setSeed(seed);
+        quilt->setThreadCount(threads);
+        quilt->generate();
+        quilt->makeSeamsAndQuilt();
+
+        return (long long) quilt->getDimension() * quilt->getDimension();
+    });
+
+    BMPFile::writeFile(quilt->getDimension(), quilt->getDimension(), quilt->getOutput()->getRawData(),
+                       arguments.positional[1].c_str());
+    delete quilt;
+}
+
+/**
+ * Synthesizes a Wang Tile set from an input image, and writes it as a tile pack
+ */
+static void runBuildTileSet(const Arguments& arguments)
+{
+    checkArguments(arguments, 2, {"--colours", "--complete", "--patch-size", "--threads", "--scale", "--filter",
+                                  "--bench"});
+
+    BMPFile source = loadExemplar(arguments);
+    int colours = (int) getNumber(arguments, "--colours", 2);
+    bool complete = arguments.flags.count("--complete") != 0;
+    int patchSize = (int) getNumber(arguments, "--patch-size", TileSetBuilder::getLargestPatchSize(source, colours));
+    TileSetBuilder builder(source, colours, complete, patchSize);
+    vector<Tile> tiles;
+
+    builder.setThreadCount((int) getNumber(arguments, "--threads", 0));
+
+    runTimed("build-tileset", (int) getNumber(arguments, "--bench", 1), [&]()
+    {
+        // The last run's tiles are freed first, so two sets are never held at once
+        tiles.clear();
+        tiles = builder.build();
+
+        return (long long) tiles.size() * tiles[0].getDimension() * tiles[0].getDimension();
+    });
+
+    TilePack::writeFile(tiles, arguments.positional[1].c_str());
+}
+
+/**
+ * Tiles a plane with a tile pack, and writes it out as an image, and optionally as an atlas and index map
+ */
+static void runTileMap(const Arguments& arguments)
+{
+    checkArguments(arguments, 2, {"--width", "--height", "--seed", "--hashed", "--threads", "--atlas", "--index",
+                                  "--gutter", "--verify", "--bench"});
+
+    TilePack pack(arguments.positional[0].c_str());
+
+    if (arguments.flags.count("--verify") != 0 && !pack.verify())
+    {
+        // Not a mistake in the command line, so no usage
+        throw runtime_error("Tile pack does not match its hash, it may be corrupt");
+    }
+
+    int width = (int) getNumber(arguments, "--width", 16);
+    int height = (int) getNumber(arguments, "--height", 16);
+    unsigned long long seed = getSeed(arguments);
+    bool hashed = arguments.flags.count("--hashed") != 0;
+    int threads = (int) getNumber(arguments, "--threads", 0);
+    TileMap* map = nullptr;
+
+    if (width <= 0 || height <= 0)
+    {
+        throw invalid_argument("Width and height of a tile map must be positive");
+    }
+
+    if (arguments.values.count("--atlas") != arguments.values.count("--index"))
+    {
+        throw invalid_argument("An atlas and an index map are written together");
+    }
+
+    runTimed("tilemap", (int) getNumber(arguments, "--bench", 1), [&]()
+    {
+        delete map;
+
+        if (hashed)
+        {
+            map = new TileMap(pack.getTiles(), width, height, seed);
+        }
+        else
+        {
+            map = new TileMap(pack.getTiles(), width, height);
+            map->setSeed(seed);
+            map->generate();
+        }
+
+        map->setThreadCount(threads);
+
+        // The map is rasterized as it is streamed to the file, so the file is written (and timed) on every run
+        map->writeFile(arguments.positional[1].c_str());
+
+        return (long long) map->getPixelWidth() * map->getPixelHeight();
+    });
+
+    if (arguments.values.count("--atlas") != 0)
+    {
+        map->writeAtlas(arguments.values.at("--atlas").c_str(), arguments.values.at("--index").c_str(),
+                        (int) getNumber(arguments, "--gutter", 0));
+    }
+
+    delete map;
 }
 
-void makeWangTiles()
+/**
+ * Benchmarks every stage (quilting, tile set synthesis and tiling) on one input image, without writing anything
+ */
+static void runBench(const Arguments& arguments)
 {
-<<<<<<< HEAD
-	BMPFile file("/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/grass.bmp");
-=======
-<<<<<<< HEAD
-	BMPFile file("D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\input2.bmp");
-=======
-	BMPFile file("/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/grass.bmp");
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
-    int dim = file.getWidth() / 2;
-
-	Patch* red = Quilt::getPatchFromSourceAt(file, dim, 0, 0, dim - 1, dim - 1, Patch::CODE_R);
-	Patch* yellow = Quilt::getPatchFromSourceAt(file, dim, dim, 0, (dim * 2) - 1, dim - 1, Patch::CODE_Y);
-	Patch* blue = Quilt::getPatchFromSourceAt(file, dim, 0, dim, dim - 1, (dim * 2) - 1, Patch::CODE_B);
-	Patch* green = Quilt::getPatchFromSourceAt(file, dim, dim, dim, (dim * 2) - 1, (dim * 2) - 1, Patch::CODE_G);
-
-    vector<Patch*> l1 = {red, yellow, blue, green};
-    Quilt q1(file, 2, l1);
-    q1.makeSeamsAndQuilt();
-
-    vector<Patch*> l2 = {green, blue, blue, green};
-    Quilt q2(file, 2, l2);
-    q2.makeSeamsAndQuilt();
-
-    vector<Patch*> l3 = {red, yellow, yellow, red};
-    Quilt q3(file, 2, l3);
-    q3.makeSeamsAndQuilt();
-
-    vector<Patch*> l4 = {green, blue, yellow, red};
-    Quilt q4(file, 2, l4);
-    q4.makeSeamsAndQuilt();
-
-    vector<Patch*> l5 = {red, blue, yellow, green};
-    Quilt q5(file, 2, l5);
-    q5.makeSeamsAndQuilt();
-
-    vector<Patch*> l6 = {green, yellow, yellow, green};
-    Quilt q6(file, 2, l6);
-    q6.makeSeamsAndQuilt();
-
-    vector<Patch*> l7 = {red, blue, blue, red};
-    Quilt q7(file, 2, l7);
-    q7.makeSeamsAndQuilt();
-
-    vector<Patch*> l8 = {green, yellow, blue, red};
-    Quilt q8(file, 2, l8);
-    q8.makeSeamsAndQuilt();
-
-<<<<<<< HEAD
-=======
-<<<<<<< HEAD
-    BMPFile::writeFile(q1.getDimension(), q1.getDimension(), q1.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt1.bmp");
-    BMPFile::writeFile(q2.getDimension(), q2.getDimension(), q2.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt2.bmp");
-    BMPFile::writeFile(q3.getDimension(), q3.getDimension(), q3.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt3.bmp");
-    BMPFile::writeFile(q4.getDimension(), q4.getDimension(), q4.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt4.bmp");
-    BMPFile::writeFile(q5.getDimension(), q5.getDimension(), q5.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt5.bmp");
-    BMPFile::writeFile(q6.getDimension(), q6.getDimension(), q6.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt6.bmp");
-    BMPFile::writeFile(q7.getDimension(), q7.getDimension(), q7.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt7.bmp");
-    BMPFile::writeFile(q8.getDimension(), q8.getDimension(), q8.getOutput()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\quilt8.bmp");
-=======
->>>>>>> dev
-    BMPFile::writeFile(q1.getDimension(), q1.getDimension(), q1.getOutput()->getRawData(), "quilt1.bmp");
-    BMPFile::writeFile(q2.getDimension(), q2.getDimension(), q2.getOutput()->getRawData(), "quilt2.bmp");
-    BMPFile::writeFile(q3.getDimension(), q3.getDimension(), q3.getOutput()->getRawData(), "quilt3.bmp");
-    BMPFile::writeFile(q4.getDimension(), q4.getDimension(), q4.getOutput()->getRawData(), "quilt4.bmp");
-    BMPFile::writeFile(q5.getDimension(), q5.getDimension(), q5.getOutput()->getRawData(), "quilt5.bmp");
-    BMPFile::writeFile(q6.getDimension(), q6.getDimension(), q6.getOutput()->getRawData(), "quilt6.bmp");
-    BMPFile::writeFile(q7.getDimension(), q7.getDimension(), q7.getOutput()->getRawData(), "quilt7.bmp");
-    BMPFile::writeFile(q8.getDimension(), q8.getDimension(), q8.getOutput()->getRawData(), "quilt8.bmp");
-<<<<<<< HEAD
-=======
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
-
-    Tile* t1 = q1.getTile();
-    Tile* t2 = q2.getTile();
-    Tile* t3 = q3.getTile();
-    Tile* t4 = q4.getTile();
-    Tile* t5 = q5.getTile();
-    Tile* t6 = q6.getTile();
-    Tile* t7 = q7.getTile();
-    Tile* t8 = q8.getTile();
-
-<<<<<<< HEAD
-=======
-<<<<<<< HEAD
-    BMPFile::writeFile(t1->getDimension(), t1->getDimension(), t1->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile1.bmp");
-    BMPFile::writeFile(t2->getDimension(), t2->getDimension(), t2->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile2.bmp");
-    BMPFile::writeFile(t3->getDimension(), t3->getDimension(), t3->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile3.bmp");
-    BMPFile::writeFile(t4->getDimension(), t4->getDimension(), t4->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile4.bmp");
-    BMPFile::writeFile(t5->getDimension(), t5->getDimension(), t5->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile5.bmp");
-    BMPFile::writeFile(t6->getDimension(), t6->getDimension(), t6->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile6.bmp");
-    BMPFile::writeFile(t7->getDimension(), t7->getDimension(), t7->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile7.bmp");
-    BMPFile::writeFile(t8->getDimension(), t8->getDimension(), t8->getImage().getPlane()->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\tile8.bmp");
-=======
->>>>>>> dev
-    BMPFile::writeFile(t1->getDimension(), t1->getDimension(), t1->getImage().getPlane()->getRawData(), "tile1.bmp");
-    BMPFile::writeFile(t2->getDimension(), t2->getDimension(), t2->getImage().getPlane()->getRawData(), "tile2.bmp");
-    BMPFile::writeFile(t3->getDimension(), t3->getDimension(), t3->getImage().getPlane()->getRawData(), "tile3.bmp");
-    BMPFile::writeFile(t4->getDimension(), t4->getDimension(), t4->getImage().getPlane()->getRawData(), "tile4.bmp");
-    BMPFile::writeFile(t5->getDimension(), t5->getDimension(), t5->getImage().getPlane()->getRawData(), "tile5.bmp");
-    BMPFile::writeFile(t6->getDimension(), t6->getDimension(), t6->getImage().getPlane()->getRawData(), "tile6.bmp");
-    BMPFile::writeFile(t7->getDimension(), t7->getDimension(), t7->getImage().getPlane()->getRawData(), "tile7.bmp");
-    BMPFile::writeFile(t8->getDimension(), t8->getDimension(), t8->getImage().getPlane()->getRawData(), "tile8.bmp");
-<<<<<<< HEAD
-=======
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
-
-    vector<Tile> tiles = {*t1, *t2, *t3, *t4, *t5, *t6, *t7, *t8};
-
-    TileMap map(tiles, 5, 5);
-
-    map.generate();
-    map.print();
-
-<<<<<<< HEAD
-    BMPFile::writeFile(map.getPixelWidth(), map.getPixelHeight(), map.makeArray(), "/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/grassTile.bmp");
-=======
-<<<<<<< HEAD
-    BMPFile::writeFile(map.getPixelWidth(), map.getPixelHeight(), map.makeArray(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\patchTileMapTEST5.bmp");
-=======
-    BMPFile::writeFile(map.getPixelWidth(), map.getPixelHeight(), map.makeArray(), "/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/grassTile.bmp");
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
+    checkArguments(arguments, 1, {"--runs", "--threads"});
+
+    BMPFile source(arguments.positional[0].c_str());
+    int runs = (int) getNumber(arguments, "--runs", 5);
+    int threads = (int) getNumber(arguments, "--threads", 0);
+    int patchSize = min(32, min(source.getWidth(), source.getHeight()));
+    vector<Tile> tiles;
+    Arena::Stats quiltArena;
+
+    // The sampling step keeps the candidate count to about 64K whatever the size of the input
+    int step = max(1, (int) sqrt((double) source.getWidth() * source.getHeight() / 65536));
+
+    runTimed("quilt", runs, [&]()
+    {
+        Quilt quilt(source, 16, patchSize, step);
+
+        quilt.setSeed(1);
+        quilt.setThreadCount(threads);
+        quilt.generate();
+        quilt.makeSeamsAndQuilt();
+        quiltArena = quilt.getArena().getStats();
+
+        return (long long) quilt.getDimension() * quilt.getDimension();
+    });
+
+    printArenaStats("quilt", quiltArena);
+
+    TileSetBuilder builder(source, 2, true);
+
+    builder.setThreadCount(threads);
+
+    runTimed("build-tileset", runs, [&]()
+    {
+        // The last run's tiles are freed first, so two sets are never held at once
+        tiles.clear();
+        tiles = builder.build();
+
+        return (long long) tiles.size() * tiles[0].getDimension() * tiles[0].getDimension();
+    });
+
+    printArenaStats("build-tileset", builder.getArenaStats());
+
+    // About 8K pixels square, whatever the size of the tiles
+    int side = max(1, 8192 / tiles[0].getDimension());
+
+    // Nothing is written here, so unlike the tilemap command this times rasterizing the whole map in memory
+    runTimed("tilemap (in memory)", runs, [&]()
+    {
+        TileMap map(tiles, side, side, 1ULL);
+
+        map.setThreadCount(threads);
+        map.makeArray();
+
+        return (long long) map.getPixelWidth() * map.getPixelHeight();
+    });
 }
 
-void makeQuiltedImage()
+/**
+ * Runs one of the commands listed in USAGE
+ */
+int main(int argc, char** argv)
 {
-<<<<<<< HEAD
-//	BMPFile file("D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\grass.bmp");
-	BMPFile file("/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/grass.bmp");
-	Quilt quilt(file, 8, 32);
-=======
-<<<<<<< HEAD
-	BMPFile file("D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\grass.bmp");
-//	BMPFile file("/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/input2.bmp");
-	Quilt quilt(file, 30, 32);
-=======
-//	BMPFile file("D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\grass.bmp");
-	BMPFile file("/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/grass.bmp");
-	Quilt quilt(file, 8, 32);
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
-
-	quilt.generate();
-
-	RGBPlane* output = quilt.makeSeamsAndQuilt();
-
-<<<<<<< HEAD
-    BMPFile::writeFile(quilt.getDimension(), quilt.getDimension(), output->getRawData(), "/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/bricksQuilt.bmp");
-=======
-<<<<<<< HEAD
-    BMPFile::writeFile(quilt.getDimension(), quilt.getDimension(), output->getRawData(), "D:\\Users\\spaouellet\\Documents\\Coding\\VSFX375\\WangTile\\imageQuiltIn2NEW.bmp");
-=======
-    BMPFile::writeFile(quilt.getDimension(), quilt.getDimension(), output->getRawData(), "/Volumes/Macintosh MD/Users/spaouellet/Documents/code/CLion/WangTile/bricksQuilt.bmp");
->>>>>>> 6a599d761db6c94f29cb834a2274a9e67b1a7369
->>>>>>> dev
-}
\ No newline at end of file
+    if (argc < 2)
+    {
+        cerr << USAGE;
+        return 1;
+    }
+
+    string command = argv[1];
+    set<string> flagNames = {"--complete", "--hashed", "--planar", "--profile", "--verify"};
+
+    try
+    {
+        Arguments arguments = parseArguments(argc - 2, argv + 2, flagNames);
+        string traceName = arguments.values.count("--trace") != 0 ? arguments.values["--trace"] : "";
+        bool profile = arguments.flags.erase("--profile") != 0;
+
+        // Taken out before the command checks its own options
+        arguments.values.erase("--trace");
+        trace::setEnabled(profile || !traceName.empty());
+
+        if (command == "quilt")
+        {
+            runQuilt(arguments);
+        }
+        else if (command == "build-tileset")
+        {
+            runBuildTileSet(arguments);
+        }
+        else if (command == "tilemap")
+        {
+            runTileMap(arguments);
+        }
+        else if (command == "bench")
+        {
+            runBench(arguments);
+        }
+        else
+        {
+            cerr << USAGE;
+            return 1;
+        }
+
+        if (profile)
+        {
+            cout << endl;
+            trace::writeSummary(cout);
+        }
+
+        if (!traceName.empty())
+        {
+            trace::writeChromeTrace(traceName.c_str());
+        }
+    }
+    catch (invalid_argument& e)
+    {
+        cerr << "error: " << e.what() << endl << endl << USAGE;
+        return 1;
+    }
+    catch (exception& e)
+    {
+        // Not a mistake in the command line, such as running out of memory or a failed read, so no usage either
+        cerr << "error: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1174 @@
+/**
+ * Regression tests of the synthesizer, built as their own executable from every source file except main.cpp and
+ * benchmark.cpp. Each test prints a line, and the exit status is the number of failed tests. Sources are generated, so
+ * no input files are needed.
+ *
+ * usage: tests
+ *
+ * @author Sasha Ouellet - spaouellet@me.com - www.sashaouellet.com
+ * @version 1.0 - 04/10/17
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include "BMPFile.h"
+#include "BMPWriter.h"
+#include "OverlapSearch.h"
+#include "PatchView.h"
+#include "Quilt.h"
+#include "Resample.h"
+#include "SSD.h"
+#include "ThreadPool.h"
+#include "TileMap.h"
+#include "TilePack.h"
+#include "TileSetBuilder.h"
+
+using namespace std;
+
+static const int THREAD_COUNTS[] = {2, 4, 8};
+
+static int g_failures = 0;
+
+/**
+ * Reports the outcome of a test, counting it if it failed
+ *
+ * @param name The name of the test
+ * @param passed Whether the test passed
+ */
+static void report(const string& name, bool passed)
+{
+    printf("%-6s %s\n", passed ? "ok" : "FAIL", name.c_str());
+    fflush(stdout);
+
+    if (!passed)
+    {
+        g_failures++;
+    }
+}
+
+/**
+ * Makes a square source image of smooth, repeating noise, so that candidates score differently from each other
+ *
+ * @param size The side length of the image
+ * @return The image
+ */
+static RGBPlane makeSource(int size)
+{
+    RGBPlane plane(size, size);
+    default_random_engine generator(size);
+    uniform_int_distribution<int> noise(0, 63);
+
+    for (int y = 0; y < size; y++)
+    {
+        unsigned char* row = plane.getRow(y);
+
+        for (int x = 0; x < size; x++)
+        {
+            row[x * 3] = (unsigned char) (((x * 7) ^ (y * 3)) % 192 + noise(generator));
+            row[x * 3 + 1] = (unsigned char) (((x + y) * 5) % 192 + noise(generator));
+            row[x * 3 + 2] = (unsigned char) ((x * y) % 192 + noise(generator));
+        }
+    }
+
+    return plane;
+}
+
+/**
+ * Makes an image of uniformly random samples, with no structure at all
+ *
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param seed The seed of the samples
+ * @return The image, interleaved
+ */
+static RGBPlane makeNoise(int width, int height, unsigned int seed)
+{
+    RGBPlane plane(width, height);
+    default_random_engine generator(seed);
+    uniform_int_distribution<int> value(0, 255);
+
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char* row = plane.getRow(y);
+
+        for (int x = 0; x < width * 3; x++)
+        {
+            row[x] = (unsigned char) value(generator);
+        }
+    }
+
+    return plane;
+}
+
+/**
+ * Makes a source of solid patches side by side, each of its own colour, so that every edge code of a tile built from it
+ * shows as one flat colour along that edge
+ *
+ * @param patchSize The side length of the patches
+ * @param patches The number of patches
+ * @return The image
+ */
+static RGBPlane makeSolidSource(int patchSize, int patches)
+{
+    RGBPlane plane(patchSize * patches, patchSize);
+
+    for (int y = 0; y < patchSize; y++)
+    {
+        unsigned char* row = plane.getRow(y);
+
+        for (int x = 0; x < patchSize * patches; x++)
+        {
+            int patch = x / patchSize;
+
+            row[x * 3] = (unsigned char) (40 * patch);
+            row[x * 3 + 1] = (unsigned char) (255 - 40 * patch);
+            row[x * 3 + 2] = (unsigned char) (patch % 2 * 200);
+        }
+    }
+
+    return plane;
+}
+
+/**
+ * Counts the pixels that differ across the seams between neighbouring tiles of a rasterized map, over the middle third
+ * of each seam (the corners of a tile mix the colours of two edges)
+ *
+ * @param output The rasterized map
+ * @param tileSize The side length of the tiles
+ * @return The number of pixels that differ from their neighbour across a seam
+ */
+static int countSeamMismatches(const RGBPlane& output, int tileSize)
+{
+    int mismatches = 0;
+
+    for (int y = 0; y < output.getHeight(); y++)
+    {
+        for (int x = tileSize; x < output.getWidth(); x += tileSize)
+        {
+            bool middle = y % tileSize >= tileSize / 3 && y % tileSize < tileSize * 2 / 3;
+
+            if (middle && !equal(output.getPixel(x - 1, y), output.getPixel(x - 1, y) + 3, output.getPixel(x, y)))
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    for (int y = tileSize; y < output.getHeight(); y += tileSize)
+    {
+        for (int x = 0; x < output.getWidth(); x++)
+        {
+            bool middle = x % tileSize >= tileSize / 3 && x % tileSize < tileSize * 2 / 3;
+
+            if (middle && !equal(output.getPixel(x, y - 1), output.getPixel(x, y - 1) + 3, output.getPixel(x, y)))
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+/**
+ * Makes a quilt of the given source and returns its pixels, bottom row first
+ *
+ * @param source The source to quilt
+ * @param patchSize The side length of the patches
+ * @param sampleStep The distance between two candidate origins
+ * @param threads The number of threads to quilt with
+ * @return The packed RGB pixels of the quilt
+ */
+static string makeQuilt(BMPFile& source, int patchSize, int sampleStep, int threads)
+{
+    Quilt quilt(source, 8, patchSize, sampleStep);
+
+    quilt.setSeed(3);
+    quilt.setThreadCount(threads);
+    quilt.generate();
+
+    RGBPlane* output = quilt.makeSeamsAndQuilt();
+    string pixels;
+
+    for (int y = 0; y < output->getHeight(); y++)
+    {
+        pixels.append((const char*) output->getRow(y), output->getWidth() * 3);
+    }
+
+    return pixels;
+}
+
+/**
+ * A quilt is the same for any thread count. The sample steps cover candidates scored directly, through an OverlapSearch
+ * and through a CandidateIndex, and all but the index score more than one chunk of SCORING_CHUNK candidates per cell,
+ * so the scoring is nested within the wavefront. Each is run a few times, as a race only shows some of the time
+ */
+static void testQuiltMatchesAcrossThreadCounts()
+{
+    BMPFile source(makeSource(256));
+    const int patchSize = 32;
+    const int steps[] = {Quilt::GRID_SAMPLING, 8, 4, 1};
+
+    for (int step : steps)
+    {
+        string serial = makeQuilt(source, patchSize, step, 1);
+        bool same = true;
+
+        for (int threads : THREAD_COUNTS)
+        {
+            for (int run = 0; run < 4; run++)
+            {
+                same = same && makeQuilt(source, patchSize, step, threads) == serial;
+            }
+        }
+
+        report("quilt matches across thread counts, step=" + to_string(step), same);
+    }
+}
+
+/**
+ * A thread waiting for a nested parallelFor only runs the work of that parallelFor, so the outer body is never entered
+ * again on a thread that is already in it
+ */
+static void testNestedParallelForDoesNotReenter()
+{
+    ThreadPool pool(8);
+    atomic<bool> reentered(false);
+    atomic<long long> inner(0);
+
+    pool.parallelFor(64, [&](int)
+    {
+        thread_local int depth = 0;
+
+        if (++depth > 1)
+        {
+            reentered = true;
+        }
+
+        // Slow enough that the other threads take some of the inner ranges, leaving this one waiting
+        pool.parallelFor(64, [&](int)
+        {
+            this_thread::sleep_for(chrono::microseconds(20));
+            inner++;
+        });
+
+        depth--;
+    });
+
+    report("nested parallelFor does not re-enter the outer body", !reentered && inner == 64 * 64);
+}
+
+/**
+ * A tile map built from a grid can draw a random tile and be generated again, from the tiles of the grid. One whose
+ * tiles cannot be generated from says so rather than reading empty buckets
+ */
+static void testGridTileMapGenerates()
+{
+    RGBPlane plane(4, 4);
+    BMPFile image(plane);
+    vector<Tile> tiles;
+    const char* codes[] = {"RGRG", "RGRB", "RBRG", "RBRB"};
+
+    for (const char* code : codes)
+    {
+        tiles.push_back(Tile(image, vector<char>(code, code + 4)));
+    }
+
+    vector<vector<Tile>> grid(2, vector<Tile>{tiles[0], tiles[1]});
+    TileMap map(grid, 2, 2);
+
+    map.getRandom();
+    map.generate();
+
+    bool generated = map.getTileSet().size() == 2;
+
+    // The second tile leaves G on its east side, but its own west code is B
+    vector<vector<Tile>> stuck(1, vector<Tile>{tiles[1]});
+    TileMap stuckMap(stuck, 1, 1);
+    bool refused = false;
+
+    try
+    {
+        stuckMap.generate();
+    }
+    catch (const invalid_argument&)
+    {
+        refused = true;
+    }
+
+    report("tile map built from a grid generates, or refuses to", generated && refused);
+}
+
+/**
+ * A patch is only taken from the source when its corners are a patch size apart, as the opposite corner is not used to
+ * view it
+ */
+static void testPatchCornersSpanThePatch()
+{
+    BMPFile source(makeSource(64));
+    Patch* patch = Quilt::getPatchFromSourceAt(source, 16, 8, 8, 23, 23, Patch::CODE_R);
+    bool refused = false;
+
+    delete patch;
+
+    try
+    {
+        Quilt::getPatchFromSourceAt(source, 16, 8, 8, 31, 23, Patch::CODE_R);
+    }
+    catch (const invalid_argument&)
+    {
+        refused = true;
+    }
+
+    report("patch corners span the patch size", refused);
+}
+
+/**
+ * A quilt too small to leave a tile inside the margins says so, rather than making a plane of negative size
+ */
+static void testSmallQuiltRefusesTile()
+{
+    BMPFile source(makeSource(64));
+    Quilt quilt(source, 2, 8);
+    bool refused = false;
+
+    quilt.setSeed(3);
+    quilt.generate();
+    quilt.makeSeamsAndQuilt();
+
+    try
+    {
+        quilt.getTile();
+    }
+    catch (const invalid_argument&)
+    {
+        refused = true;
+    }
+
+    report("quilt too small for a tile refuses to cut one", refused);
+}
+
+/**
+ * The tiles of a built set carry each edge colour on the side its code names, so in a map generated from them every
+ * pair of neighbours meets in the same colour
+ */
+static void testBuiltTilesMatchTheirNeighbours()
+{
+    const int patchSize = TileSetBuilder::MIN_PATCH_SIZE;
+    BMPFile source(makeSolidSource(patchSize, 4));
+    TileSetBuilder builder(source, 2, false, patchSize);
+    vector<vector<char>> codes = builder.getTileCodes();
+    vector<Tile> tiles = builder.build();
+    int tileSize = tiles[0].getDimension();
+    bool coded = true;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            coded = coded && tiles[i].getCodeAtSide(side) == codes[i][side];
+        }
+    }
+
+    TileMap map(tiles, 6, 6);
+
+    map.setSeed(5);
+    map.generate();
+
+    report("built tiles have their codes and match their neighbours in a map",
+           coded && countSeamMismatches(map.makeArray(), tileSize) == 0);
+}
+
+/**
+ * Flips the bits of one byte of a file
+ *
+ * @param fileName The name of the file
+ * @param offset The offset of the byte
+ * @return True if the byte was changed
+ */
+static bool flipByte(const string& fileName, long offset)
+{
+    FILE* file = fopen(fileName.c_str(), "r+b");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    bool flipped = fseek(file, offset, SEEK_SET) == 0;
+    int value = flipped ? fgetc(file) : EOF;
+
+    flipped = value != EOF && fseek(file, offset, SEEK_SET) == 0 && fputc(value ^ 0xFF, file) != EOF;
+
+    return fclose(file) == 0 && flipped;
+}
+
+/**
+ * A tile pack reads back the tiles it was written from, passes its hash check, and fails it once a byte of its pixels
+ * is changed
+ */
+static void testTilePackRoundTrips()
+{
+    string fileName = "tests_" + to_string(rand()) + ".wtpk";
+    const char* codes[] = {"rygb", "gbry", "rbrb"};
+    vector<Tile> tiles;
+
+    for (int i = 0; i < 3; i++)
+    {
+        RGBPlane plane = makeSource(20);
+
+        plane.getRow(0)[0] = (unsigned char) i;
+        tiles.push_back(Tile(BMPFile(move(plane)), vector<char>(codes[i], codes[i] + 4)));
+    }
+
+    TilePack::writeFile(tiles, fileName.c_str());
+
+    bool same = true;
+    bool verified;
+
+    {
+        TilePack pack(fileName.c_str());
+        vector<Tile>& loaded = pack.getTiles();
+
+        same = loaded.size() == tiles.size();
+
+        for (size_t i = 0; same && i < tiles.size(); i++)
+        {
+            RGBPlane* expected = tiles[i].getImage().getPlane();
+            RGBPlane* actual = loaded[i].getImage().getPlane();
+
+            for (int side = 0; side < 4; side++)
+            {
+                same = same && loaded[i].getCodeAtSide(side) == codes[i][side];
+            }
+
+            same = same && actual->getWidth() == 20 && actual->getHeight() == 20
+                   && equal(expected->getRow(0), expected->getRow(0) + 20 * 20 * 3, actual->getRow(0));
+        }
+
+        verified = pack.verify();
+    }
+
+    // The header and the codes of three tiles fit before the first alignment, where the first pixel blob starts
+    bool corrupted = flipByte(fileName, TilePack::ALIGNMENT + 7);
+    bool refused = corrupted && !TilePack(fileName.c_str()).verify();
+
+    remove(fileName.c_str());
+
+    report("tile pack round trips and fails its hash check once corrupted", same && verified && refused);
+}
+
+/**
+ * Writes a bitmap file byte by byte, rather than through BMPWriter, so that the formats it never writes can be read
+ * back: top-down rows (negative height) and 32 bit pixels described by bit fields
+ *
+ * @param fileName The name of the file
+ * @param plane The pixels to write
+ * @param topDown Whether to store the rows from the top, with a negative height
+ * @param bitsPerPixel 24, or 32 for pixels with an alpha byte and standard bit fields
+ * @return True if the file was written
+ */
+static bool writeBitmap(const string& fileName, const RGBPlane& plane, bool topDown, int bitsPerPixel)
+{
+    int width = plane.getWidth();
+    int height = plane.getHeight();
+    int bytesPerPixel = bitsPerPixel / 8;
+    int stride = (width * bytesPerPixel + 3) / 4 * 4;
+    int offset = bitsPerPixel == 32 ? 66 : 54;
+    vector<unsigned char> bytes(offset + stride * height, 0);
+
+    auto writeInt = [&bytes](int at, unsigned int value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            bytes[at + i] = (unsigned char) (value >> (8 * i));
+        }
+    };
+
+    bytes[0] = 'B';
+    bytes[1] = 'M';
+    writeInt(2, (unsigned int) bytes.size());
+    writeInt(10, offset);
+    writeInt(14, 40);
+    writeInt(18, width);
+    writeInt(22, topDown ? -height : height);
+    bytes[26] = 1;
+    bytes[28] = (unsigned char) bitsPerPixel;
+
+    if (bitsPerPixel == 32)
+    {
+        writeInt(30, 3);
+        writeInt(54, 0x00FF0000);
+        writeInt(58, 0x0000FF00);
+        writeInt(62, 0x000000FF);
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char* row = &bytes[offset + stride * (topDown ? height - 1 - y : y)];
+
+        for (int x = 0; x < width; x++, row += bytesPerPixel)
+        {
+            row[0] = plane.getSample(x, y, 2);
+            row[1] = plane.getSample(x, y, 1);
+            row[2] = plane.getSample(x, y, 0);
+
+            if (bitsPerPixel == 32)
+            {
+                row[3] = 0xFF;
+            }
+        }
+    }
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+    return fclose(file) == 0 && written;
+}
+
+/**
+ * Checks that two planes hold the same pixels
+ *
+ * @param expected The plane to compare against
+ * @param actual The plane to check
+ * @return True if they are the same size and every sample matches
+ */
+static bool samePixels(const RGBPlane& expected, const RGBPlane& actual)
+{
+    if (expected.getWidth() != actual.getWidth() || expected.getHeight() != actual.getHeight())
+    {
+        return false;
+    }
+
+    for (int y = 0; y < expected.getHeight(); y++)
+    {
+        for (int x = 0; x < expected.getWidth(); x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                if (expected.getSample(x, y, c) != actual.getSample(x, y, c))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Bitmaps read back the pixels they were written with: streamed by BMPWriter with padded rows, and hand written top
+ * down or with 32 bit bit fields. Copies of a bitmap made before it is decoded share the plane, which is decoded
+ * once however many threads ask for it.
+ */
+static void testBitmapsRoundTrip()
+{
+    string fileName = "tests_" + to_string(rand()) + ".bmp";
+    // 7 pixels take 21 bytes, so each row of a 24 bit file is padded
+    RGBPlane source = makeNoise(7, 5, 7);
+
+    bool streamed;
+
+    {
+        BMPWriter writer(fileName.c_str(), source.getWidth(), source.getHeight());
+
+        for (int y = 0; y < source.getHeight(); y++)
+        {
+            writer.writeRow(source.getRow(y));
+        }
+
+        writer.close();
+
+        BMPFile bitmap(fileName.c_str());
+
+        streamed = bitmap.getBitsPerPixel() == 24 && bitmap.getEncodedStride() == 24
+                   && samePixels(source, *bitmap.getPlane());
+    }
+
+    bool topDown = writeBitmap(fileName, source, true, 24);
+
+    if (topDown)
+    {
+        BMPFile bitmap(fileName.c_str());
+
+        topDown = bitmap.getEncodedStride() == -24 && samePixels(source, *bitmap.getPlane());
+    }
+
+    bool bitFields = true;
+
+    for (int flip = 0; bitFields && flip < 2; flip++)
+    {
+        bitFields = writeBitmap(fileName, source, flip == 1, 32);
+
+        if (bitFields)
+        {
+            BMPFile bitmap(fileName.c_str());
+
+            bitFields = bitmap.getBitsPerPixel() == 32 && samePixels(source, *bitmap.getPlane());
+        }
+    }
+
+    bool shared = writeBitmap(fileName, source, false, 24);
+
+    if (shared)
+    {
+        BMPFile bitmap(fileName.c_str());
+        vector<BMPFile> copies(4, bitmap);
+        vector<RGBPlane*> planes(copies.size());
+        vector<thread> threads;
+
+        for (size_t i = 0; i < copies.size(); i++)
+        {
+            threads.push_back(thread([&copies, &planes, i]()
+            {
+                planes[i] = copies[i].getPlane();
+            }));
+        }
+
+        for (thread& t : threads)
+        {
+            t.join();
+        }
+
+        for (RGBPlane* plane : planes)
+        {
+            shared = shared && plane == bitmap.getPlane();
+        }
+
+        shared = shared && samePixels(source, *bitmap.getPlane());
+    }
+
+    remove(fileName.c_str());
+
+    report("bitmaps round trip with padded rows, top down rows and bit fields", streamed && topDown && bitFields);
+    report("copies of a bitmap share the plane decoded once across threads", shared);
+}
+
+/**
+ * Makes a complete tile set of two colours, with a tile for every combination of codes and any more tiles after those
+ * repeating the first combinations, so that a hash-based map can be made from it
+ *
+ * @param count The number of tiles, at least 16
+ * @param size The side length of each tile
+ * @return The tiles, each with different pixels
+ */
+static vector<Tile> makeCompleteTileSet(int count, int size)
+{
+    const char colours[] = {'r', 'g'};
+    vector<Tile> tiles;
+
+    for (int i = 0; i < count; i++)
+    {
+        RGBPlane plane = makeSource(size);
+        vector<char> codes(4);
+
+        plane.getRow(0)[0] = (unsigned char) i;
+        plane.getRow(0)[1] = (unsigned char) (i >> 8);
+
+        for (int side = 0; side < 4; side++)
+        {
+            codes[side] = colours[((i % 16) >> side) & 1];
+        }
+
+        tiles.push_back(Tile(BMPFile(move(plane)), codes));
+    }
+
+    return tiles;
+}
+
+/**
+ * A hash-based tile map gives the same tile at a coordinate whatever order the coordinates are asked for in, and from
+ * a second map with the same seed, and each tile meets its east and south neighbours in the same codes
+ */
+static void testHashedTileMapIsStable()
+{
+    // A second tile for one combination of codes, so that cells pick between tiles as well as codes
+    vector<Tile> tiles = makeCompleteTileSet(17, 4);
+    const int FIRST = -6;
+    const int SIZE = 16;
+    TileMap map(tiles, SIZE, SIZE, 11);
+    TileMap again(tiles, SIZE, SIZE, 11);
+    vector<int> forward;
+    bool stable = true;
+
+    for (int y = FIRST; y < FIRST + SIZE; y++)
+    {
+        for (int x = FIRST; x < FIRST + SIZE; x++)
+        {
+            forward.push_back(map.getTileIndexAt(x, y));
+        }
+    }
+
+    // Backwards through the same map, and in a shuffled order through the second one
+    for (int cell = SIZE * SIZE - 1; cell >= 0; cell--)
+    {
+        stable = stable && map.getTileIndexAt(FIRST + cell % SIZE, FIRST + cell / SIZE) == forward[cell];
+    }
+
+    vector<int> order(SIZE * SIZE);
+
+    for (int cell = 0; cell < SIZE * SIZE; cell++)
+    {
+        order[cell] = cell;
+    }
+
+    shuffle(order.begin(), order.end(), default_random_engine(3));
+
+    for (int cell : order)
+    {
+        stable = stable && again.getTileIndexAt(FIRST + cell % SIZE, FIRST + cell / SIZE) == forward[cell];
+    }
+
+    // Rows of the map run from the top, so the south neighbour of a cell is in the next row
+    bool matched = true;
+    bool picked = false;
+
+    for (int y = FIRST; y < FIRST + SIZE; y++)
+    {
+        for (int x = FIRST; x < FIRST + SIZE; x++)
+        {
+            Tile& tile = map.getTileAt(x, y);
+
+            matched = matched && tile.getCodeAtSide(Tile::EAST) == map.getTileAt(x + 1, y).getCodeAtSide(Tile::WEST)
+                      && tile.getCodeAtSide(Tile::SOUTH) == map.getTileAt(x, y + 1).getCodeAtSide(Tile::NORTH);
+            picked = picked || map.getTileIndexAt(x, y) == 16;
+        }
+    }
+
+    report("hashed tile map is stable across query orders", stable);
+    report("hashed tile map matches the codes of neighbouring tiles", matched && picked);
+}
+
+/**
+ * Reads a whole file
+ *
+ * @param fileName The name of the file
+ * @return The bytes of the file, or none if it cannot be read
+ */
+static vector<unsigned char> readFile(const string& fileName)
+{
+    vector<unsigned char> bytes;
+    FILE* file = fopen(fileName.c_str(), "rb");
+
+    if (file == NULL)
+    {
+        return bytes;
+    }
+
+    unsigned char buffer[4096];
+    size_t read;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        bytes.insert(bytes.end(), buffer, buffer + read);
+    }
+
+    fclose(file);
+
+    return bytes;
+}
+
+/**
+ * Writes the atlas and index map of a tile map, and checks them against the map: the header of the index map, the
+ * codes and cell indices it holds, and the pixels of each tile and its gutter in the atlas
+ *
+ * @param map The tile map
+ * @param gutter The width of the gutter around each tile
+ * @return True if the files describe the map
+ */
+static bool atlasMatchesMap(TileMap& map, int gutter)
+{
+    string atlasName = "tests_" + to_string(rand()) + ".bmp";
+    string indexName = "tests_" + to_string(rand()) + ".wtim";
+
+    map.writeAtlas(atlasName.c_str(), indexName.c_str(), gutter);
+
+    vector<Tile>& tiles = map.getTileSet();
+    vector<unsigned char> index = readFile(indexName);
+    int count = tiles.size();
+    int size = tiles[0].getImage().getWidth();
+    int columns = (int) ceil(sqrt((double) count));
+    int bytesPerIndex = count > 256 ? 2 : 1;
+    int width = map.getPixelWidth() / size;
+    int height = map.getPixelHeight() / size;
+    unsigned int expected[] = {1, (unsigned int) width, (unsigned int) height, (unsigned int) count,
+                               (unsigned int) bytesPerIndex, (unsigned int) size, (unsigned int) gutter,
+                               (unsigned int) columns};
+    size_t cells = (size_t) 36 + count * 4;
+    bool matched = index.size() == cells + (size_t) width * height * bytesPerIndex
+                   && equal(index.begin(), index.begin() + 4, "WTIM");
+
+    for (int i = 0; matched && i < 8; i++)
+    {
+        const unsigned char* field = &index[4 + i * 4];
+
+        matched = (field[0] | field[1] << 8 | field[2] << 16 | (unsigned int) field[3] << 24) == expected[i];
+    }
+
+    for (int i = 0; matched && i < count; i++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            matched = matched && index[36 + i * 4 + side] == (unsigned char) tiles[i].getCodeAtSide(side);
+        }
+    }
+
+    for (int y = 0; matched && y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const unsigned char* entry = &index[cells + ((size_t) y * width + x) * bytesPerIndex];
+            int stored = bytesPerIndex == 2 ? entry[0] | entry[1] << 8 : entry[0];
+
+            matched = matched && stored == map.getTileIndexAt(x, y);
+        }
+    }
+
+    // Tiles are placed from the top left of the atlas, whose plane is stored bottom-up like the tiles
+    BMPFile atlas(atlasName.c_str());
+    RGBPlane* pixels = matched ? atlas.getPlane() : nullptr;
+    int cell = size + 2 * gutter;
+    int rows = (count + columns - 1) / columns;
+
+    matched = matched && pixels->getWidth() == columns * cell && pixels->getHeight() == rows * cell;
+
+    for (int i = 0; matched && i < count; i++)
+    {
+        RGBPlane* tile = tiles[i].getImage().getPlane();
+        int left = (i % columns) * cell + gutter;
+        int bottom = (rows - 1 - i / columns) * cell + gutter;
+
+        for (int y = -gutter; y < size + gutter; y++)
+        {
+            for (int x = -gutter; x < size + gutter; x++)
+            {
+                // The gutter repeats the nearest edge pixel of the tile
+                int tileX = min(max(x, 0), size - 1);
+                int tileY = min(max(y, 0), size - 1);
+
+                for (int c = 0; c < 3; c++)
+                {
+                    matched = matched && pixels->getSample(left + x, bottom + y, c) == tile->getSample(tileX, tileY, c);
+                }
+            }
+        }
+    }
+
+    remove(atlasName.c_str());
+    remove(indexName.c_str());
+
+    return matched;
+}
+
+/**
+ * The atlas and index map written from a tile map hold its tiles and the index of the tile in each cell, with one byte
+ * per index for small sets and two for sets of more than 256 tiles
+ */
+static void testAtlasMatchesMap()
+{
+    TileMap narrow(makeCompleteTileSet(20, 6), 7, 5, 11);
+    TileMap wide(makeCompleteTileSet(300, 4), 9, 3, 5);
+
+    report("atlas and index map match the tile map, 1 byte indices", atlasMatchesMap(narrow, 2));
+    report("atlas and index map match the tile map, 2 byte indices", atlasMatchesMap(wide, 0));
+}
+
+/**
+ * Copying a region gives the same pixels whichever layouts the two planes are in, and the row and per-pixel errors of
+ * planar planes, or of one plane of each layout, are those of the interleaved planes
+ */
+static void testLayoutsAgree()
+{
+    const RGBPlane::Layout layouts[] = {RGBPlane::INTERLEAVED, RGBPlane::PLANAR};
+    RGBPlane first = makeNoise(37, 19, 1);
+    RGBPlane second = makeNoise(41, 13, 2);
+    // The pixels around the region copied into are kept
+    RGBPlane expected = makeNoise(23, 11, 3);
+    bool copied = true;
+
+    expected.copyRegionFrom(first, 5, 3, 17, 7, 3, 2);
+
+    for (RGBPlane::Layout from : layouts)
+    {
+        for (RGBPlane::Layout to : layouts)
+        {
+            RGBPlane source = first.toLayout(from);
+            RGBPlane copy = makeNoise(23, 11, 3).toLayout(to);
+
+            copy.copyRegionFrom(source, 5, 3, 17, 7, 3, 2);
+            copied = copied && samePixels(expected, copy) && samePixels(first, source.toLayout(RGBPlane::INTERLEAVED));
+        }
+    }
+
+    bool errors = true;
+    vector<int> expectedErrors(41);
+    vector<int> actualErrors(41);
+
+    // Odd runs and offsets, so the vector kernels of every layout end on a tail
+    for (int count = 1; count <= 29; count += 7)
+    {
+        for (int y = 0; y < 13; y += 4)
+        {
+            int x = count % 5;
+            int otherX = 41 - count - y % 3;
+            long long rowError = first.getRowError(x, y, second, otherX, y, count);
+            long long pixelTotal = first.getPixelErrors(x, y, second, otherX, y, count, expectedErrors.data());
+
+            for (RGBPlane::Layout a : layouts)
+            {
+                for (RGBPlane::Layout b : layouts)
+                {
+                    RGBPlane left = first.toLayout(a);
+                    RGBPlane right = second.toLayout(b);
+
+                    errors = errors && left.getRowError(x, y, right, otherX, y, count) == rowError
+                             && left.getPixelErrors(x, y, right, otherX, y, count, actualErrors.data()) == pixelTotal
+                             && equal(actualErrors.begin(), actualErrors.begin() + count, expectedErrors.begin());
+                }
+            }
+        }
+    }
+
+    report("copying regions gives the same pixels across layouts", copied);
+    report("planar and mixed layout errors match interleaved", errors);
+}
+
+/**
+ * Every SSD implementation the CPU supports gives the errors of a plain reference, on random rows of every length up
+ * to a few vectors (so each vector loop ends on every possible tail), starting off alignment, and on a run long enough
+ * to overflow an int
+ */
+static void testSSDImplementationsAgree()
+{
+    const int LONGEST = 100000;
+    default_random_engine generator(8);
+    uniform_int_distribution<int> value(0, 255);
+    vector<unsigned char> a(3 * LONGEST + 1);
+    vector<unsigned char> b(3 * LONGEST + 1);
+    vector<int> errors(LONGEST);
+    string original = ssd::getImplementation();
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a[i] = (unsigned char) value(generator);
+        b[i] = (unsigned char) value(generator);
+    }
+
+    vector<int> counts;
+
+    for (int count = 0; count <= 100; count++)
+    {
+        counts.push_back(count);
+    }
+
+    counts.push_back(1001);
+    counts.push_back(LONGEST);
+
+    for (const string& name : ssd::getImplementations())
+    {
+        ssd::setImplementation(name);
+
+        bool packed = true;
+        bool planar = true;
+
+        // The runs start one byte in, so they are never aligned
+        for (int pixels : counts)
+        {
+            const unsigned char* left = a.data() + 1;
+            const unsigned char* right = b.data() + 1;
+            const unsigned char* leftChannels[3] = {left, left + LONGEST, left + 2 * LONGEST};
+            const unsigned char* rightChannels[3] = {right, right + LONGEST, right + 2 * LONGEST};
+            long long packedTotal = 0;
+            long long planarTotal = 0;
+            bool packedErrors = true;
+            bool planarErrors = true;
+
+            ssd::pixelErrors(left, right, pixels, errors.data());
+
+            for (int i = 0; i < pixels; i++)
+            {
+                int error = 0;
+
+                for (int c = 0; c < 3; c++)
+                {
+                    int diff = left[i * 3 + c] - right[i * 3 + c];
+                    error += diff * diff;
+                }
+
+                packedTotal += error;
+                packedErrors = packedErrors && errors[i] == error;
+            }
+
+            ssd::planarPixelErrors(leftChannels, rightChannels, pixels, errors.data());
+
+            for (int i = 0; i < pixels; i++)
+            {
+                int error = 0;
+
+                for (int c = 0; c < 3; c++)
+                {
+                    int diff = leftChannels[c][i] - rightChannels[c][i];
+                    error += diff * diff;
+                }
+
+                planarTotal += error;
+                planarErrors = planarErrors && errors[i] == error;
+            }
+
+            packed = packed && packedErrors && ssd::rowError(left, right, pixels * 3) == packedTotal
+                     && ssd::pixelErrors(left, right, pixels, errors.data()) == packedTotal;
+            planar = planar && planarErrors && ssd::planarRowError(leftChannels, rightChannels, pixels) == planarTotal
+                     && ssd::planarPixelErrors(leftChannels, rightChannels, pixels, errors.data()) == planarTotal;
+        }
+
+        // Odd byte counts, which split a pixel, only come up in the packed row kernel
+        for (int count = 1; count < 200; count += 2)
+        {
+            long long total = 0;
+
+            for (int i = 0; i < count; i++)
+            {
+                int diff = a[i + 1] - b[i + 1];
+                total += diff * diff;
+            }
+
+            packed = packed && ssd::rowError(a.data() + 1, b.data() + 1, count) == total;
+        }
+
+        report("ssd " + name + " matches the reference on packed rows", packed);
+        report("ssd " + name + " matches the reference on planar rows", planar);
+    }
+
+    ssd::setImplementation(original);
+}
+
+/**
+ * Every resample implementation the CPU supports gives the same pixels as the scalar one, for each filter: stretching
+ * and shrinking, turning so that some target pixels land outside the source, and sampling right by the last pixel of
+ * the source, which the vector kernels leave to the scalar one
+ */
+static void testResampleImplementationsAgree()
+{
+    const resample::Filter filters[] = {resample::NEAREST, resample::BILINEAR, resample::BICUBIC};
+    const char* filterNames[] = {"nearest", "bilinear", "bicubic"};
+    // The targets are 61 and 19 pixels wide, so rows end on leftover pixels
+    const double turn[] = {0.8, -0.6, 20.0, 0.6, 0.8, -8.0};
+    const double corner[] = {0.01, 0.0, 36.2, 0.0, 0.01, 22.2};
+    RGBPlane source = makeNoise(37, 23, 24);
+    string original = resample::getImplementation();
+
+    for (const string& name : resample::getImplementations())
+    {
+        for (int f = 0; f < 3 && name != "scalar"; f++)
+        {
+            resample::setImplementation("scalar");
+
+            RGBPlane stretched = source.resize(61, 45, filters[f]);
+            RGBPlane shrunk = source.resize(19, 11, filters[f]);
+            RGBPlane turned = source.warpAffine(61, 45, turn, filters[f]);
+            RGBPlane last = source.warpAffine(19, 11, corner, filters[f]);
+
+            resample::setImplementation(name);
+
+            bool same = samePixels(stretched, source.resize(61, 45, filters[f]))
+                        && samePixels(shrunk, source.resize(19, 11, filters[f]))
+                        && samePixels(turned, source.warpAffine(61, 45, turn, filters[f]))
+                        && samePixels(last, source.warpAffine(19, 11, corner, filters[f]));
+
+            report("resample " + name + " matches scalar, " + filterNames[f], same);
+        }
+    }
+
+    resample::setImplementation(original);
+}
+
+/**
+ * The overlap errors of every candidate that an OverlapSearch computes through FFTs and summed-area tables are those
+ * PatchView::getOverlapScore gives directly, up to rounding, with a left neighbour, a top one, or both, and both pick
+ * the same best candidate
+ */
+static void testOverlapSearchMatchesDirectScores()
+{
+    const int PATCH_SIZE = 18;
+    // Neither side of the source is a power of two, so the transforms are padded
+    RGBPlane source = makeNoise(45, 38, 1);
+    RGBPlane neighbours = makeNoise(30, 30, 2);
+    Patch left(PatchView(neighbours, 2, 5, PATCH_SIZE), Patch::CODE_R);
+    Patch top(PatchView(neighbours, 9, 1, PATCH_SIZE), Patch::CODE_G);
+    Patch* lefts[] = {&left, nullptr, &left};
+    Patch* tops[] = {nullptr, &top, &top};
+    const char* names[] = {"left", "top", "left and top"};
+    OverlapSearch search(source, PATCH_SIZE);
+    vector<long long> errors;
+
+    for (int n = 0; n < 3; n++)
+    {
+        bool close = true;
+        int best = 0;
+        int bestDirect = 0;
+        long long bestDirectScore = -1;
+
+        search.computeErrors(lefts[n], tops[n], errors);
+
+        for (int y = 0; y < search.getCandidateHeight(); y++)
+        {
+            for (int x = 0; x < search.getCandidateWidth(); x++)
+            {
+                int candidate = y * search.getCandidateWidth() + x;
+                long long direct = PatchView(source, x, y, PATCH_SIZE).getOverlapScore(lefts[n], tops[n]);
+
+                close = close && llabs(errors[candidate] - direct) <= max(1LL, direct / 1000000);
+                best = errors[candidate] < errors[best] ? candidate : best;
+
+                if (bestDirectScore < 0 || direct < bestDirectScore)
+                {
+                    bestDirect = candidate;
+                    bestDirectScore = direct;
+                }
+            }
+        }
+
+        report(string("overlap search matches direct scores, ") + names[n], close && best == bestDirect);
+    }
+}
+
+int main(int argc, char**)
+{
+    if (argc > 1)
+    {
+        fprintf(stderr, "usage: tests\n");
+        return 1;
+    }
+
+    testNestedParallelForDoesNotReenter();
+    testQuiltMatchesAcrossThreadCounts();
+    testGridTileMapGenerates();
+    testPatchCornersSpanThePatch();
+    testSmallQuiltRefusesTile();
+    testBuiltTilesMatchTheirNeighbours();
+    testTilePackRoundTrips();
+    testBitmapsRoundTrip();
+    testHashedTileMapIsStable();
+    testAtlasMatchesMap();
+    testLayoutsAgree();
+    testSSDImplementationsAgree();
+    testResampleImplementationsAgree();
+    testOverlapSearchMatchesDirectScores();
+
+    return g_failures;
+}
@@ -6,7 +6,6 @@
  */
 
 #include <stdexcept>
-#include <cmath>
 #include "util.h"
 
 namespace util
@@ -43,24 +42,22 @@ namespace util
     }
 
     /**
-     * Calculates the l2 norm of the difference between the vectors a and b
-     * @param a Vector 1
-     * @param b Vector 2
-     * @param size Size of the vectors
-     * @return The l2 norm of the difference between the vectors
+     * Hashes a seed together with a pair of coordinates into a well mixed 64 bit value (splitmix64 finalizer). Used to
+     * give every cell of a grid its own independent, reproducible random stream regardless of the order cells are
+     * visited in.
+     *
+     * @param seed The seed of the whole grid
+     * @param x The x coordinate of the cell
+     * @param y The y coordinate of the cell
+     * @return The hash
      */
-    int l2NormDiff(int* a, int* b, int size)
+    unsigned long long hashCoordinates(unsigned long long seed, int x, int y)
     {
-        int sum = 0;
-
-        for (int i = 0; i < size; i++)
-        {
-            sum += (a[i] - b[i]) * (a[i] - b[i]);
-        }
+        unsigned long long z = seed + 0x9E3779B97F4A7C15ULL * (((unsigned long long) (unsigned int) x << 32) | (unsigned int) y) + 0x9E3779B97F4A7C15ULL;
 
-        delete [] a;
-        delete [] b;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
 
-        return sqrt(sum);
+        return z ^ (z >> 31);
     }
 }
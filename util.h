@@ -16,7 +16,7 @@ using namespace std;
 namespace util
 {
     vector<char> parseFileNameForSideCodes(string, char);
-    int l2NormDiff(int*, int*, int);
+    unsigned long long hashCoordinates(unsigned long long, int, int);
 };
 
 #endif //WANGTILE_UTIL_H